@@ -29,12 +29,14 @@
 #include <osgEarth/Registry>
 
 #include <osgEarth/Caching>
+#include <osgEarthFeatures/FeatureModelGraph>
 
 #include <iostream>
 #include <sstream>
 #include <iterator>
 
 using namespace osgEarth;
+using namespace osgEarth::Features;
 
 #define LC "[osgearth_cache] "
 
@@ -80,6 +82,7 @@ usage( const std::string& msg )
         << "        [--bounds xmin ymin xmax ymax]  ; Geospatial bounding box to seed" << std::endl
         << "        [--cache-path path]             ; Overrides the cache path in the .earth file" << std::endl
         << "        [--cache-type type]             ; Overrides the cache type in the .earth file" << std::endl
+        << "        [--feature-level level]         ; Deepest layout level to seed for feature layers with a cache_path (default=max-level)" << std::endl
         //<< std::endl
         //<< "    --purge file.earth                  ; Purges cached data from the cache in a .earth file" << std::endl
         //<< "        [--layer name]                  ; Named layer for which to purge the cache" << std::endl
@@ -99,6 +102,22 @@ int message( const std::string& msg )
 }
 
 
+struct FindFeatureModelGraphs : public osg::NodeVisitor
+{
+    FindFeatureModelGraphs() : osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN ) { }
+
+    void apply( osg::Group& group )
+    {
+        FeatureModelGraph* graph = dynamic_cast<FeatureModelGraph*>( &group );
+        if ( graph )
+            _graphs.push_back( graph );
+        else
+            traverse( group );
+    }
+
+    std::vector< osg::ref_ptr<FeatureModelGraph> > _graphs;
+};
+
 int
 seed( osg::ArgumentParser& args )
 {    
@@ -123,6 +142,10 @@ seed( osg::ArgumentParser& args )
     std::string cacheType;
     while (args.read("--cache-type", cacheType));
 
+    //Read the deepest feature level
+    unsigned int featureLevel = maxLevel;
+    while (args.read("--feature-level", featureLevel));
+
     bool quiet = args.read("--quiet");
 
     //Read in the earth file.
@@ -144,6 +167,20 @@ seed( osg::ArgumentParser& args )
     }
     seeder.seed( mapNode->getMap() );
 
+    // feature model layers keep their own tile cache; seed those too.
+    FindFeatureModelGraphs finder;
+    mapNode->accept( finder );
+    for( unsigned i=0; i<finder._graphs.size(); ++i )
+    {
+        FeatureModelGraph* graph = finder._graphs[i];
+        if ( graph->isCacheEnabled() )
+        {
+            OE_NOTICE << LC << "Seeding feature layer \"" << graph->getName() << "\"" << std::endl;
+            osg::ref_ptr<ProgressCallback> progress = quiet ? 0L : new ConsoleProgressCallback();
+            graph->seed( featureLevel, progress.get() );
+        }
+    }
+
     return 0;
 }
 
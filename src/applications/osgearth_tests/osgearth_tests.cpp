@@ -18,25 +18,543 @@
 */
 
 #include <osgUtil/Optimizer>
+#include <osgUtil/Tessellator>
+#include <osgUtil/UpdateVisitor>
+#include <osg/Timer>
+#include <osg/CoordinateSystemNode>
+#include <osg/Geode>
+#include <osg/PagedLOD>
 #include <osgDB/ReadFile>
 
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
+#include <osgDB/FileUtils>
+#include <osgDB/Registry>
 
+#include <osgEarth/CacheCodec>
+#include <osgEarth/Caching>
+#include <osgEarth/HeightFieldUtils>
 #include <osgEarth/Map>
+#include <osgEarth/MapNode>
+#include <osgEarth/Metrics>
 #include <osgEarth/Registry>
+#include <osgEarth/HTTPClient>
+#include <osgEarth/Progress>
+#include <osgEarth/QuantizedHeightField>
+#include <osgEarth/ThreadingUtils>
 
 #include <osgEarthDrivers/gdal/GDALOptions>
 #include <osgEarthDrivers/arcgis/ArcGISOptions>
 #include <osgEarthDrivers/tms/TMSOptions>
+#include <osgEarthDrivers/cache_chain/CacheChainOptions>
+#include <osgEarthDrivers/engine_seamless/SeamlessOptions>
 
+#include <osgEarthFeatures/FeatureListSource>
+#include <osgEarthFeatures/FeatureModelGraph>
+
+#include <osgEarthSymbology/Geometry>
+#include <osgEarthSymbology/MeshSubdivider>
+#include <osgEarthSymbology/PolygonTriangulator>
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+#include <algorithm>
+#include <float.h>
+#include <fstream>
 #include <iostream>
+#include <math.h>
+#include <set>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 using namespace osg;
 using namespace osgDB;
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
 
+// Number of failed checks; main() returns nonzero if there were any.
+static int s_failures = 0;
+
+// Builds a geometry with one LINE_LOOP per contour; coords are x,y pairs.
+static osg::Geometry* makeContours( const std::vector< std::vector<float> >& contours )
+{
+    osg::Geometry* geom = new osg::Geometry();
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    geom->setVertexArray( verts );
+    for( unsigned c=0; c<contours.size(); ++c )
+    {
+        unsigned first = verts->size();
+        for( unsigned i=0; i+1<contours[c].size(); i+=2 )
+            verts->push_back( osg::Vec3(contours[c][i], contours[c][i+1], 0) );
+        geom->addPrimitiveSet( new osg::DrawArrays(GL_LINE_LOOP, first, verts->size()-first) );
+    }
+    return geom;
+}
+
+// Triangulates the contours and checks that the triangles cover the expected area
+// with none of them facing backwards.
+static void testTriangulation( const std::string& name, const std::vector< std::vector<float> >& contours, double expectedArea,
+                               Symbology::PolygonTriangulator::WindingRule rule =Symbology::PolygonTriangulator::WINDING_ODD )
+{
+    osg::ref_ptr<osg::Geometry> geom = makeContours( contours );
+    if ( !osgEarth::Symbology::PolygonTriangulator::run( *geom.get(), rule ) )
+    {
+        OE_NOTICE << "Error:  PolygonTriangulator failed on the " << name << " case" << std::endl;
+        ++s_failures;
+        return;
+    }
+
+    const osg::Vec3Array* verts = static_cast<const osg::Vec3Array*>( geom->getVertexArray() );
+    double area = 0.0;
+    unsigned backwards = 0;
+    for( unsigned p=0; p<geom->getNumPrimitiveSets(); ++p )
+    {
+        const osg::PrimitiveSet* ps = geom->getPrimitiveSet(p);
+        if ( ps->getMode() != GL_TRIANGLES )
+            continue;
+        for( unsigned i=0; i+2<ps->getNumIndices(); i+=3 )
+        {
+            const osg::Vec3& a = (*verts)[ps->index(i)];
+            const osg::Vec3& b = (*verts)[ps->index(i+1)];
+            const osg::Vec3& c = (*verts)[ps->index(i+2)];
+            double t = 0.5 * ((b.x()-a.x())*(c.y()-a.y()) - (b.y()-a.y())*(c.x()-a.x()));
+            area += t;
+            if ( t < 0.0 )
+                ++backwards;
+        }
+    }
+
+    if ( fabs(area - expectedArea) > 1e-6 || backwards > 0 )
+    {
+        OE_NOTICE << "Error:  PolygonTriangulator " << name << " case covered an area of " << area
+            << " (expected " << expectedArea << ") with " << backwards << " backwards triangles" << std::endl;
+        ++s_failures;
+    }
+}
+
+static std::vector<float> coords( const float* values, unsigned count )
+{
+    return std::vector<float>( values, values+count );
+}
+
+// Runs a read on its own thread so the test can cancel it while it's in flight.
+class CancelableRead : public OpenThreads::Thread
+{
+public:
+    CancelableRead() : _progress( new ProgressCallback() ) { }
+    virtual ~CancelableRead() { }
+    ProgressCallback* getProgress() { return _progress.get(); }
+    void run() { read( _progress.get() ); }
+protected:
+    virtual void read( ProgressCallback* progress ) =0;
+    osg::ref_ptr<ProgressCallback> _progress;
+};
+
+class ReprojectRead : public CancelableRead
+{
+public:
+    ReprojectRead( const GeoImage& image, const GeoExtent& toExtent, unsigned size )
+        : _image(image), _toExtent(toExtent), _size(size) { }
+protected:
+    void read( ProgressCallback* progress ) { _image.reproject( _toExtent.getSRS(), &_toExtent, _size, _size, progress ); }
+    GeoImage  _image;
+    GeoExtent _toExtent;
+    unsigned  _size;
+};
+
+class HTTPRead : public CancelableRead
+{
+public:
+    HTTPRead( const std::string& url ) : _url(url) { }
+protected:
+    void read( ProgressCallback* progress ) { HTTPClient::get( _url, 0L, progress ); }
+    std::string _url;
+};
+
+// Looks up a known SRS over and over, to time create() under contention.
+class SRSCreateThread : public OpenThreads::Thread
+{
+public:
+    SRSCreateThread( int runs ) : _runs(runs) { }
+    void run() {
+        for( int i=0; i<_runs; ++i )
+            SpatialReference::create( "epsg:4326" );
+    }
+private:
+    int _runs;
+};
+
+// Starts the read, cancels it after delayMS and checks that the worker thread is
+// released within boundMS of the cancelation.
+static void testCancelLatency( const std::string& name, CancelableRead* read, double delayMS, double boundMS )
+{
+    read->start();
+    OpenThreads::Thread::microSleep( (unsigned int)(delayMS*1000.0) );
+
+    if ( !read->isRunning() )
+    {
+        OE_NOTICE << "Cancel latency (" << name << "): the read finished within " << delayMS
+            << " ms, before it could be canceled" << std::endl;
+        read->join();
+        return;
+    }
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    read->getProgress()->cancel();
+    read->join();
+    double latency = osg::Timer::instance()->delta_m( t0, osg::Timer::instance()->tick() );
+
+    if ( latency > boundMS )
+    {
+        OE_NOTICE << "Error:  Canceled " << name << " read held its thread for " << latency
+            << " ms (limit " << boundMS << " ms)" << std::endl;
+        ++s_failures;
+    }
+    else
+    {
+        OE_NOTICE << "Cancel latency (" << name << "): " << latency << " ms" << std::endl;
+    }
+}
+
+// Collects the paged LODs under a node.
+struct CollectPagedLODs : public osg::NodeVisitor
+{
+    CollectPagedLODs() : osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN ) { }
+    void apply( osg::PagedLOD& node ) { _plods.push_back( &node ); traverse( node ); }
+    std::vector<osg::PagedLOD*> _plods;
+};
+
+// Builds "levels" levels of seamless terrain for an empty map without a viewer, by loading
+// each patch group's children through the engine's pseudo-loader, and waits for the height
+// field service to expand every patch. Returns false if that takes over a minute.
+static bool buildSeamlessPatches( bool edgeCache, unsigned levels, unsigned& out_patches )
+{
+    MetricHistogram* expand = osgEarth::Registry::instance()->getMetrics()->getHistogram( "seamless.patch.expand" );
+    MetricHistogram::Summary before;
+    expand->getSummary( before );
+
+    SeamlessOptions seamless;
+    seamless.edgeCache() = edgeCache;
+    MapNodeOptions nodeOptions;
+    nodeOptions.setTerrainOptions( seamless );
+    osg::ref_ptr<MapNode> mapNode = new MapNode( new Map(), nodeOptions );
+
+    CollectPagedLODs collect;
+    mapNode->accept( collect );
+    std::vector<osg::PagedLOD*> level = collect._plods;
+    out_patches = level.size();
+    for( unsigned l=0; l<levels; ++l )
+    {
+        std::vector<osg::PagedLOD*> next;
+        for( unsigned i=0; i<level.size(); ++i )
+        {
+            osg::PagedLOD* plod = level[i];
+            if ( plod->getNumFileNames() < 2 || plod->getFileName(1).empty() )
+                continue;
+            osg::ref_ptr<osg::Node> children = osgDB::readNodeFile(
+                plod->getFileName(1), dynamic_cast<const osgDB::Options*>(plod->getDatabaseOptions()) );
+            if ( !children.valid() )
+                continue;
+            plod->addChild( children.get() );
+            CollectPagedLODs childCollect;
+            children->accept( childCollect );
+            next.insert( next.end(), childCollect._plods.begin(), childCollect._plods.end() );
+        }
+        out_patches += next.size();
+        level.swap( next );
+    }
+
+    MetricHistogram::Summary after;
+    for( int wait=0; wait<60000; ++wait )
+    {
+        expand->getSummary( after );
+        if ( after._count - before._count >= out_patches )
+            return true;
+        OpenThreads::Thread::microSleep( 1000 );
+    }
+    return false;
+}
+
+static Features::Feature* makePointFeature( Features::FeatureID fid, double x, double y )
+{
+    Features::Feature* feature = new Features::Feature( fid );
+    Symbology::PointSet* point = new Symbology::PointSet();
+    point->push_back( osg::Vec3d(x, y, 0) );
+    feature->setGeometry( point );
+    return feature;
+}
+
+// Compiles each feature to a point, and counts the features it has compiled.
+class CountingNodeFactory : public Features::FeatureNodeFactory
+{
+public:
+    bool createOrUpdateNode( Features::FeatureCursor* cursor, const Symbology::Style& style,
+                             const Features::FilterContext& context, osg::ref_ptr<osg::Node>& node )
+    {
+        osg::Vec3Array* verts = new osg::Vec3Array();
+        while( cursor->hasMore() )
+        {
+            const Symbology::Geometry* geom = cursor->nextFeature()->getGeometry();
+            if ( geom )
+            {
+                for( Symbology::Geometry::const_iterator i = geom->begin(); i != geom->end(); ++i )
+                    verts->push_back( osg::Vec3(i->x(), i->y(), i->z()) );
+            }
+            ++_numCompiled;
+        }
+        osg::Geometry* points = new osg::Geometry();
+        points->setVertexArray( verts );
+        points->addPrimitiveSet( new osg::DrawArrays(GL_POINTS, 0, verts->size()) );
+        osg::Geode* geode = new osg::Geode();
+        geode->addDrawable( points );
+        node = geode;
+        return true;
+    }
+
+    OpenThreads::Atomic _numCompiled;
+};
+
+// Builds a geocentric triangle grid of cols x rows cells, each "degrees" on a side.
+static osg::Geometry* makeGeocentricGrid( unsigned cols, unsigned rows, double degrees )
+{
+    osg::ref_ptr<osg::EllipsoidModel> ellipsoid = new osg::EllipsoidModel();
+    osg::Geometry* geom = new osg::Geometry();
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    for( unsigned r=0; r<=rows; ++r )
+    {
+        for( unsigned c=0; c<=cols; ++c )
+        {
+            double x, y, z;
+            ellipsoid->convertLatLongHeightToXYZ( osg::DegreesToRadians(r*degrees), osg::DegreesToRadians(c*degrees), 0.0, x, y, z );
+            verts->push_back( osg::Vec3(x, y, z) );
+        }
+    }
+    geom->setVertexArray( verts );
+
+    osg::DrawElementsUInt* tris = new osg::DrawElementsUInt( GL_TRIANGLES );
+    for( unsigned r=0; r<rows; ++r )
+    {
+        for( unsigned c=0; c<cols; ++c )
+        {
+            unsigned i = r*(cols+1) + c;
+            tris->push_back( i ); tris->push_back( i+1 ); tris->push_back( i+cols+2 );
+            tris->push_back( i ); tris->push_back( i+cols+2 ); tris->push_back( i+cols+1 );
+        }
+    }
+    geom->addPrimitiveSet( tris );
+    return geom;
+}
+
+// Takes a lock over and over: a write lock every "writeEvery" passes (every pass if 1, never
+// if 0) and a read lock otherwise, optionally timing how long each read lock takes to get.
+class LockThread : public OpenThreads::Thread
+{
+public:
+    LockThread( Threading::ReadWriteMutex& mutex, int runs, int writeEvery, bool timeReads =false )
+        : _mutex(mutex), _runs(runs), _writeEvery(writeEvery), _timeReads(timeReads), _maxReadWait(0.0) { }
+    void run() {
+        for( int i=0; i<_runs; ++i )
+        {
+            if ( _writeEvery > 0 && i % _writeEvery == 0 )
+            {
+                Threading::ScopedWriteLock lock( _mutex );
+            }
+            else if ( _timeReads )
+            {
+                osg::Timer_t t0 = osg::Timer::instance()->tick();
+                Threading::ScopedReadLock lock( _mutex );
+                _maxReadWait = osg::maximum( _maxReadWait, osg::Timer::instance()->delta_m(t0, osg::Timer::instance()->tick()) );
+            }
+            else
+            {
+                Threading::ScopedReadLock lock( _mutex );
+            }
+        }
+    }
+    double getMaxReadWait() const { return _maxReadWait; }
+private:
+    Threading::ReadWriteMutex& _mutex;
+    int    _runs, _writeEvery;
+    bool   _timeReads;
+    double _maxReadWait;
+};
+
+static bool traceEventBefore( const std::pair<double, TileKey>& lhs, const std::pair<double, TileKey>& rhs )
+{
+    return lhs.first < rhs.first;
+}
+
+// Reads the tile keys of the "cache.read" events in a trace written by Tracer::writeJSON, in time order.
+static bool readCacheTrace( const std::string& filename, const Profile* profile, std::vector<TileKey>& out_keys )
+{
+    std::ifstream in( filename.c_str() );
+    if ( !in.is_open() )
+        return false;
+
+    std::vector< std::pair<double, TileKey> > events;
+    std::string line;
+    while( std::getline(in, line) )
+    {
+        std::string::size_type ts  = line.find( "\"ts\":" );
+        std::string::size_type key = line.find( "\"key\":\"" );
+        unsigned lod, x, y;
+        if ( line.find("\"name\":\"cache.read\"") != std::string::npos &&
+             ts != std::string::npos && key != std::string::npos &&
+             sscanf( line.c_str() + key + 7, "%u_%u_%u", &lod, &x, &y ) == 3 )
+        {
+            events.push_back( std::make_pair(atof(line.c_str() + ts + 5), TileKey(lod, x, y, profile)) );
+        }
+    }
+
+    std::stable_sort( events.begin(), events.end(), traceEventBefore );
+    for( unsigned i=0; i<events.size(); ++i )
+        out_keys.push_back( events[i].second );
+    return !out_keys.empty();
+}
+
+// A skewed trace for when there's no recorded one: a hot set of 64 tiles, a few asked for far more
+// often than the rest, with every fifth request going to a flyover that never comes back to a tile.
+static void makeCacheTrace( const Profile* profile, unsigned count, std::vector<TileKey>& out_keys )
+{
+    unsigned r = 1;
+    for( unsigned i=0; i<count; ++i )
+    {
+        if ( i % 5 == 4 )
+        {
+            out_keys.push_back( TileKey(12, i/5, 100, profile) );
+        }
+        else
+        {
+            r = r * 1103515245u + 12345u;
+            unsigned hot = ((r >> 16) % 64) * ((r >> 8) % 64) / 64;
+            out_keys.push_back( TileKey(8, hot % 8, hot / 8, profile) );
+        }
+    }
+}
+
+// Replays a trace through a cache, storing a small image on each miss the way a layer would after
+// going to its tile source. Returns the number of misses.
+static unsigned replayCacheTrace( Cache* cache, const CacheSpec& spec, const std::vector<TileKey>& keys, double& out_ms )
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage( 16, 16, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+    memset( image->data(), 0x80, image->getTotalSizeInBytes() );
+
+    unsigned misses = 0;
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    for( unsigned i=0; i<keys.size(); ++i )
+    {
+        osg::ref_ptr<const osg::Image> cached;
+        if ( !cache->getImage(keys[i], spec, cached) )
+        {
+            ++misses;
+            cache->setImage( keys[i], spec, image.get() );
+        }
+    }
+    out_ms = osg::Timer::instance()->delta_m( t0, osg::Timer::instance()->tick() );
+    return misses;
+}
+
+// Writes an image to a buffer and reads it back, "runs" times each, through a cache codec or (with
+// no codec) the osgDB plugin for "ext". Reports the average times, the encoded size and whether the
+// pixels came back unchanged.
+static bool timeImageStorage( const CacheCodec* codec, const std::string& ext, const std::string& rwOptions,
+                              const osg::Image* image, int runs,
+                              double& out_writeMS, double& out_readMS, unsigned& out_bytes, bool& out_exact )
+{
+    osg::ref_ptr<osgDB::ReaderWriter> rw;
+    if ( !codec )
+    {
+        rw = osgDB::Registry::instance()->getReaderWriterForExtension( ext );
+        if ( !rw.valid() )
+            return false;
+    }
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options( rwOptions );
+
+    std::string data;
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    for( int i=0; i<runs; ++i )
+    {
+        if ( codec )
+        {
+            data.clear();
+            if ( !codec->encode(image, data) )
+                return false;
+        }
+        else
+        {
+            std::stringstream buf( std::ios::in | std::ios::out | std::ios::binary );
+            if ( !rw->writeImage(*image, buf, options.get()).success() )
+                return false;
+            data = buf.str();
+        }
+    }
+
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+    osg::ref_ptr<osg::Image> result;
+    for( int i=0; i<runs; ++i )
+    {
+        if ( codec )
+        {
+            result = codec->decodeImage( data );
+        }
+        else
+        {
+            std::stringstream buf( data, std::ios::in | std::ios::binary );
+            result = rw->readImage( buf, options.get() ).getImage();
+        }
+        if ( !result.valid() )
+            return false;
+    }
+    osg::Timer_t t2 = osg::Timer::instance()->tick();
+
+    out_writeMS = osg::Timer::instance()->delta_m( t0, t1 ) / runs;
+    out_readMS  = osg::Timer::instance()->delta_m( t1, t2 ) / runs;
+    out_bytes   = data.size();
+    out_exact   =
+        result->getTotalSizeInBytes() == image->getTotalSizeInBytes() &&
+        memcmp( result->data(), image->data(), image->getTotalSizeInBytes() ) == 0;
+    return true;
+}
+
+// A square heightfield of rolling terrain between 0 and about 3000 m, at centimetre detail, with a
+// NO_DATA corner.
+static osg::HeightField* makeTerrainHeightField( unsigned size )
+{
+    osg::HeightField* hf = new osg::HeightField();
+    hf->allocate( size, size );
+    for( unsigned r=0; r<size; ++r )
+    {
+        for( unsigned c=0; c<size; ++c )
+        {
+            double x = (double)c / size, y = (double)r / size;
+            double h = 1500.0 + 1000.0*sin(x*3.1 + 0.5)*cos(y*2.3) + 300.0*sin(x*17.0)*sin(y*13.0) + 20.0*sin(x*97.0 + y*61.0);
+            hf->setHeight( c, r, c < 8 && r < 8 ? NO_DATA_VALUE : (float)(floor(h * 100.0) / 100.0) );
+        }
+    }
+    return hf;
+}
+
+// Largest height difference between two heightfields; NO_DATA must stay NO_DATA (or it counts as infinite).
+static double maxHeightError( const osg::HeightField* a, const osg::HeightField* b )
+{
+    if ( !b || a->getHeightList().size() != b->getHeightList().size() )
+        return DBL_MAX;
+
+    double maxError = 0.0;
+    for( unsigned i=0; i<a->getHeightList().size(); ++i )
+    {
+        float ha = a->getHeightList()[i], hb = b->getHeightList()[i];
+        if ( (ha == NO_DATA_VALUE) != (hb == NO_DATA_VALUE) )
+            return DBL_MAX;
+        if ( ha != NO_DATA_VALUE )
+            maxError = osg::maximum( maxError, (double)fabs(ha - hb) );
+    }
+    return maxError;
+}
+
 int main(int argc, char** argv)
 {
   osg::ArgumentParser arguments(&argc,argv);
@@ -54,7 +572,10 @@ int main(int argc, char** argv)
 
       TileKey key(0, 0, 0, layer->getProfile());
 	  GeoImage image = layer->createImage( key );
-	  osgDB::writeImageFile(*image.getImage(), layer->getName()+key.str() + std::string(".png"));
+	  if (image.valid())
+	      osgDB::writeImageFile(*image.getImage(), layer->getName()+key.str() + std::string(".png"));
+	  else
+	      OE_NOTICE << layer->getName() << ": source unavailable, skipped" << std::endl;
   }
 
   //Mosaic test.  Request a tile in the global geodetic profile from a layer with a geographic SRS but a different tiling scheme.
@@ -70,7 +591,10 @@ int main(int argc, char** argv)
 
       TileKey key(0, 0, 0, osgEarth::Registry::instance()->getGlobalGeodeticProfile());
 	  GeoImage image = layer->createImage( key );
-	  osgDB::writeImageFile(*image.getImage(), layer->getName()+key.str() + std::string(".png"));
+	  if (image.valid())
+	      osgDB::writeImageFile(*image.getImage(), layer->getName()+key.str() + std::string(".png"));
+	  else
+	      OE_NOTICE << layer->getName() << ": source unavailable, skipped" << std::endl;
   }
 
   //Reprojection.  Request a UTM image from a global geodetic profile
@@ -87,7 +611,10 @@ int main(int argc, char** argv)
 
       TileKey key(0, 0, 0, Profile::create("epsg:26917", 560725, 4385762, 573866, 4400705));
 	  GeoImage image = layer->createImage( key );
-	  osgDB::writeImageFile(*image.getImage(), layer->getName()+key.str() + std::string(".png"));
+	  if (image.valid())
+	      osgDB::writeImageFile(*image.getImage(), layer->getName()+key.str() + std::string(".png"));
+	  else
+	      OE_NOTICE << layer->getName() << ": source unavailable, skipped" << std::endl;
   }
 
 
@@ -111,13 +638,650 @@ int main(int argc, char** argv)
 	  //Request an image from the mercator source.  Should be reprojected to geodetic
 	  TileKey key(0, 0, 0, osgEarth::Registry::instance()->getGlobalGeodeticProfile());
 	  GeoImage image = layer->createImage( key );
-	  if (!image.getSRS()->isGeographic())
+	  if (!image.valid())
 	  {
-		  OE_NOTICE << "Error:  Should have reprojected image to geodetic but returned SRS is  " << image.getSRS()->getWKT() << std::endl;
+	      OE_NOTICE << layer->getName() << ": source unavailable, skipped" << std::endl;
 	  }
-	  osgDB::writeImageFile(*image.getImage(), layer->getName()+key.str() + std::string(".png"));
+	  else
+	  {
+	      if (!image.getSRS()->isGeographic())
+	      {
+		      OE_NOTICE << "Error:  Should have reprojected image to geodetic but returned SRS is  " << image.getSRS()->getWKT() << std::endl;
+		      ++s_failures;
+	      }
+	      osgDB::writeImageFile(*image.getImage(), layer->getName()+key.str() + std::string(".png"));
+	  }
+  }
+
+  //Concave crop.  Cropping across both arms of a U must give two separate polygons, not one ring joined along the crop edge.
+  {
+      osg::ref_ptr<Symbology::Polygon> u = new Symbology::Polygon();
+      u->push_back( osg::Vec3d(0, 0, 0) );
+      u->push_back( osg::Vec3d(3, 0, 0) );
+      u->push_back( osg::Vec3d(3, 3, 0) );
+      u->push_back( osg::Vec3d(2, 3, 0) );
+      u->push_back( osg::Vec3d(2, 1, 0) );
+      u->push_back( osg::Vec3d(1, 1, 0) );
+      u->push_back( osg::Vec3d(1, 3, 0) );
+      u->push_back( osg::Vec3d(0, 3, 0) );
+
+      osg::ref_ptr<Symbology::Geometry> cropped;
+      if ( !u->crop( Bounds(-1, 2, 4, 4), cropped ) || cropped->getType() != Symbology::Geometry::TYPE_MULTI )
+      {
+          OE_NOTICE << "Error:  Cropping a U across both arms should have returned a MultiGeometry" << std::endl;
+          ++s_failures;
+      }
+      else
+      {
+          const Symbology::GeometryCollection& parts = static_cast<Symbology::MultiGeometry*>( cropped.get() )->getComponents();
+          if ( parts.size() != 2 )
+          {
+              OE_NOTICE << "Error:  Cropping a U across both arms returned " << parts.size() << " parts instead of 2" << std::endl;
+              ++s_failures;
+          }
+          for( Symbology::GeometryCollection::const_iterator i = parts.begin(); i != parts.end(); ++i )
+          {
+              const Symbology::Polygon* part = dynamic_cast<const Symbology::Polygon*>( i->get() );
+              Bounds b = i->get()->getBounds();
+              if ( !part || part->size() != 4 || b.width() != 1.0 || b.height() != 1.0 )
+              {
+                  OE_NOTICE << "Error:  Each arm of the cropped U should be a 1x1 square polygon" << std::endl;
+                  ++s_failures;
+              }
+          }
+      }
   }
 
+  //Triangulation.  Degenerate input must still triangulate to the full area of the polygon.
+  {
+      typedef std::vector< std::vector<float> > Contours;
+      float square[]    = { 0,0, 4,0, 4,4, 0,4 };
+      float collinear[] = { 0,0, 1,0, 2,0, 2,1, 2,2, 1,2, 0,2, 0,1 };
+      float dupes[]     = { 0,0, 0,0, 1,0, 1,1, 1,1, 1,1, 0,1, 0,0 };
+      float touching[]  = { 0,0, 1,0, 1,1, 2,1, 2,2, 1,2, 1,1, 0,1 };
+      float spike[]     = { 0,0, 1,0, 1,0, 2,0, 2,0, 2,1, 0,1, 0,0.5f, 0,1 };
+      float hole[]      = { 1,1, 3,1, 3,3, 1,3 };
+      float hole2a[]    = { 1,1, 2,1, 2,2, 1,2 };
+      float hole2b[]    = { 2.5f,2.5f, 3,2.5f, 3,3, 2.5f,3 };
+      float edgeHole[]  = { 1,1, 4,2, 1,3 };
+      float holeCW[]    = { 1,1, 1,3, 3,3, 3,1 };
+
+      Contours c;
+      c.push_back( coords(collinear, 16) );
+      testTriangulation( "collinear vertices", c, 4.0 );
+
+      c.clear();
+      c.push_back( coords(dupes, 16) );
+      testTriangulation( "duplicate vertices", c, 1.0 );
+
+      c.clear();
+      c.push_back( coords(touching, 16) );
+      testTriangulation( "self-touching vertex", c, 2.0 );
+
+      c.clear();
+      c.push_back( coords(spike, 18) );
+      testTriangulation( "collinear spike", c, 2.0 );
+
+      c.clear();
+      c.push_back( coords(square, 8) );
+      c.push_back( coords(hole, 8) );
+      testTriangulation( "hole", c, 12.0 );
+
+      c.clear();
+      c.push_back( coords(square, 8) );
+      c.push_back( coords(hole2a, 8) );
+      c.push_back( coords(hole2b, 8) );
+      testTriangulation( "two holes", c, 14.75 );
+
+      c.clear();
+      c.push_back( coords(square, 8) );
+      c.push_back( coords(edgeHole, 6) );
+      testTriangulation( "hole touching the outer ring", c, 13.0 );
+
+      // under the positive rule only a contour wound against its container cuts a hole.
+      c.clear();
+      c.push_back( coords(square, 8) );
+      c.push_back( coords(hole, 8) );
+      testTriangulation( "positive rule, same-way inner ring", c, 16.0, Symbology::PolygonTriangulator::WINDING_POSITIVE );
+
+      c.clear();
+      c.push_back( coords(square, 8) );
+      c.push_back( coords(holeCW, 8) );
+      testTriangulation( "positive rule, opposing inner ring", c, 12.0, Symbology::PolygonTriangulator::WINDING_POSITIVE );
+  }
+
+  //Triangulation benchmark.  Compare against osgUtil::Tessellator on a many-sided star.
+  {
+      std::vector< std::vector<float> > star(1);
+      const unsigned points = 5000;
+      for( unsigned i=0; i<points; ++i )
+      {
+          double a = 2.0*osg::PI*(double)i/(double)points;
+          double r = (i % 2) == 0 ? 100.0 : 60.0;
+          star[0].push_back( r*cos(a) );
+          star[0].push_back( r*sin(a) );
+      }
+
+      const int runs = 10;
+      osg::Timer_t t0 = osg::Timer::instance()->tick();
+      for( int i=0; i<runs; ++i )
+      {
+          osg::ref_ptr<osg::Geometry> geom = makeContours( star );
+          osgEarth::Symbology::PolygonTriangulator::run( *geom.get() );
+      }
+      osg::Timer_t t1 = osg::Timer::instance()->tick();
+      for( int i=0; i<runs; ++i )
+      {
+          osg::ref_ptr<osg::Geometry> geom = makeContours( star );
+          osg::ref_ptr<osgUtil::Tessellator> tess = new osgUtil::Tessellator();
+          tess->setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
+          tess->setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
+          tess->retessellatePolygons( *geom.get() );
+      }
+      osg::Timer_t t2 = osg::Timer::instance()->tick();
+
+      OE_NOTICE << "Triangulating a " << points << "-point star: PolygonTriangulator "
+          << osg::Timer::instance()->delta_m(t0, t1)/runs << " ms, osgUtil::Tessellator "
+          << osg::Timer::instance()->delta_m(t1, t2)/runs << " ms" << std::endl;
+  }
+
+  //SRS benchmark.  create() with a known init string, isEquivalentTo() between distinct but
+  //equivalent SRS's, and GeoExtent::contains() across them, as in per-tile loops.
+  {
+      const int runs = 1000000;
+      osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::create( "epsg:4326" );
+      osg::ref_ptr<const SpatialReference> proj4 = SpatialReference::create( "+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs" );
+      GeoExtent extent( wgs84.get(), -180, -90, 180, 90 );
+
+      osg::Timer_t t0 = osg::Timer::instance()->tick();
+      for( int i=0; i<runs; ++i )
+          SpatialReference::create( "epsg:4326" );
+      osg::Timer_t t1 = osg::Timer::instance()->tick();
+      int equivalent = 0;
+      for( int i=0; i<runs; ++i )
+          if ( wgs84->isEquivalentTo( proj4.get() ) )
+              ++equivalent;
+      osg::Timer_t t2 = osg::Timer::instance()->tick();
+      int contained = 0;
+      for( int i=0; i<runs; ++i )
+          if ( extent.contains( (double)(i % 360) - 180.0, 0.0, proj4.get() ) )
+              ++contained;
+      osg::Timer_t t3 = osg::Timer::instance()->tick();
+
+      const int numThreads = 8;
+      std::vector<SRSCreateThread*> threads;
+      for( int t=0; t<numThreads; ++t )
+          threads.push_back( new SRSCreateThread(runs) );
+      osg::Timer_t t4 = osg::Timer::instance()->tick();
+      for( int t=0; t<numThreads; ++t )
+          threads[t]->start();
+      for( int t=0; t<numThreads; ++t )
+      {
+          threads[t]->join();
+          delete threads[t];
+      }
+      osg::Timer_t t5 = osg::Timer::instance()->tick();
+
+      if ( equivalent != runs || contained != runs )
+      {
+          OE_NOTICE << "Error:  epsg:4326 and its PROJ4 definition should be equivalent" << std::endl;
+          ++s_failures;
+      }
+
+      osg::Timer* timer = osg::Timer::instance();
+      OE_NOTICE << "SRS (ns per call): create " << timer->delta_u(t0, t1)*1000.0/runs
+          << ", isEquivalentTo " << timer->delta_u(t1, t2)*1000.0/runs
+          << ", GeoExtent::contains " << timer->delta_u(t2, t3)*1000.0/runs
+          << ", create on " << numThreads << " threads " << timer->delta_u(t4, t5)*1000.0/runs << std::endl;
+  }
+
+  //Cancelation.  Canceling an in-flight GDAL warp or curl download must release the worker promptly.
+  //Both reads use locally generated data so the test doesn't depend on the network or sample files.
+  {
+      // a large synthetic image, warped through GDAL into UTM, keeps it busy long enough to cancel part way.
+      const unsigned size = 4096;
+      osg::ref_ptr<osg::Image> source = new osg::Image();
+      source->allocateImage( size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+      for( unsigned i=0; i<source->getTotalSizeInBytes(); ++i )
+          source->data()[i] = (unsigned char)(i * 31);
+
+      GeoImage geoImage( source.get(), GeoExtent(SpatialReference::create("epsg:4326"), -84, 36, -78, 42) );
+      GeoExtent toExtent( SpatialReference::create("epsg:26917"), 560725, 4385762, 573866, 4400705 );
+      ReprojectRead gdalRead( geoImage, toExtent, size );
+      testCancelLatency( "GDAL", &gdalRead, 20.0, 500.0 );
+
+      // curl streams a file:// URL through the same write callback as an HTTP download.
+      const std::string filename = "osgearth_tests_cancel.bin";
+      {
+          std::ofstream out( filename.c_str(), std::ios::binary );
+          std::vector<char> block( 1<<20, 'x' );
+          for( int i=0; i<256; ++i )
+              out.write( &block[0], block.size() );
+      }
+      HTTPRead fileRead( "file://" + osgDB::getRealPath(filename) );
+      testCancelLatency( "curl", &fileRead, 5.0, 500.0 );
+      ::remove( filename.c_str() );
+  }
+
+  //Seamless patch edges.  Build the same patches with and without the shared edge cache and
+  //compare the time spent expanding height fields into patch vertices.
+  {
+      MetricsRegistry* metrics = osgEarth::Registry::instance()->getMetrics();
+      MetricHistogram* expand = metrics->getHistogram( "seamless.patch.expand" );
+      MetricCounter* hits = metrics->getCounter( "seamless.edge_cache.hits" );
+      MetricCounter* misses = metrics->getCounter( "seamless.edge_cache.misses" );
+      const unsigned levels = 3;
+
+      double msPerPatch[2] = { 0.0, 0.0 };
+      unsigned long long edgeHits = 0, edgeLookups = 0;
+      for( int run=0; run<2; ++run )
+      {
+          bool edgeCache = run == 1;
+          MetricHistogram::Summary before, after;
+          expand->getSummary( before );
+          unsigned long long hits0 = hits->value(), misses0 = misses->value();
+
+          osg::Timer_t t0 = osg::Timer::instance()->tick();
+          unsigned patches = 0;
+          bool built = buildSeamlessPatches( edgeCache, levels, patches );
+          osg::Timer_t t1 = osg::Timer::instance()->tick();
+          if ( !built )
+          {
+              OE_NOTICE << "Error:  Timed out building seamless patches" << std::endl;
+              ++s_failures;
+              break;
+          }
+          if ( patches == 0 )
+          {
+              OE_NOTICE << "Seamless patches: engine unavailable, skipped" << std::endl;
+              break;
+          }
+
+          expand->getSummary( after );
+          msPerPatch[run] = 1000.0 * (after._sum - before._sum) / (double)(after._count - before._count);
+          edgeHits = hits->value() - hits0;
+          edgeLookups = edgeHits + misses->value() - misses0;
+          OE_NOTICE << "Seamless patches (" << (edgeCache ? "edge cache" : "no edge cache") << "): " << patches
+              << " patches in " << osg::Timer::instance()->delta_m(t0, t1) << " ms, "
+              << msPerPatch[run] << " ms per patch expanded" << std::endl;
+      }
+
+      if ( msPerPatch[1] > 0.0 )
+      {
+          OE_NOTICE << "Seamless edge cache: " << edgeHits << " of " << edgeLookups << " edges shared, expansion "
+              << msPerPatch[0]/msPerPatch[1] << "x faster" << std::endl;
+          if ( edgeHits == 0 )
+          {
+              OE_NOTICE << "Error:  No seamless patch borders were shared between neighbors" << std::endl;
+              ++s_failures;
+          }
+      }
+  }
+
+  //Incremental feature rebuilds.  Moving one feature of a live layer must recompile only the tiles
+  //it left and entered, and do it faster than compiling the whole layer.
+  {
+      osg::ref_ptr<Map> map = new Map();
+      GeoExtent extent( SpatialReference::create("epsg:4326"), -180, -90, 180, 90 );
+      osg::ref_ptr<Features::FeatureListSource> source = new Features::FeatureListSource( extent );
+      const int cols = 64, rows = 32;
+      for( int i=0; i<cols*rows; ++i )
+          source->insertFeature( makePointFeature(i, -180.0 + 360.0*(i%cols + 0.5)/cols, -90.0 + 180.0*(i/cols + 0.5)/rows) );
+
+      Features::FeatureDisplayLayout layout;
+      layout.tileSizeFactor() = 1.0f;
+      layout.addLevel( Features::FeatureLevel(0.0f, 250000.0f) );
+      Features::FeatureModelSourceOptions options;
+      options.levels() = layout;
+
+      osg::ref_ptr<CountingNodeFactory> factory = new CountingNodeFactory();
+      osg::ref_ptr<Features::FeatureModelGraph> graph = new Features::FeatureModelGraph(
+          source.get(), options, factory.get(), Symbology::StyleSheet(), new Features::Session(map.get()) );
+
+      // page in every tile, as the pager would with the whole layer in view:
+      osg::Timer_t t0 = osg::Timer::instance()->tick();
+      CollectPagedLODs collect;
+      graph->accept( collect );
+      for( unsigned i=0; i<collect._plods.size(); ++i )
+      {
+          osg::ref_ptr<osg::Node> tile = osgDB::readNodeFile( collect._plods[i]->getFileName(0) );
+          if ( tile.valid() )
+              collect._plods[i]->addChild( tile.get() );
+      }
+      osg::Timer_t t1 = osg::Timer::instance()->tick();
+      unsigned fullCompiled = factory->_numCompiled;
+
+      osgUtil::UpdateVisitor update;
+      update.setTraversalMode( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN );
+      graph->accept( update );
+
+      // move the first feature halfway around the world:
+      osg::Timer_t t2 = osg::Timer::instance()->tick();
+      source->insertFeature( makePointFeature(0, 360.0*0.25/cols, 180.0*0.25/rows) );
+      graph->accept( update );
+      for( int wait=0; wait<10000 && graph->getNumPendingRebuilds() > 0; ++wait )
+      {
+          OpenThreads::Thread::microSleep( 1000 );
+          graph->accept( update );
+      }
+      osg::Timer_t t3 = osg::Timer::instance()->tick();
+      unsigned editCompiled = (unsigned)factory->_numCompiled - fullCompiled;
+
+      if ( graph->getNumPendingRebuilds() > 0 )
+      {
+          OE_NOTICE << "Error:  Feature tile rebuilds did not finish" << std::endl;
+          ++s_failures;
+      }
+      else if ( editCompiled == 0 || editCompiled >= fullCompiled )
+      {
+          OE_NOTICE << "Error:  Moving one feature recompiled " << editCompiled << " of " << fullCompiled << " features" << std::endl;
+          ++s_failures;
+      }
+      else
+      {
+          OE_NOTICE << "Feature rebuild: " << collect._plods.size() << " tiles (" << fullCompiled << " features) in "
+              << osg::Timer::instance()->delta_m(t0, t1) << " ms, one edit recompiled " << editCompiled << " features in "
+              << osg::Timer::instance()->delta_m(t2, t3) << " ms" << std::endl;
+      }
+  }
+
+  //Mesh subdivision benchmark.  Densify a geocentric grid to 0.1 degrees and split the result into
+  //element buffers; every buffer must hold whole triangles and stay under the limit.
+  {
+      const int runs = 10;
+      const unsigned maxElements = 65535;
+      double ms = 0.0;
+      osg::ref_ptr<osg::Geometry> geom;
+      for( int i=0; i<runs; ++i )
+      {
+          geom = makeGeocentricGrid( 32, 32, 0.5 );
+          Symbology::MeshSubdivider subdivider;
+          subdivider.setMaxElementsPerEBO( maxElements );
+          osg::Timer_t t0 = osg::Timer::instance()->tick();
+          subdivider.run( osg::DegreesToRadians(0.1), *geom.get() );
+          ms += osg::Timer::instance()->delta_m( t0, osg::Timer::instance()->tick() );
+      }
+
+      unsigned numVerts = geom->getVertexArray()->getNumElements();
+      unsigned numTriangles = 0, badSets = 0;
+      for( unsigned i=0; i<geom->getNumPrimitiveSets(); ++i )
+      {
+          const osg::DrawElements* ebo = geom->getPrimitiveSet(i)->getDrawElements();
+          if ( !ebo || ebo->getMode() != GL_TRIANGLES || ebo->getNumIndices() > maxElements || ebo->getNumIndices() % 3 != 0 )
+          {
+              ++badSets;
+              continue;
+          }
+          for( unsigned k=0; k<ebo->getNumIndices(); ++k )
+          {
+              if ( ebo->index(k) >= numVerts )
+              {
+                  ++badSets;
+                  break;
+              }
+          }
+          numTriangles += ebo->getNumIndices() / 3;
+      }
+
+      if ( badSets > 0 || numTriangles <= 32*32*2 )
+      {
+          OE_NOTICE << "Error:  MeshSubdivider produced " << numTriangles << " triangles in "
+              << geom->getNumPrimitiveSets() << " element buffers, " << badSets << " of them malformed" << std::endl;
+          ++s_failures;
+      }
+      else
+      {
+          OE_NOTICE << "Mesh subdivision: " << 32*32*2 << " triangles to " << numTriangles << " in "
+              << geom->getNumPrimitiveSets() << " element buffers, " << ms/runs << " ms" << std::endl;
+      }
+  }
+
+  //ReadWriteMutex contention.  Read-mostly locking on 8 threads with the default and the single-slot
+  //lock, and the longest a reader waits while writers queue up back to back.
+  {
+      const int numThreads = 8, runs = 1000000;
+      for( int k=0; k<2; ++k )
+      {
+          unsigned slots = k == 0 ? (unsigned)Threading::ReadWriteMutex::DEFAULT_SLOTS : 1u;
+          Threading::ReadWriteMutex mutex( slots );
+          std::vector<LockThread*> threads;
+          for( int t=0; t<numThreads; ++t )
+              threads.push_back( new LockThread(mutex, runs, 1000) );
+          osg::Timer_t t0 = osg::Timer::instance()->tick();
+          for( int t=0; t<numThreads; ++t )
+              threads[t]->start();
+          for( int t=0; t<numThreads; ++t )
+          {
+              threads[t]->join();
+              delete threads[t];
+          }
+          osg::Timer_t t1 = osg::Timer::instance()->tick();
+          OE_NOTICE << "ReadWriteMutex (" << slots << " slots): " << osg::Timer::instance()->delta_u(t0, t1)*1000.0/runs
+              << " ns per pass on " << numThreads << " threads, one write per 1000 reads" << std::endl;
+      }
+
+      Threading::ReadWriteMutex mutex;
+      LockThread writer1( mutex, 100000, 1 ), writer2( mutex, 100000, 1 ), reader( mutex, 10000, 0, true );
+      writer1.start();
+      writer2.start();
+      reader.start();
+      writer1.join();
+      writer2.join();
+      reader.join();
+      if ( reader.getMaxReadWait() > 1000.0 )
+      {
+          OE_NOTICE << "Error:  A reader waited " << reader.getMaxReadWait() << " ms while writers kept arriving" << std::endl;
+          ++s_failures;
+      }
+      else
+      {
+          OE_NOTICE << "ReadWriteMutex: longest read wait with writers back to back " << reader.getMaxReadWait() << " ms" << std::endl;
+      }
+  }
+
+  //Cache chain replay.  Replays a tile access trace (the "cache.read" events of a trace recorded with
+  //OSGEARTH_ENABLE_TRACING, passed as --cache-trace, or else a synthetic one) through a memory and
+  //disk chain, with and without admission on the memory tier. Only first reads may miss.
+  {
+      const Profile* profile = osgEarth::Registry::instance()->getGlobalGeodeticProfile();
+      std::vector<TileKey> keys;
+      std::string traceFile;
+      if ( arguments.read("--cache-trace", traceFile) && !readCacheTrace(traceFile, profile, keys) )
+          OE_NOTICE << "No cache reads in " << traceFile << ", using a synthetic trace" << std::endl;
+      if ( keys.empty() )
+          makeCacheTrace( profile, 20000, keys );
+
+      std::set<std::string> distinct;
+      for( unsigned i=0; i<keys.size(); ++i )
+          distinct.insert( keys[i].str() );
+
+      // the disk tier outlives the test, so each run gets its own cache ID.
+      std::string runId = toString( osg::Timer::instance()->tick() );
+
+      for( int k=0; k<2; ++k )
+      {
+          bool admission = k == 0;
+
+          Config memTier( "tier" );
+          memTier.add( "driver", "memory" );
+          memTier.add( "max_tiles", "64" );
+          memTier.add( "admission", admission ? "true" : "false" );
+
+          Config diskTier( "tier" );
+          diskTier.add( "driver", "tms" );
+          diskTier.add( "path", "osgearth_tests_cache" );
+          diskTier.add( "codec", "raw" );
+
+          CacheChainOptions chainOpt;
+          chainOpt.tiers().push_back( CacheOptions(ConfigOptions(memTier)) );
+          chainOpt.tiers().push_back( CacheOptions(ConfigOptions(diskTier)) );
+
+          osg::ref_ptr<Cache> cache = CacheFactory::create( chainOpt );
+          if ( !cache.valid() )
+          {
+              OE_NOTICE << "Cache chain unavailable, skipped" << std::endl;
+              break;
+          }
+
+          CacheSpec spec( "replay_" + runId + "_" + toString(k), "png" );
+          double ms = 0.0;
+          unsigned misses = replayCacheTrace( cache.get(), spec, keys, ms );
+
+          // releasing the chain flushes its write-behind queue.
+          std::string name = cache->getName();
+          cache = 0L;
+
+          MetricsRegistry* metrics = osgEarth::Registry::instance()->getMetrics();
+          unsigned memoryHits = (unsigned)metrics->getCounter( "cache." + name + ".0_memory.hits" )->value();
+          unsigned diskHits   = (unsigned)metrics->getCounter( "cache." + name + ".1_tms.hits" )->value();
+          unsigned queuedHits = keys.size() - misses - memoryHits - diskHits;
+
+          if ( misses != distinct.size() )
+          {
+              OE_NOTICE << "Error:  Cache chain missed " << misses << " times on " << distinct.size() << " distinct tiles" << std::endl;
+              ++s_failures;
+          }
+          else
+          {
+              OE_NOTICE << "Cache chain replay (" << (admission ? "admission" : "no admission") << "): "
+                  << keys.size() << " reads of " << distinct.size() << " tiles, "
+                  << memoryHits << " memory hits, " << diskHits << " disk hits, "
+                  << queuedHits << " queued-write hits, " << misses << " misses in " << ms << " ms" << std::endl;
+          }
+      }
+  }
+
+  //Cache codec benchmark.  Writes and reads back an imagery tile through the cache codecs and
+  //through the PNG and osgb (zlib) paths the caches use otherwise, and compares time and size.
+  {
+      const int runs = 50;
+      osg::ref_ptr<osg::Image> image = new osg::Image();
+      image->allocateImage( 256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+      unsigned r = 1;
+      for( int t=0; t<image->t(); ++t )
+      {
+          for( int s=0; s<image->s(); ++s )
+          {
+              // smooth gradients with a little noise, about as compressible as imagery.
+              r = r * 1103515245u + 12345u;
+              unsigned char* p = image->data( s, t );
+              p[0] = (unsigned char)( s + ((r >> 16) & 7) );
+              p[1] = (unsigned char)( t + ((r >> 20) & 7) );
+              p[2] = (unsigned char)( (s * t) >> 8 );
+              p[3] = 255;
+          }
+      }
+      double rawMB = image->getTotalSizeInBytes() / (1024.0 * 1024.0);
+
+      const char* names[] = { "raw", "zlib", "png", "osgb" };
+      for( unsigned i=0; i<4; ++i )
+      {
+          osg::ref_ptr<CacheCodec> codec = i < 2 ? CacheCodec::create( names[i] ) : 0L;
+          if ( i < 2 && !codec.valid() )
+          {
+              OE_NOTICE << "Cache codec \"" << names[i] << "\" unavailable, skipped" << std::endl;
+              continue;
+          }
+
+          double writeMS, readMS;
+          unsigned bytes;
+          bool exact;
+          if ( !timeImageStorage(codec.get(), names[i], i == 3 ? "Compressor=zlib" : "", image.get(), runs, writeMS, readMS, bytes, exact) )
+          {
+              OE_NOTICE << "Tile format \"" << names[i] << "\" unavailable, skipped" << std::endl;
+              continue;
+          }
+
+          if ( codec.valid() && !exact )
+          {
+              OE_NOTICE << "Error:  Cache codec \"" << names[i] << "\" did not give back the pixels it stored" << std::endl;
+              ++s_failures;
+          }
+          else
+          {
+              OE_NOTICE << "Tile storage (" << names[i] << "): " << bytes << " bytes, write "
+                  << writeMS << " ms (" << rawMB * 1000.0 / writeMS << " MB/s), read " << readMS << " ms"
+                  << (exact ? "" : ", lossy") << std::endl;
+          }
+      }
+  }
+
+  //Heightfield storage report.  Size and worst-case error of elevation tiles stored through the cache
+  //codec (delta-coded, lossless or quantized) and held in memory as QuantizedHeightFields.
+  {
+      const int runs = 50;
+      osg::ref_ptr<osg::HeightField> hf = makeTerrainHeightField( 257 );
+      unsigned rawBytes = hf->getHeightList().size() * sizeof(float);
+
+      osg::ref_ptr<CacheCodec> codec = CacheCodec::create( "zlib" );
+      if ( !codec.valid() )
+          codec = CacheCodec::create( "raw" );
+
+      const float precisions[] = { 0.0f, 0.1f, 1.0f };
+      for( unsigned i=0; i<3; ++i )
+      {
+          float precision = precisions[i];
+          double allowed = precision > 0.0f ? 0.5*precision + 0.001 : 0.0;
+
+          codec->setHeightPrecision( precision );
+          std::string data;
+          osg::Timer_t t0 = osg::Timer::instance()->tick();
+          for( int k=0; k<runs; ++k )
+          {
+              data.clear();
+              codec->encode( hf.get(), data );
+          }
+          osg::Timer_t t1 = osg::Timer::instance()->tick();
+          osg::ref_ptr<osg::HeightField> decoded;
+          for( int k=0; k<runs; ++k )
+              decoded = codec->decodeHeightField( data );
+          osg::Timer_t t2 = osg::Timer::instance()->tick();
+
+          double error = maxHeightError( hf.get(), decoded.get() );
+          if ( error > allowed )
+          {
+              OE_NOTICE << "Error:  Heightfield through the \"" << codec->getName() << "\" codec at precision "
+                  << precision << " came back off by " << error << std::endl;
+              ++s_failures;
+          }
+          else
+          {
+              OE_NOTICE << "Heightfield storage (" << codec->getName() << " codec, precision " << precision << "): "
+                  << data.size() << " of " << rawBytes << " bytes, max error " << error << ", encode "
+                  << osg::Timer::instance()->delta_m(t0, t1)/runs << " ms, decode "
+                  << osg::Timer::instance()->delta_m(t1, t2)/runs << " ms" << std::endl;
+          }
+
+          if ( precision > 0.0f )
+          {
+              osg::ref_ptr<QuantizedHeightField> qhf = new QuantizedHeightField( hf.get(), precision );
+              osg::Timer_t t3 = osg::Timer::instance()->tick();
+              for( int k=0; k<runs; ++k )
+                  decoded = qhf->decode();
+              osg::Timer_t t4 = osg::Timer::instance()->tick();
+
+              error = maxHeightError( hf.get(), decoded.get() );
+              if ( error > allowed || error > qhf->getMaxError() + 0.001 )
+              {
+                  OE_NOTICE << "Error:  QuantizedHeightField at precision " << precision << " came back off by "
+                      << error << " (it reports " << qhf->getMaxError() << ")" << std::endl;
+                  ++s_failures;
+              }
+              else
+              {
+                  OE_NOTICE << "Heightfield storage (in memory, precision " << precision << "): "
+                      << qhf->getSizeInBytes() << " of " << rawBytes << " bytes, max error " << error << ", decode "
+                      << osg::Timer::instance()->delta_m(t3, t4)/runs << " ms" << std::endl;
+              }
+          }
+      }
+  }
+
+  if ( s_failures > 0 )
+  {
+      OE_NOTICE << s_failures << " check(s) failed" << std::endl;
+      return 1;
+  }
   return 0;
 }
 
@@ -0,0 +1,468 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/CacheCodec>
+#include <osgEarth/Metrics>
+#include <osgEarth/QuantizedHeightField>
+#include <osgEarth/Registry>
+#include <osgEarth/Notify>
+#include <string.h>
+#include <vector>
+
+#ifdef OSGEARTH_HAVE_ZLIB
+#  include <zlib.h>
+#endif
+
+#define LC "[CacheCodec] "
+
+using namespace osgEarth;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // Header: "OECC", version, kind, compression, byte order. The fields that
+    // follow are in the byte order of the machine that wrote them; data from
+    // a machine of the other byte order is rejected (i.e. treated as a miss).
+    const char          MAGIC[4] = { 'O', 'E', 'C', 'C' };
+    const unsigned char VERSION  = 1;
+
+    // Largest width, height or depth accepted when decoding. Anything bigger is
+    // corrupt (or hostile) data, and is rejected before allocating for it.
+    const unsigned int MAX_DIMENSION = 16384;
+
+    enum Kind
+    {
+        KIND_IMAGE                 = 1,
+        KIND_HEIGHTFIELD           = 2, // raw floats
+        KIND_HEIGHTFIELD_DELTA     = 3, // float bit patterns, predicted (lossless)
+        KIND_HEIGHTFIELD_QUANTIZED = 4  // 16-bit samples, predicted
+    };
+
+    unsigned char hostByteOrder()
+    {
+        unsigned short x = 1;
+        return *(unsigned char*)&x; // 1 = little endian
+    }
+
+    template<typename T>
+    void put( std::string& out, const T& value )
+    {
+        out.append( (const char*)&value, sizeof(T) );
+    }
+
+    void putHeader( std::string& out, unsigned char kind, unsigned char compression )
+    {
+        out.append( MAGIC, 4 );
+        put( out, VERSION );
+        put( out, kind );
+        put( out, compression );
+        put( out, hostByteOrder() );
+    }
+
+    struct Reader
+    {
+        Reader( const std::string& in ) : _in(in), _pos(0) { }
+
+        template<typename T>
+        bool get( T& value )
+        {
+            if ( _pos + sizeof(T) > _in.size() )
+                return false;
+            memcpy( &value, _in.data() + _pos, sizeof(T) );
+            _pos += sizeof(T);
+            return true;
+        }
+
+        const char* data() const { return _in.data() + _pos; }
+        unsigned int remaining() const { return (unsigned int)(_in.size() - _pos); }
+
+        const std::string&     _in;
+        std::string::size_type _pos;
+    };
+
+    bool getHeader( Reader& r, unsigned char& out_kind, unsigned char& out_compression )
+    {
+        if ( r.remaining() < 8 || memcmp(r.data(), MAGIC, 4) != 0 )
+            return false;
+        r._pos += 4;
+
+        unsigned char version, byteOrder;
+        r.get( version );
+        r.get( out_kind );
+        r.get( out_compression );
+        r.get( byteOrder );
+        return version == VERSION && byteOrder == hostByteOrder();
+    }
+
+    // Replaces each sample with its difference from the sample to its left
+    // (or above, at the start of a row), then splits the residuals into byte
+    // planes. Neighbouring heights are close, so the residuals are small and
+    // the high-order planes are long runs that deflate very well.
+    template<typename T>
+    void predict( const T* in, unsigned int columns, unsigned int rows, std::string& out )
+    {
+        unsigned int n = columns * rows;
+        std::vector<T> residuals( n );
+        for( unsigned int r = 0; r < rows; ++r )
+        {
+            unsigned int i = r * columns;
+            residuals[i] = r > 0 ? (T)(in[i] - in[i - columns]) : in[i];
+            for( unsigned int c = 1; c < columns; ++c )
+                residuals[i + c] = (T)(in[i + c] - in[i + c - 1]);
+        }
+
+        out.resize( n * sizeof(T) );
+        for( unsigned int b = 0; b < sizeof(T); ++b )
+        {
+            char* plane = &out[b * n];
+            for( unsigned int i = 0; i < n; ++i )
+                plane[i] = (char)(residuals[i] >> (8 * b));
+        }
+    }
+
+    // Inverse of predict().
+    template<typename T>
+    void unpredict( const char* in, unsigned int columns, unsigned int rows, T* out )
+    {
+        unsigned int n = columns * rows;
+        for( unsigned int i = 0; i < n; ++i )
+            out[i] = 0;
+        for( unsigned int b = 0; b < sizeof(T); ++b )
+        {
+            const unsigned char* plane = (const unsigned char*)in + b * n;
+            for( unsigned int i = 0; i < n; ++i )
+                out[i] |= (T)((T)plane[i] << (8 * b));
+        }
+
+        for( unsigned int r = 0; r < rows; ++r )
+        {
+            unsigned int i = r * columns;
+            if ( r > 0 )
+                out[i] = (T)(out[i] + out[i - columns]);
+            for( unsigned int c = 1; c < columns; ++c )
+                out[i + c] = (T)(out[i + c] + out[i + c - 1]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+CacheCodec*
+CacheCodec::create( const std::string& name )
+{
+    if ( name == "raw" )
+    {
+        return new CacheCodec( name, COMPRESSION_NONE );
+    }
+    else if ( name == "zlib" )
+    {
+#ifdef OSGEARTH_HAVE_ZLIB
+        return new CacheCodec( name, COMPRESSION_ZLIB );
+#else
+        OE_WARN << LC << "zlib codec requested, but osgEarth was built without zlib" << std::endl;
+        return 0L;
+#endif
+    }
+    else
+    {
+        OE_WARN << LC << "Unknown cache codec \"" << name << "\"" << std::endl;
+        return 0L;
+    }
+}
+
+const std::string&
+CacheCodec::getFormatName()
+{
+    static std::string s_format = "oecc";
+    return s_format;
+}
+
+CacheCodec::CacheCodec( const std::string& name, Compression compression ) :
+_name           ( name ),
+_compression    ( compression ),
+_heightPrecision( 0.0f )
+{
+    MetricsRegistry* metrics = Registry::instance()->getMetrics();
+    _encodeMetric = metrics->getHistogram( "cache.codec.encode" );
+    _decodeMetric = metrics->getHistogram( "cache.codec.decode" );
+
+    // quantization error is recorded in height units, not seconds
+    _heightErrorMetric    = metrics->getHistogram( "cache.codec.heightfield_error" );
+    _heightRawBytesMetric = metrics->getCounter( "cache.codec.heightfield_raw_bytes" );
+    _heightBytesMetric    = metrics->getCounter( "cache.codec.heightfield_bytes" );
+}
+
+bool
+CacheCodec::pack( const char* data, unsigned int size, std::string& out ) const
+{
+#ifdef OSGEARTH_HAVE_ZLIB
+    if ( _compression == COMPRESSION_ZLIB )
+    {
+        uLongf outSize = compressBound( size );
+        std::string::size_type offset = out.size();
+        out.resize( offset + outSize );
+        if ( compress2( (Bytef*)&out[offset], &outSize, (const Bytef*)data, size, Z_BEST_SPEED ) == Z_OK )
+        {
+            out.resize( offset + outSize );
+            return true;
+        }
+        out.resize( offset );
+        return false;
+    }
+#endif
+
+    out.append( data, size );
+    return true;
+}
+
+bool
+CacheCodec::unpack( Compression compression, const char* data, unsigned int size, char* out, unsigned int outSize ) const
+{
+    if ( compression == COMPRESSION_NONE )
+    {
+        if ( size != outSize )
+            return false;
+        memcpy( out, data, size );
+        return true;
+    }
+
+#ifdef OSGEARTH_HAVE_ZLIB
+    if ( compression == COMPRESSION_ZLIB )
+    {
+        uLongf len = outSize;
+        return
+            uncompress( (Bytef*)out, &len, (const Bytef*)data, size ) == Z_OK &&
+            len == outSize;
+    }
+#endif
+
+    OE_WARN << LC << "Cannot decode cached data (unsupported compression " << (int)compression << ")" << std::endl;
+    return false;
+}
+
+bool
+CacheCodec::encode( const osg::Image* image, std::string& out ) const
+{
+    if ( !image || !image->data() )
+        return false;
+
+    ScopedMetricTimer timer( _encodeMetric );
+
+    unsigned int size = image->getImageSizeInBytes();
+
+    out.clear();
+    out.reserve( 48 + size );
+    putHeader( out, KIND_IMAGE, (unsigned char)_compression );
+    put( out, (unsigned int)image->s() );
+    put( out, (unsigned int)image->t() );
+    put( out, (unsigned int)image->r() );
+    put( out, (unsigned int)image->getPixelFormat() );
+    put( out, (unsigned int)image->getDataType() );
+    put( out, (unsigned int)image->getInternalTextureFormat() );
+    put( out, (unsigned int)image->getPacking() );
+    put( out, size );
+
+    return pack( (const char*)image->data(), size, out );
+}
+
+bool
+CacheCodec::encode( const osg::HeightField* hf, std::string& out ) const
+{
+    if ( !hf || hf->getHeightList().empty() )
+        return false;
+
+    ScopedMetricTimer timer( _encodeMetric );
+
+    const osg::HeightField::HeightList& heights = hf->getHeightList();
+    unsigned int columns = hf->getNumColumns();
+    unsigned int rows    = hf->getNumRows();
+    if ( heights.size() != (unsigned long long)columns * rows )
+        return false;
+
+    unsigned char kind = KIND_HEIGHTFIELD;
+    osg::ref_ptr<QuantizedHeightField> qhf;
+    std::string payload;
+
+    if ( _heightPrecision > 0.0f )
+    {
+        kind = KIND_HEIGHTFIELD_QUANTIZED;
+        qhf = new QuantizedHeightField( hf, _heightPrecision );
+        predict( &qhf->getSamples().front(), columns, rows, payload );
+        _heightErrorMetric->record( qhf->getMaxError() );
+        if ( qhf->isCoarsened() )
+        {
+            OE_DEBUG << LC << "Height range only fits in 16 bits at a precision of " << qhf->getScale()
+                << " (asked for " << _heightPrecision << ")" << std::endl;
+        }
+    }
+    else if ( _compression != COMPRESSION_NONE )
+    {
+        // no point predicting if nothing is going to compress the residuals
+        kind = KIND_HEIGHTFIELD_DELTA;
+        std::vector<unsigned int> bits( heights.size() );
+        memcpy( &bits.front(), &heights.front(), heights.size() * sizeof(float) );
+        predict( &bits.front(), columns, rows, payload );
+    }
+
+    const char*  data = payload.empty() ? (const char*)&heights.front() : payload.data();
+    unsigned int size = payload.empty() ? heights.size() * sizeof(float) : payload.size();
+
+    out.clear();
+    out.reserve( 88 + size );
+    putHeader( out, kind, (unsigned char)_compression );
+    put( out, columns );
+    put( out, rows );
+    put( out, (double)hf->getOrigin().x() );
+    put( out, (double)hf->getOrigin().y() );
+    put( out, (double)hf->getOrigin().z() );
+    put( out, (double)hf->getXInterval() );
+    put( out, (double)hf->getYInterval() );
+    put( out, (float)hf->getSkirtHeight() );
+    put( out, (unsigned int)hf->getBorderWidth() );
+    if ( qhf.valid() )
+    {
+        put( out, qhf->getOffset() );
+        put( out, qhf->getScale() );
+    }
+    put( out, size );
+
+    if ( !pack(data, size, out) )
+        return false;
+
+    _heightRawBytesMetric->add( heights.size() * sizeof(float) );
+    _heightBytesMetric->add( out.size() );
+    return true;
+}
+
+osg::Image*
+CacheCodec::decodeImage( const std::string& in ) const
+{
+    ScopedMetricTimer timer( _decodeMetric );
+
+    Reader r( in );
+    unsigned char kind, compression;
+    if ( !getHeader(r, kind, compression) || kind != KIND_IMAGE )
+        return 0L;
+
+    unsigned int s, t, depth, pixelFormat, dataType, internalFormat, packing, size;
+    if (!r.get(s) || !r.get(t) || !r.get(depth) || !r.get(pixelFormat) || !r.get(dataType) ||
+        !r.get(internalFormat) || !r.get(packing) || !r.get(size) )
+    {
+        return 0L;
+    }
+
+    if (s == 0 || s > MAX_DIMENSION || t == 0 || t > MAX_DIMENSION || depth == 0 || depth > MAX_DIMENSION ||
+        (packing != 1 && packing != 2 && packing != 4 && packing != 8) )
+    {
+        return 0L;
+    }
+
+    // the size the header claims has to be the size of the image it describes
+    // (worked out in 64 bits, so a huge image can't wrap around to a small one).
+    unsigned int rowBytes = osg::Image::computeRowWidthInBytes( s, (GLenum)pixelFormat, (GLenum)dataType, packing );
+    unsigned long long expected = (unsigned long long)rowBytes * t * depth;
+    if ( rowBytes == 0 || expected != (unsigned long long)size )
+        return 0L;
+
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage( s, t, depth, (GLenum)pixelFormat, (GLenum)dataType, packing );
+    if ( !image->data() || image->getImageSizeInBytes() != size )
+        return 0L;
+
+    if ( !unpack((Compression)compression, r.data(), r.remaining(), (char*)image->data(), size) )
+        return 0L;
+
+    image->setInternalTextureFormat( (GLint)internalFormat );
+    return image.release();
+}
+
+osg::HeightField*
+CacheCodec::decodeHeightField( const std::string& in ) const
+{
+    ScopedMetricTimer timer( _decodeMetric );
+
+    Reader r( in );
+    unsigned char kind, compression;
+    if ( !getHeader(r, kind, compression) )
+        return 0L;
+
+    if ( kind != KIND_HEIGHTFIELD && kind != KIND_HEIGHTFIELD_DELTA && kind != KIND_HEIGHTFIELD_QUANTIZED )
+        return 0L;
+
+    unsigned int columns, rows, borderWidth, size;
+    double x, y, z, dx, dy;
+    float skirt, offset = 0.0f, scale = 1.0f;
+    if (!r.get(columns) || !r.get(rows) || !r.get(x) || !r.get(y) || !r.get(z) ||
+        !r.get(dx) || !r.get(dy) || !r.get(skirt) || !r.get(borderWidth) )
+    {
+        return 0L;
+    }
+
+    if ( kind == KIND_HEIGHTFIELD_QUANTIZED && (!r.get(offset) || !r.get(scale)) )
+        return 0L;
+
+    if ( !r.get(size) )
+        return 0L;
+
+    if ( columns == 0 || columns > MAX_DIMENSION || rows == 0 || rows > MAX_DIMENSION )
+        return 0L;
+
+    unsigned int count = columns * rows; // can't overflow given the limits above
+    unsigned long long sampleSize = kind == KIND_HEIGHTFIELD_QUANTIZED ? sizeof(unsigned short) : sizeof(float);
+    if ( (unsigned long long)size != (unsigned long long)count * sampleSize )
+        return 0L;
+
+    osg::ref_ptr<osg::HeightField> hf;
+
+    if ( kind == KIND_HEIGHTFIELD )
+    {
+        hf = new osg::HeightField();
+        hf->allocate( columns, rows );
+        if ( !unpack((Compression)compression, r.data(), r.remaining(), (char*)&hf->getHeightList().front(), size) )
+            return 0L;
+    }
+    else
+    {
+        std::string payload( size, '\0' );
+        if ( !unpack((Compression)compression, r.data(), r.remaining(), &payload[0], size) )
+            return 0L;
+
+        if ( kind == KIND_HEIGHTFIELD_QUANTIZED )
+        {
+            osg::ref_ptr<QuantizedHeightField> qhf = new QuantizedHeightField( columns, rows, offset, scale );
+            unpredict( payload.data(), columns, rows, &qhf->getSamples().front() );
+            hf = qhf->decode();
+        }
+        else
+        {
+            std::vector<unsigned int> bits( count );
+            unpredict( payload.data(), columns, rows, &bits.front() );
+            hf = new osg::HeightField();
+            hf->allocate( columns, rows );
+            memcpy( &hf->getHeightList().front(), &bits.front(), count * sizeof(float) );
+        }
+    }
+
+    hf->setOrigin( osg::Vec3d(x, y, z) );
+    hf->setXInterval( dx );
+    hf->setYInterval( dy );
+    hf->setSkirtHeight( skirt );
+    hf->setBorderWidth( borderWidth );
+    return hf.release();
+}
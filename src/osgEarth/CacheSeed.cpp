@@ -25,6 +25,31 @@
 using namespace osgEarth;
 using namespace OpenThreads;
 
+namespace
+{
+    // Whether a layer's cache already holds every tile the layer needs for a map
+    // key. With a DiskCache presence index this never touches the file system.
+    bool isCached( TerrainLayer* layer, const TileKey& key )
+    {
+        Cache* cache = layer->getCache();
+        if ( !cache || !layer->getProfile() )
+            return false;
+
+        std::vector<TileKey> keys;
+        if ( key.getProfile()->isEquivalentTo( layer->getProfile() ) )
+            keys.push_back( key );
+        else
+            layer->getProfile()->getIntersectingTiles( key, keys );
+
+        for( unsigned int i = 0; i < keys.size(); ++i )
+        {
+            if ( layer->isKeyValid(keys[i]) && !cache->isCached(keys[i], layer->getCacheSpec()) )
+                return false;
+        }
+        return true;
+    }
+}
+
 void CacheSeed::seed( Map* map )
 {
     //Threading::ScopedReadLock lock( map->getMapDataMutex() );
@@ -191,7 +216,7 @@ CacheSeed::cacheTile(const MapFrame& mapf, const TileKey& key ) const
     for( ImageLayerVector::const_iterator i = mapf.imageLayers().begin(); i != mapf.imageLayers().end(); i++ )
     {
         ImageLayer* layer = i->get();
-        if ( layer->isKeyValid( key ) )
+        if ( layer->isKeyValid( key ) && !isCached(layer, key) )
         {
             GeoImage image = layer->createImage( key );
         }
@@ -199,7 +224,17 @@ CacheSeed::cacheTile(const MapFrame& mapf, const TileKey& key ) const
 
     if ( mapf.elevationLayers().size() > 0 )
     {
-        osg::ref_ptr<osg::HeightField> hf;
-        mapf.getHeightField( key, false, hf );
+        // elevation layers are composited, so skip only if they're all cached.
+        bool cached = true;
+        for( ElevationLayerVector::const_iterator i = mapf.elevationLayers().begin(); i != mapf.elevationLayers().end() && cached; ++i )
+        {
+            cached = isCached( i->get(), key );
+        }
+
+        if ( !cached )
+        {
+            osg::ref_ptr<osg::HeightField> hf;
+            mapf.getHeightField( key, false, hf );
+        }
     }
 }
@@ -17,12 +17,24 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
 #include <iomanip>
+#include <iterator>
+#include <set>
 
 #include <osgEarth/Caching>
 #include <osgEarth/ImageToHeightFieldConverter>
 #include <osgEarth/FileUtils>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/Metrics>
+#include <osgEarth/QuantizedHeightField>
+#include <osgEarth/Registry>
+#include <osgEarth/TaskService>
 #include <osgEarth/ThreadingUtils>
 
 #include <osgDB/FileUtils>
@@ -83,31 +95,470 @@ Cache::setHeightField( const TileKey& key, const CacheSpec& spec, const osg::Hei
 
 static Threading::ReadWriteMutex s_mutex;
 
+// Moves a fully written temporary file over the target. rename() replaces the
+// target atomically on POSIX; Windows refuses to rename onto an existing file,
+// so there the target has to go first.
+static bool replaceFile( const std::string& tempname, const std::string& filename )
+{
+#ifdef _WIN32
+    ::remove( filename.c_str() );
+#endif
+    if ( ::rename(tempname.c_str(), filename.c_str()) != 0 )
+    {
+        ::remove( tempname.c_str() );
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+// Which tile files exist under one cache ID folder. Entries are 64-bit hashes
+// of the file's path relative to that folder, which keeps the index the same
+// whatever the folder layout (DiskCache and TMSCache differ) at 8 bytes a tile.
+// Tiles are in a sorted vector, with recent additions in a set that is merged
+// in now and then.
+class DiskCache::PresenceIndex : public osg::Referenced
+{
+public:
+    // Walks the folder in the background.
+    struct BuildTask : public TaskRequest
+    {
+        BuildTask( PresenceIndex* index ) : _index(index) { }
+        void operator()( ProgressCallback* progress ) { _index->build(); }
+        osg::ref_ptr<PresenceIndex> _index;
+    };
+
+    enum { MERGE_THRESHOLD = 4096 };
+
+    PresenceIndex( const std::string& root ) :
+    _root    ( root ),
+    _ready   ( false ),
+    _canceled( false ),
+    _dirty   ( false )
+    {
+        //nop
+    }
+
+    /** Hashes a tile filename; false if the file is not under this index's folder. */
+    bool hash( const std::string& filename, unsigned long long& out ) const
+    {
+        if ( filename.size() <= _root.size() + 1 || filename.compare(0, _root.size(), _root) != 0 )
+            return false;
+        out = hashPath( filename.c_str() + _root.size() + 1 );
+        return true;
+    }
+
+    /** Whether the index is complete, i.e. usable for lookups. */
+    bool isReady() const { return _ready; }
+
+    void cancel() { _canceled = true; }
+
+    bool contains( unsigned long long h ) const
+    {
+        Threading::ScopedReadLock lock( _mutex );
+        return std::binary_search( _sorted.begin(), _sorted.end(), h ) || _added.find( h ) != _added.end();
+    }
+
+    void insert( unsigned long long h )
+    {
+        Threading::ScopedWriteLock lock( _mutex );
+        if ( std::binary_search(_sorted.begin(), _sorted.end(), h) )
+            return;
+        if ( _added.insert(h).second )
+            _dirty = true;
+        if ( _ready && _added.size() >= MERGE_THRESHOLD )
+            merge();
+    }
+
+    void build()
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        std::vector<unsigned long long> found;
+        scan( _root, "", found );
+        if ( _canceled )
+            return;
+
+        std::sort( found.begin(), found.end() );
+        found.erase( std::unique(found.begin(), found.end()), found.end() );
+
+        unsigned int count;
+        {
+            Threading::ScopedWriteLock lock( _mutex );
+            _sorted.swap( found );
+            merge(); // tiles written while we were scanning
+            count  = _sorted.size();
+            _ready = true;
+            _dirty = true;
+        }
+
+        OE_INFO << LC << "Indexed " << count << " tiles in " << _root << " ("
+            << osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) << "s)" << std::endl;
+
+        save();
+    }
+
+    bool load()
+    {
+        std::string filename = getFilename();
+        std::ifstream in( filename.c_str(), std::ios::in | std::ios::binary );
+        if ( !in.is_open() )
+            return false;
+
+        in.seekg( 0, std::ios::end );
+        std::streamoff size = in.tellg();
+        in.seekg( 0, std::ios::beg );
+
+        char magic[4];
+        unsigned char version = 0, byteOrder = 0;
+        unsigned long long stamp = 0, count = 0;
+        in.read( magic, 4 );
+        in.read( (char*)&version, 1 );
+        in.read( (char*)&byteOrder, 1 );
+        in.read( (char*)&stamp, sizeof(stamp) );
+        in.read( (char*)&count, sizeof(count) );
+
+        if ( !in.fail() && memcmp(magic, "OEPI", 4) == 0 && version != VERSION )
+        {
+            OE_INFO << LC << "Presence index " << filename << " is from an older version; rebuilding" << std::endl;
+            return false;
+        }
+
+        const std::streamoff headerSize = 6 + sizeof(stamp) + sizeof(count);
+        if (in.fail() || memcmp(magic, "OEPI", 4) != 0 || byteOrder != hostByteOrder() ||
+            size != headerSize + (std::streamoff)(count * sizeof(unsigned long long)) )
+        {
+            OE_WARN << LC << "Ignoring invalid presence index " << filename << std::endl;
+            return false;
+        }
+
+        // something else changed the folder since the index was saved:
+        if ( stamp != getStamp() )
+        {
+            OE_INFO << LC << "Presence index " << filename << " is out of date; rebuilding" << std::endl;
+            return false;
+        }
+
+        std::vector<unsigned long long> hashes( (std::vector<unsigned long long>::size_type)count );
+        if ( count > 0 )
+        {
+            in.read( (char*)&hashes.front(), count * sizeof(unsigned long long) );
+            if ( in.fail() )
+                return false;
+        }
+
+        {
+            Threading::ScopedWriteLock lock( _mutex );
+            _sorted.swap( hashes );
+            merge();
+            _ready = true;
+        }
+
+        OE_INFO << LC << "Loaded presence index for " << count << " tiles from " << filename << std::endl;
+        return true;
+    }
+
+    void save()
+    {
+        std::vector<unsigned long long> hashes;
+        {
+            Threading::ScopedWriteLock lock( _mutex );
+            if ( !_ready || !_dirty )
+                return;
+            merge();
+            hashes = _sorted;
+            _dirty = false;
+        }
+
+        unsigned long long stamp = getStamp();
+
+        // write to a temporary file first so a crash never leaves a truncated index.
+        std::string filename = getFilename();
+        std::string tempname = filename + ".tmp";
+        {
+            std::ofstream out( tempname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+            if ( !out.is_open() )
+                return;
+
+            unsigned char version = VERSION, byteOrder = hostByteOrder();
+            unsigned long long count = hashes.size();
+            out.write( "OEPI", 4 );
+            out.write( (const char*)&version, 1 );
+            out.write( (const char*)&byteOrder, 1 );
+            out.write( (const char*)&stamp, sizeof(stamp) );
+            out.write( (const char*)&count, sizeof(count) );
+            if ( count > 0 )
+                out.write( (const char*)&hashes.front(), count * sizeof(unsigned long long) );
+            if ( out.fail() )
+            {
+                out.close();
+                ::remove( tempname.c_str() );
+                return;
+            }
+        }
+
+        if ( !replaceFile(tempname, filename) )
+            OE_WARN << LC << "Failed to write presence index " << filename << std::endl;
+    }
+
+private:
+    // version 2 added the folder stamp.
+    enum { VERSION = 2 };
+
+    std::string getFilename() const { return _root + "/presence.idx"; }
+
+    // Sum of the modification times of the level folders under the root. Adding or
+    // removing a level, or a column within a level, changes it; so does a purge that
+    // deletes whole levels. Single tiles deep in the tree don't, which is the price of
+    // not walking the whole tree at startup. (The root's own time is left out since
+    // saving the index changes it.)
+    unsigned long long getStamp() const
+    {
+        unsigned long long stamp = 0;
+        osgDB::DirectoryContents contents = osgDB::getDirectoryContents( _root );
+        for( osgDB::DirectoryContents::const_iterator i = contents.begin(); i != contents.end(); ++i )
+        {
+            const std::string& name = *i;
+            if ( name.empty() || name[0] == '.' || name.find('.') != std::string::npos )
+                continue;
+
+            struct stat buf;
+            if ( ::stat((_root + "/" + name).c_str(), &buf) == 0 )
+                stamp += (unsigned long long)buf.st_mtime;
+        }
+        return stamp;
+    }
+
+    static unsigned char hostByteOrder()
+    {
+        unsigned short x = 1;
+        return *(unsigned char*)&x;
+    }
+
+    // 64-bit FNV-1a, with either slash accepted as the separator.
+    static unsigned long long hashPath( const char* path )
+    {
+        unsigned long long h = 14695981039346656037ULL;
+        for( ; *path; ++path )
+        {
+            h ^= (unsigned char)(*path == '\\' ? '/' : *path);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    void scan( const std::string& dir, const std::string& relative, std::vector<unsigned long long>& out )
+    {
+        osgDB::DirectoryContents contents = osgDB::getDirectoryContents( dir );
+        for( osgDB::DirectoryContents::const_iterator i = contents.begin(); i != contents.end() && !_canceled; ++i )
+        {
+            const std::string& name = *i;
+            if ( name.empty() || name[0] == '.' )
+                continue;
+
+            std::string path = relative.empty() ? name : relative + "/" + name;
+
+            // Tile folders are plain numbers and tile files have extensions, so
+            // we can tell them apart without a stat per entry. Stray files (world
+            // files, tms.xml) get indexed too, which does no harm.
+            if ( name.find('.') != std::string::npos )
+                out.push_back( hashPath(path.c_str()) );
+            else
+                scan( dir + "/" + name, path, out );
+        }
+    }
+
+    // call with the write lock held.
+    void merge()
+    {
+        if ( _added.empty() )
+            return;
+        std::vector<unsigned long long> merged;
+        merged.reserve( _sorted.size() + _added.size() );
+        std::set_union( _sorted.begin(), _sorted.end(), _added.begin(), _added.end(), std::back_inserter(merged) );
+        _sorted.swap( merged );
+        _added.clear();
+    }
+
+    std::string                       _root;
+    std::vector<unsigned long long>   _sorted;
+    std::set<unsigned long long>      _added;
+    mutable Threading::ReadWriteMutex _mutex;
+    volatile bool                     _ready, _canceled, _dirty;
+};
+
+//------------------------------------------------------------------------
+
 DiskCache::DiskCache( const DiskCacheOptions& options ) :
 Cache( options ),
 _options( options )
 {
     setName( "tilecache" );
     _writeWorldFilesOverride = getenv("OSGEARTH_WRITE_WORLD_FILES") != 0L;
+
+    if ( _options.codec().isSet() )
+    {
+        _codec = CacheCodec::create( _options.codec().value() );
+        if ( _codec.valid() )
+        {
+            OE_INFO << LC << "Storing tiles with the \"" << _codec->getName() << "\" codec" << std::endl;
+            if ( _options.heightPrecision().isSet() )
+                _codec->setHeightPrecision( *_options.heightPrecision() );
+        }
+        else
+        {
+            OE_WARN << LC << "Falling back on the layer image format" << std::endl;
+        }
+    }
 }
 
 DiskCache::DiskCache( const DiskCache& rhs, const osg::CopyOp& op ) :
 Cache( rhs, op ),
 _layerPropertiesCache( rhs._layerPropertiesCache ),
 _writeWorldFilesOverride( rhs._writeWorldFilesOverride ),
+_codec( rhs._codec ),
 _options( rhs._options )
 {
-    //NOP
+    //NOP - a copy builds (or loads) its own presence indexes
+}
+
+DiskCache::~DiskCache()
+{
+    // stop any index builds, then save what we learned for next time.
+    for( PresenceIndexMap::iterator i = _presenceIndexes.begin(); i != _presenceIndexes.end(); ++i )
+    {
+        if ( i->second.valid() )
+            i->second->cancel();
+    }
+
+    _presenceIndexService = 0L;
+
+    for( PresenceIndexMap::iterator i = _presenceIndexes.begin(); i != _presenceIndexes.end(); ++i )
+    {
+        if ( i->second.valid() )
+            i->second->save();
+    }
 }
 
 bool
 DiskCache::isCached(const osgEarth::TileKey& key, const CacheSpec& spec ) const
 {
+	std::string filename = getStorageFilename( key, spec );
+
+    // answer from memory if we can:
+    PresenceIndex* index = getPresenceIndex( spec.cacheId() );
+    unsigned long long hash;
+    if ( index && index->isReady() && index->hash(filename, hash) )
+        return index->contains( hash );
+
 	//Check to see if the file for this key exists
-	std::string filename = getFilename( key, spec );
     return osgDB::fileExists(filename);
 }
 
+DiskCache::PresenceIndex*
+DiskCache::getPresenceIndex( const std::string& cacheId ) const
+{
+    if ( _options.presenceIndex() != true )
+        return 0L;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _presenceIndexMutex );
+
+    PresenceIndexMap::const_iterator i = _presenceIndexes.find( cacheId );
+    if ( i != _presenceIndexes.end() )
+        return i->second.get();
+
+    // there's no listing the contents of a zip, so no index (recorded as NULL).
+    std::string root = getPath() + "/" + cacheId;
+    osg::ref_ptr<PresenceIndex> index;
+    if ( !osgEarth::isZipPath(root) )
+    {
+        index = new PresenceIndex( root );
+        if ( !index->load() )
+        {
+            if ( !_presenceIndexService.valid() )
+                _presenceIndexService = new TaskService( "DiskCache Index Service", 1 );
+
+            OE_INFO << LC << "Building presence index for " << root << std::endl;
+            _presenceIndexService->add( new PresenceIndex::BuildTask(index.get()) );
+        }
+    }
+
+    _presenceIndexes[cacheId] = index.get();
+    return index.get();
+}
+
+void
+DiskCache::addToPresenceIndex( const CacheSpec& spec, const std::string& filename )
+{
+    PresenceIndex* index = getPresenceIndex( spec.cacheId() );
+    unsigned long long hash;
+    if ( index && index->hash(filename, hash) )
+        index->insert( hash );
+}
+
+std::string
+DiskCache::getStorageFilename( const TileKey& key, const CacheSpec& spec ) const
+{
+    std::string filename = getFilename( key, spec );
+    if ( _codec.valid() && !osgEarth::isZipPath(filename) )
+        filename = osgDB::getNameLessExtension( filename ) + "." + CacheCodec::getFormatName();
+    return filename;
+}
+
+bool
+DiskCache::readEncoded( const std::string& filename, std::string& out ) const
+{
+    Threading::ScopedReadLock lock(s_mutex);
+
+    std::ifstream in( filename.c_str(), std::ios::in | std::ios::binary );
+    if ( !in.is_open() )
+        return false;
+
+    in.seekg( 0, std::ios::end );
+    std::streamoff size = in.tellg();
+    in.seekg( 0, std::ios::beg );
+    if ( size <= 0 )
+        return false;
+
+    out.resize( (std::string::size_type)size );
+    in.read( &out[0], size );
+    return !in.fail();
+}
+
+bool
+DiskCache::writeEncoded( const std::string& filename, const std::string& data )
+{
+    std::string path = osgDB::getFilePath(filename);
+
+    Threading::ScopedWriteLock lock(s_mutex);
+
+    if (!osgDB::fileExists(path) && !osgDB::makeDirectory(path))
+    {
+        OE_WARN << LC << "Couldn't create path " << path << std::endl;
+        return false;
+    }
+
+    // write to a temporary file and move it into place, so that a reader never sees
+    // a partly written tile and a crash never leaves a truncated one behind.
+    std::string tempname = filename + ".tmp";
+    {
+        std::ofstream out( tempname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+        if ( !out.is_open() )
+            return false;
+
+        out.write( data.data(), data.size() );
+        if ( out.fail() )
+        {
+            out.close();
+            ::remove( tempname.c_str() );
+            return false;
+        }
+    }
+
+    return replaceFile( tempname, filename );
+}
+
 std::string
 DiskCache::getPath() const
 {
@@ -152,7 +603,15 @@ DiskCache::getFilename(const osgEarth::TileKey& key, const CacheSpec& spec ) con
 bool
 DiskCache::getImage( const TileKey& key, const CacheSpec& spec, osg::ref_ptr<const osg::Image>& out_image )
 {
-	std::string filename = getFilename(key, spec);
+	std::string filename = getStorageFilename(key, spec);
+
+    if ( _codec.valid() && !osgEarth::isZipPath(filename) )
+    {
+        std::string data;
+        if ( readEncoded(filename, data) )
+            out_image = _codec->decodeImage( data );
+        return out_image.valid();
+    }
 
     //If the path doesn't contain a zip file, check to see that it actually exists on disk
     if (!osgEarth::isZipPath(filename))
@@ -175,7 +634,17 @@ DiskCache::getImage( const TileKey& key, const CacheSpec& spec, osg::ref_ptr<con
 void 
 DiskCache::setImage( const TileKey& key, const CacheSpec& spec, const osg::Image* image)
 {
-	std::string filename = getFilename( key, spec );
+	std::string filename = getStorageFilename( key, spec );
+
+    if ( _codec.valid() && !osgEarth::isZipPath(filename) )
+    {
+        // encode outside the lock so that writers only serialize on the file I/O.
+        std::string data;
+        if ( _codec->encode(image, data) && writeEncoded(filename, data) )
+            addToPresenceIndex( spec, filename );
+        return;
+    }
+
     std::string path = osgDB::getFilePath(filename);
 	std::string extension = spec.format();
 
@@ -254,15 +723,47 @@ DiskCache::setImage( const TileKey& key, const CacheSpec& spec, const osg::Image
     {
 		//Take a reference so the converted image will be deleted
 		osg::ref_ptr<osg::Image> rgb = ImageUtils::convertToRGB8( image );
-		if (rgb.valid())
+		if (rgb.valid() && osgDB::writeImageFile(*rgb.get(), filename))
 		{
-			osgDB::writeImageFile(*rgb.get(), filename);
+			addToPresenceIndex( spec, filename );
 		}
     }
-    else
+    else if ( osgDB::writeImageFile(*image, filename) )
+    {
+        addToPresenceIndex( spec, filename );
+    }
+}
+
+bool
+DiskCache::getHeightField( const TileKey& key, const CacheSpec& spec, osg::ref_ptr<const osg::HeightField>& out_hf )
+{
+    std::string filename = getStorageFilename( key, spec );
+
+    if ( _codec.valid() && !osgEarth::isZipPath(filename) )
+    {
+        std::string data;
+        if ( readEncoded(filename, data) )
+            out_hf = _codec->decodeHeightField( data );
+        return out_hf.valid();
+    }
+
+    return Cache::getHeightField( key, spec, out_hf );
+}
+
+void
+DiskCache::setHeightField( const TileKey& key, const CacheSpec& spec, const osg::HeightField* hf )
+{
+    std::string filename = getStorageFilename( key, spec );
+
+    if ( _codec.valid() && !osgEarth::isZipPath(filename) )
     {
-        osgDB::writeImageFile(*image, filename);
+        std::string data;
+        if ( _codec->encode(hf, data) && writeEncoded(filename, data) )
+            addToPresenceIndex( spec, filename );
+        return;
     }
+
+    Cache::setHeightField( key, spec, hf );
 }
 
 std::string
@@ -334,14 +835,30 @@ DiskCache::loadProperties(const std::string&           cacheId,
 #define LC "[MemCache] "
 
 MemCache::MemCache( int maxSize ):
-_maxNumTilesInCache( maxSize )
+_maxNumTilesInCache( maxSize ),
+_heightPrecision   ( 0.0f )
 {
     setName( "mem" );
+    initMetrics();
 }
 
 MemCache::MemCache( const MemCache& rhs, const osg::CopyOp& op ) :
-_maxNumTilesInCache( rhs._maxNumTilesInCache )
+_maxNumTilesInCache( rhs._maxNumTilesInCache ),
+_heightPrecision   ( rhs._heightPrecision )
+{
+    initMetrics();
+}
+
+void
+MemCache::initMetrics()
 {
+    // quantization error is recorded in height units, not seconds
+    MetricsRegistry* metrics = Registry::instance()->getMetrics();
+    _heightErrorMetric    = metrics->getHistogram( "cache.memory.heightfield_error" );
+
+    // running totals of what went in; eviction doesn't take anything back out.
+    _heightRawBytesMetric = metrics->getCounter( "cache.memory.heightfield_raw_bytes_written" );
+    _heightBytesMetric    = metrics->getCounter( "cache.memory.heightfield_bytes_written" );
 }
 
 unsigned int
@@ -381,6 +898,12 @@ MemCache::getHeightField( const TileKey& key,const CacheSpec& spec, osg::ref_ptr
     if ( getObject(key, spec, result) )
     {
         out_hf = dynamic_cast<const osg::HeightField*>(result.get());
+        if ( !out_hf.valid() )
+        {
+            const QuantizedHeightField* qhf = dynamic_cast<const QuantizedHeightField*>(result.get());
+            if ( qhf )
+                out_hf = qhf->decode();
+        }
         return out_hf.valid();
     }
     else return false;
@@ -389,7 +912,23 @@ MemCache::getHeightField( const TileKey& key,const CacheSpec& spec, osg::ref_ptr
 void
 MemCache::setHeightField( const TileKey& key, const CacheSpec& spec, const osg::HeightField* hf)
 {
-    setObject( key, spec, new osg::HeightField(*hf) );
+    if ( _heightPrecision > 0.0f )
+    {
+        QuantizedHeightField* qhf = new QuantizedHeightField( hf, _heightPrecision );
+        _heightErrorMetric->record( qhf->getMaxError() );
+        _heightRawBytesMetric->add( hf->getHeightList().size() * sizeof(float) );
+        _heightBytesMetric->add( qhf->getSizeInBytes() );
+        if ( qhf->isCoarsened() )
+        {
+            OE_DEBUG << LC << "Height range of " << key.str() << " only fits in 16 bits at a precision of "
+                << qhf->getScale() << " (asked for " << _heightPrecision << ")" << std::endl;
+        }
+        setObject( key, spec, qhf );
+    }
+    else
+    {
+        setObject( key, spec, new osg::HeightField(*hf) );
+    }
 }
 
 bool
@@ -412,14 +951,12 @@ MemCache::getObject( const TileKey& key, const CacheSpec& spec, osg::ref_ptr<con
 {
   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 
-  std::string id = key.str() + spec.cacheId();
+  ObjectKey id( key.getQuadKey(), spec.cacheId() );
   KeyToIteratorMap::iterator itr = _keyToIterMap.find(id);
   if (itr != _keyToIterMap.end())
   {
-    CachedObject entry = *itr->second;
-    _objects.erase(itr->second);
-    _objects.push_front(entry);
-    itr->second = _objects.begin();
+    // move the entry to the front of the LRU list:
+    _objects.splice( _objects.begin(), _objects, itr->second );
     output = itr->second->_object.get();
     return output.valid();
   }
@@ -431,7 +968,15 @@ MemCache::setObject( const TileKey& key, const CacheSpec& spec, const osg::Objec
 {
   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 
-  std::string id = key.str() + spec.cacheId();
+  ObjectKey id( key.getQuadKey(), spec.cacheId() );
+
+  // replace any existing entry so the LRU list holds one entry per key:
+  KeyToIteratorMap::iterator existing = _keyToIterMap.find(id);
+  if ( existing != _keyToIterMap.end() )
+  {
+      _objects.erase( existing->second );
+      _keyToIterMap.erase( existing );
+  }
 
   _objects.push_front(CachedObject());
   CachedObject& entry = _objects.front();
@@ -457,7 +1002,7 @@ bool
 MemCache::isCached(const osgEarth::TileKey& key, const CacheSpec& spec) const
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock( const_cast<MemCache*>(this)->_mutex);
-    std::string id = key.str() + spec.cacheId();
+    ObjectKey id( key.getQuadKey(), spec.cacheId() );
     return _keyToIterMap.find(id) != _keyToIterMap.end();
 	//osg::ref_ptr<osg::Image> image = getImage(key,spec);
 	//return image.valid();
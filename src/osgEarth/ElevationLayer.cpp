@@ -18,6 +18,7 @@
  */
 #include <osgEarth/ElevationLayer>
 #include <osgEarth/Registry>
+#include <osgEarth/Tracing>
 #include <osg/Version>
 
 using namespace osgEarth;
@@ -122,6 +123,8 @@ ElevationLayer::init()
 {
     //TODO: probably should graduate this to the superclass.
     _actualEnabled = _options.enabled().value();
+
+    initMetrics();
 }
 
 std::string
@@ -194,6 +197,8 @@ ElevationLayer::createGeoHeightField(const TileKey& key, ProgressCallback* progr
         //Only try to get data if the source actually has data
         if (source->hasData( key ) )
         {
+            ScopedMetricTimer fetchTimer( _fetchMetric );
+            OE_TRACE_SCOPE( "source.fetch", key.str(), getName() );
             hf = source->createHeightField( key, _preCacheOp.get(), progress );
 
             //Blacklist the tile if we can't get it and it wasn't cancelled
@@ -220,6 +225,7 @@ ElevationLayer::createGeoHeightField(const TileKey& key, ProgressCallback* progr
 osg::HeightField*
 ElevationLayer::createHeightField(const osgEarth::TileKey& key, ProgressCallback* progress )
 {
+    ScopedMetricTimer timer( _createMetric );
     osg::HeightField* result = 0L;
     //osg::ref_ptr<osg::HeightField> result;
 
@@ -239,7 +245,7 @@ ElevationLayer::createHeightField(const osgEarth::TileKey& key, ProgressCallback
 	}
 
     //Write the layer properties if they haven't been written yet.  Heightfields are always stored in the map profile.
-    if (!_cacheProfile.valid() && _cache.valid() && _options.cacheEnabled() == true && _tileSource.valid())
+    if (!_cacheProfile.valid() && usePersistentCache() && _tileSource.valid())
     {
         _cacheProfile = mapProfile;
         if ( _tileSource->isOK() )
@@ -249,16 +255,24 @@ ElevationLayer::createHeightField(const osgEarth::TileKey& key, ProgressCallback
     }
 
 	//See if we can get it from the cache.
-	if (_cache.valid() && _options.cacheEnabled() == true )
+	if (usePersistentCache() )
 	{
+        OE_TRACE_SCOPE( "cache.read", key.str(), getName() );
         osg::ref_ptr<const osg::HeightField> cachedHF;
 		if ( _cache->getHeightField( key, _cacheSpec, cachedHF ) )
 		{
 			OE_DEBUG << LC << "ElevationLayer::createHeightField got tile " << key.str() << " from layer \"" << getName() << "\" from cache " << std::endl;
 
+            if ( _cacheHitsMetric ) _cacheHitsMetric->add();
+            if ( _cacheBytesReadMetric ) _cacheBytesReadMetric->add( cachedHF->getNumColumns() * cachedHF->getNumRows() * sizeof(float) );
+
             // make a copy:
             result = new osg::HeightField( *cachedHF.get() );
 		}
+        else
+        {
+            if ( _cacheMissesMetric ) _cacheMissesMetric->add();
+        }
 	}
 
     //in cache-only mode, if the cache fetch failed, bail out.
@@ -355,9 +369,11 @@ ElevationLayer::createHeightField(const osgEarth::TileKey& key, ProgressCallback
 		}
     
         //Write the result to the cache.
-        if (result && _cache.valid() && _options.cacheEnabled() == true )
+        if (result && usePersistentCache() )
         {
+            OE_TRACE_SCOPE( "cache.write", key.str(), getName() );
             _cache->setHeightField( key, _cacheSpec, result );
+            if ( _cacheBytesWrittenMetric ) _cacheBytesWrittenMetric->add( result->getNumColumns() * result->getNumRows() * sizeof(float) );
         }
     }
 
@@ -67,6 +67,15 @@ Bounds::contains(const Bounds& rhs) const
         yMin() <= rhs.yMin() && yMax() >= rhs.yMax();
 }
 
+bool
+Bounds::intersects2d(const Bounds& rhs) const
+{
+    return
+        valid() && rhs.valid() &&
+        osg::maximum(xMin(), rhs.xMin()) <= osg::minimum(xMax(), rhs.xMax()) &&
+        osg::maximum(yMin(), rhs.yMin()) <= osg::minimum(yMax(), rhs.yMax());
+}
+
 void
 Bounds::expandBy( double x, double y )
 {
@@ -685,10 +694,18 @@ createDataSetFromImage(const osg::Image* image, double minX, double minY, double
     return srcDS;
 }
 
+// GDAL progress function that aborts the operation when the osgEarth task is canceled.
+static int CPL_STDCALL
+gdalCancelCheck(double, const char*, void* arg)
+{
+    ProgressCallback* progress = static_cast<ProgressCallback*>( arg );
+    return progress && progress->isCanceled() ? FALSE : TRUE;
+}
+
 static osg::Image*
 reprojectImage(osg::Image* srcImage, const std::string srcWKT, double srcMinX, double srcMinY, double srcMaxX, double srcMaxY,
                const std::string destWKT, double destMinX, double destMinY, double destMaxX, double destMaxY,
-               int width = 0, int height = 0)
+               int width = 0, int height = 0, ProgressCallback* progress = 0L)
 {
     //OE_NOTICE << "Reprojecting..." << std::endl;
     GDAL_SCOPED_LOCK;
@@ -718,13 +735,17 @@ reprojectImage(osg::Image* srcImage, const std::string srcWKT, double srcMinX, d
    
     GDALDataset* destDS = createMemDS(width, height, destMinX, destMinY, destMaxX, destMaxY, destWKT);
 
-    GDALReprojectImage(srcDS, NULL,
+    CPLErr err = GDALReprojectImage(srcDS, NULL,
                        destDS, NULL,
                        //GDALResampleAlg::GRA_NearestNeighbour,
                        GRA_Bilinear,
-                       0,0,0,0,0);                    
+                       0, 0,
+                       progress ? gdalCancelCheck : 0L, progress,
+                       0);
 
-    osg::Image* result = createImageFromDataset(destDS);
+    osg::Image* result = 0L;
+    if ( err == CE_None || !progress || !progress->isCanceled() )
+        result = createImageFromDataset(destDS);
     
     delete srcDS;
     delete destDS;  
@@ -738,7 +759,7 @@ reprojectImage(osg::Image* srcImage, const std::string srcWKT, double srcMinX, d
 
 static osg::Image*
 manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoExtent& dest_extent,
-                unsigned int width = 0, unsigned int height = 0)
+                unsigned int width = 0, unsigned int height = 0, ProgressCallback* progress = 0L)
 {
     //TODO:  Compute the optimal destination size
     if (width == 0 || height == 0)
@@ -751,9 +772,9 @@ manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoE
     // need to know this in order to choose the right interpolation algorithm
     const bool isSrcContiguous = src_extent.getSRS()->isContiguous();
 
-    osg::Image *result = new osg::Image();
+    osg::ref_ptr<osg::Image> result = new osg::Image();
     result->allocateImage(width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE);
-    ImageUtils::PixelReader ra(result);
+    ImageUtils::PixelReader ra(result.get());
     const double dx = dest_extent.width() / (double)width;
     const double dy = dest_extent.height() / (double)height;
 
@@ -782,6 +803,12 @@ manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoE
     double yfac = (image->t() - 1) / src_extent.height();
     for (unsigned int c = 0; c < width; ++c)
     {
+        if ( progress && progress->isCanceled() )
+        {
+            delete[] srcPointsX;
+            return 0L;
+        }
+
         for (unsigned int r = 0; r < height; ++r)
         {   
             double src_x = srcPointsX[pixel];
@@ -902,13 +929,14 @@ manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoE
     }
 
     delete[] srcPointsX;
-    return result;
+    return result.release();
 }
 
 
 
 GeoImage
-GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent, unsigned int width, unsigned int height) const
+GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent, unsigned int width, unsigned int height,
+                    ProgressCallback* progress) const
 {  
     GeoExtent destExtent;
     if (to_extent)
@@ -928,7 +956,7 @@ GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent,
     {
         // if either of the SRS is a custom projection, we have to do a manual reprojection since
         // GDAL will not recognize the SRS.
-        resultImage = manualReproject(getImage(), getExtent(), *to_extent, width, height);
+        resultImage = manualReproject(getImage(), getExtent(), *to_extent, width, height, progress);
     }
     else
     {
@@ -938,8 +966,12 @@ GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent,
             getExtent().xMin(), getExtent().yMin(), getExtent().xMax(), getExtent().yMax(),
             to_srs->getWKT(),
             destExtent.xMin(), destExtent.yMin(), destExtent.xMax(), destExtent.yMax(),
-            width, height);
-    }   
+            width, height, progress);
+    }
+
+    if ( !resultImage )
+        return GeoImage::INVALID;
+
     return GeoImage(resultImage, destExtent);
 }
 
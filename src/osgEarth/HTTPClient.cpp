@@ -21,6 +21,7 @@
 #include <curl/types.h>
 #include <osgEarth/HTTPClient>
 #include <osgEarth/Registry>
+#include <osgEarth/Tracing>
 #include <osgEarth/Version>
 #include <osgDB/Registry>
 #include <osgDB/FileNameUtils>
@@ -80,7 +81,7 @@ namespace osgEarth
 {
     struct StreamObject
     {
-        StreamObject(std::ostream* stream) : _stream(stream) { }
+        StreamObject(std::ostream* stream, ProgressCallback* progress =0L) : _stream(stream), _progress(progress) { }
 
         void write(const char* ptr, size_t realsize)
         {
@@ -89,6 +90,7 @@ namespace osgEarth
 
         std::ostream* _stream;
         std::string     _resultMimeType;
+        ProgressCallback* _progress;
     };
 
     static size_t
@@ -96,6 +98,12 @@ namespace osgEarth
     {
         size_t realsize = size* nmemb;
         StreamObject* sp = (StreamObject*)data;
+
+        // returning a short count aborts the transfer; this reacts to a cancelation
+        // as soon as the next block arrives rather than at the next progress call.
+        if ( sp->_progress && sp->_progress->isCanceled() )
+            return 0;
+
         sp->write((const char*)ptr, realsize);
         return realsize;
     }
@@ -510,6 +518,15 @@ HTTPResponse
 HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Options* options, ProgressCallback* callback) const
 {
     OE_DEBUG << LC << "doGet " << request.getURL() << std::endl;
+    OE_TRACE_SCOPE( "http.get", request.getURL(), "" );
+
+    // don't bother connecting if the task was canceled already.
+    if ( callback && callback->isCanceled() )
+    {
+        HTTPResponse response( 0L );
+        response._cancelled = true;
+        return response;
+    }
 
     const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ? 
             options->getAuthenticationMap() :
@@ -621,7 +638,7 @@ HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Option
     }
 
     osg::ref_ptr<HTTPResponse::Part> part = new HTTPResponse::Part();
-    StreamObject sp( &part->_stream );
+    StreamObject sp( &part->_stream, callback );
 
     //Take a temporary ref to the callback
     osg::ref_ptr<ProgressCallback> progressCallback = callback;
@@ -654,7 +671,7 @@ HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Option
 
     HTTPResponse response( response_code );
    
-    if ( response_code == 200L && res != CURLE_ABORTED_BY_CALLBACK && res != CURLE_OPERATION_TIMEDOUT ) //res == 0 )
+    if ( response_code == 200L && res != CURLE_ABORTED_BY_CALLBACK && res != CURLE_OPERATION_TIMEDOUT && res != CURLE_WRITE_ERROR ) //res == 0 )
     {
         // check for multipart content:
         char* content_type_cp;
@@ -686,7 +703,8 @@ HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Option
             response._parts.push_back( part.get() );
         }
     }
-    else if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT)
+    else if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT ||
+             (res == CURLE_WRITE_ERROR && callback && callback->isCanceled()) )
     {
         //If we were aborted by a callback, then it was cancelled by a user
         response._cancelled = true;
@@ -800,6 +818,7 @@ HTTPClient::doReadImageFile(const std::string& filename,
 
             else 
             {
+                OE_TRACE_SCOPE( "http.decode", filename, "" );
                 osgDB::ReaderWriter::ReadResult rr = reader->readImage(response.getPartStream(0), options);
                 if ( rr.validImage() )
                 {
@@ -845,6 +864,7 @@ HTTPClient::doReadImageFile(const std::string& filename,
     }
     else
     {
+        OE_TRACE_SCOPE( "file.read", filename, "" );
         output = osgDB::readImageFile( filename, options );
         if ( !output.valid() )
             result = RESULT_NOT_FOUND;
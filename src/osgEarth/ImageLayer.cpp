@@ -22,6 +22,7 @@
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Registry>
 #include <osgEarth/StringUtils>
+#include <osgEarth/Tracing>
 #include <osg/Version>
 #include <memory.h>
 #include <limits.h>
@@ -260,6 +261,8 @@ ImageLayer::init()
 
     //TODO: probably should graduate this to the superclass.
     _actualEnabled = _options.enabled().value();
+
+    initMetrics();
 }
 
 void
@@ -353,6 +356,7 @@ ImageLayer::initPreCacheOp()
 GeoImage
 ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
 {
+    ScopedMetricTimer timer( _createMetric );
     GeoImage result;
 
 	//OE_NOTICE << "[osgEarth::MapLayer::createImage] " << key.str() << std::endl;
@@ -387,7 +391,7 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
 	bool cacheInLayerProfile = !cacheInMapProfile;
 
     //Write the cache TMS file if it hasn't been written yet.
-    if (!_cacheProfile.valid() && _cache.valid() && _options.cacheEnabled() == true && _tileSource.valid())
+    if (!_cacheProfile.valid() && usePersistentCache() && _tileSource.valid())
     {
         _cacheProfile = cacheInMapProfile ? mapProfile : _profile.get();
         _cache->storeProperties( _cacheSpec, _cacheProfile, _tileSource->getPixelsPerTile() );
@@ -399,17 +403,21 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
 	}
 
 	//If we are caching in the map profile, try to get the image immediately.
-    if (cacheInMapProfile && _cache.valid() && _options.cacheEnabled() == true )
+    if (cacheInMapProfile && usePersistentCache() )
 	{
+        OE_TRACE_SCOPE( "cache.read", key.str(), getName() );
         osg::ref_ptr<const osg::Image> cachedImage;
         if ( _cache->getImage( key, _cacheSpec, cachedImage ) )
 		{
 			OE_DEBUG << LC << "Layer \"" << getName()<< "\" got tile " << key.str() << " from map cache " << std::endl;
+            if ( _cacheHitsMetric ) _cacheHitsMetric->add();
+            if ( _cacheBytesReadMetric ) _cacheBytesReadMetric->add( cachedImage->getTotalSizeInBytes() );
 
             result = GeoImage( ImageUtils::cloneImage(cachedImage.get()), key.getExtent() );
             ImageUtils::normalizeImage( result.getImage() );
             return result;
 		}
+        if ( _cacheMissesMetric ) _cacheMissesMetric->add();
 	}
 
 	//If the key profile and the source profile exactly match, simply request the image from the source
@@ -454,6 +462,9 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
             bool retry = false;
 			for (unsigned int j = 0; j < intersectingTiles.size(); ++j)
 			{
+                if ( progress && progress->isCanceled() )
+                    return GeoImage::INVALID;
+
 				double minX, minY, maxX, maxY;
 				intersectingTiles[j].getExtent().getBounds(minX, minY, maxX, maxY);
 
@@ -512,6 +523,8 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
 			double rxmin, rymin, rxmax, rymax;
 			mi->getExtents( rxmin, rymin, rxmax, rymax );
 
+            OE_TRACE_SCOPE( "image.mosaic", key.str(), getName() );
+
 			mosaic = GeoImage(
 				mi->createImage(),
 				GeoExtent( layerProfile->getSRS(), rxmin, rymin, rxmax, rymax ) );
@@ -577,13 +590,15 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
             if ( needsReprojection )
             {
 				OE_DEBUG << LC << "  Reprojecting image" << std::endl;
+                OE_TRACE_SCOPE( "image.reproject", key.str(), getName() );
 
                 // We actually need to reproject the image.  Note: GeoImage::reproject() will automatically
                 // crop the image to the correct extents, so there is no need to crop after reprojection.
                 result = mosaic.reproject( 
                     key.getProfile()->getSRS(),
                     &key.getExtent(), 
-                    _options.reprojectedTileSize().value(), _options.reprojectedTileSize().value() );
+                    _options.reprojectedTileSize().value(), _options.reprojectedTileSize().value(),
+                    progress );
             }
             else
             {
@@ -614,10 +629,12 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
     }
 
 	//If we got a result, the cache is valid and we are caching in the map profile, write to the map cache.
-    if (result.valid() && _cache.valid() && _options.cacheEnabled() == true && cacheInMapProfile)
+    if (result.valid() && usePersistentCache() && cacheInMapProfile)
 	{
 		OE_DEBUG << LC << "Layer \"" << getName() << "\" writing tile " << key.str() << " to cache " << std::endl;
+        OE_TRACE_SCOPE( "cache.write", key.str(), getName() );
 		_cache->setImage( key, _cacheSpec, result.getImage());
+        if ( _cacheBytesWrittenMetric ) _cacheBytesWrittenMetric->add( result.getImage()->getTotalSizeInBytes() );
 	}
     return result;
 }
@@ -639,14 +656,18 @@ ImageLayer::createImageWrapper(const TileKey& key,
 
     // first check the cache.
     // TODO: find a way to avoid caching/checking when the LOD falls
-    if (_cache.valid() && cacheInLayerProfile && _options.cacheEnabled() == true )
+    if (usePersistentCache() && cacheInLayerProfile )
     {
+        OE_TRACE_SCOPE( "cache.read", key.str(), getName() );
         osg::ref_ptr<const osg::Image> cachedImage;
 		if ( _cache->getImage( key, _cacheSpec, cachedImage ) )
 	    {
             OE_INFO << LC << " Layer \"" << getName() << "\" got " << key.str() << " from cache " << std::endl;
+            if ( _cacheHitsMetric ) _cacheHitsMetric->add();
+            if ( _cacheBytesReadMetric ) _cacheBytesReadMetric->add( cachedImage->getTotalSizeInBytes() );
             return ImageUtils::cloneImage(cachedImage.get());
     	}
+        if ( _cacheMissesMetric ) _cacheMissesMetric->add();
     }
 
 	if ( !_actualCacheOnly )
@@ -665,6 +686,8 @@ ImageLayer::createImageWrapper(const TileKey& key,
                 // source for an image.
                 if ( source->hasDataInExtent( key.getExtent() ) )
                 {
+                    ScopedMetricTimer fetchTimer( _fetchMetric );
+                    OE_TRACE_SCOPE( "source.fetch", key.str(), getName() );
                     result = source->createImage( key, _preCacheOp.get(), progress );
                 }
 
@@ -691,9 +714,11 @@ ImageLayer::createImageWrapper(const TileKey& key,
         }
 
         // Cache is necessary:
-        if ( result && _cache.valid() && cacheInLayerProfile && _options.cacheEnabled() == true )
+        if ( result && usePersistentCache() && cacheInLayerProfile )
 		{
+            OE_TRACE_SCOPE( "cache.write", key.str(), getName() );
 			_cache->setImage( key, _cacheSpec, result );
+            if ( _cacheBytesWrittenMetric ) _cacheBytesWrittenMetric->add( result->getTotalSizeInBytes() );
 		}
 	}
 
@@ -66,7 +66,19 @@ osg::Referenced( true ),
 _mapOptions( options ),
 _dataModelRevision(0)
 {
-    //NOP
+    publish();
+}
+
+void
+Map::publish()
+{
+    Snapshot* snapshot = new Snapshot();
+    snapshot->_revision        = _dataModelRevision;
+    snapshot->_imageLayers     = _imageLayers;
+    snapshot->_elevationLayers = _elevationLayers;
+    snapshot->_modelLayers     = _modelLayers;
+    snapshot->_maskLayer       = _terrainMaskLayer.get();
+    _snapshot = snapshot;
 }
 
 bool
@@ -328,6 +340,7 @@ Map::addImageLayer( ImageLayer* layer )
             _imageLayers.push_back( layer );
             index = _imageLayers.size() - 1;
             newRevision = ++_dataModelRevision;
+            publish();
         }
 
         // a separate block b/c we don't need the mutex   
@@ -374,6 +387,7 @@ Map::insertImageLayer( ImageLayer* layer, unsigned int index )
                 _imageLayers.insert( _imageLayers.begin() + index, layer );
 
             newRevision = ++_dataModelRevision;
+            publish();
         }
 
         // a separate block b/c we don't need the mutex   
@@ -416,6 +430,7 @@ Map::addElevationLayer( ElevationLayer* layer )
             _elevationLayers.push_back( layer );
             index = _elevationLayers.size() - 1;
             newRevision = ++_dataModelRevision;
+            publish();
         }
 
         // a separate block b/c we don't need the mutex   
@@ -445,6 +460,7 @@ Map::removeImageLayer( ImageLayer* layer )
             {
                 _imageLayers.erase( i );
                 newRevision = ++_dataModelRevision;
+                publish();
                 break;
             }
         }
@@ -480,6 +496,7 @@ Map::removeElevationLayer( ElevationLayer* layer )
             {
                 _elevationLayers.erase( i );
                 newRevision = ++_dataModelRevision;
+                publish();
                 break;
             }
         }
@@ -530,6 +547,7 @@ Map::moveImageLayer( ImageLayer* layer, unsigned int newIndex )
         _imageLayers.insert( _imageLayers.begin() + newIndex, layerToMove.get() );
 
         newRevision = ++_dataModelRevision;
+        publish();
     }
 
     // a separate block b/c we don't need the mutex
@@ -577,6 +595,7 @@ Map::moveElevationLayer( ElevationLayer* layer, unsigned int newIndex )
         _elevationLayers.insert( _elevationLayers.begin() + newIndex, layerToMove.get() );
 
         newRevision = ++_dataModelRevision;
+        publish();
     }
 
     // a separate block b/c we don't need the mutex
@@ -603,6 +622,7 @@ Map::addModelLayer( ModelLayer* layer )
             _modelLayers.push_back( layer );
 						index = _modelLayers.size() - 1;
             newRevision = ++_dataModelRevision;
+            publish();
         }
 
         layer->initialize( _mapOptions.referenceURI().get(), this ); //getReferenceURI(), this );        
@@ -626,6 +646,7 @@ Map::insertModelLayer( ModelLayer* layer, unsigned int index )
             Threading::ScopedWriteLock lock( _mapDataMutex );
             _modelLayers.insert( _modelLayers.begin() + index, layer );
             newRevision = ++_dataModelRevision;
+            publish();
         }
 
         layer->initialize( _mapOptions.referenceURI().get(), this ); //getReferenceURI(), this );        
@@ -653,6 +674,7 @@ Map::removeModelLayer( ModelLayer* layer )
                 {
                     _modelLayers.erase( i );
                     newRevision = ++_dataModelRevision;
+                    publish();
                     break;
                 }
             }
@@ -700,6 +722,7 @@ Map::moveModelLayer( ModelLayer* layer, unsigned int newIndex )
         _modelLayers.insert( _modelLayers.begin() + newIndex, layerToMove.get() );
 
         newRevision = ++_dataModelRevision;
+        publish();
     }
 
     // a separate block b/c we don't need the mutex
@@ -723,6 +746,7 @@ Map::setTerrainMaskLayer( MaskLayer* layer )
             Threading::ScopedWriteLock lock( _mapDataMutex );
             _terrainMaskLayer = layer;
             newRevision = ++_dataModelRevision;
+            publish();
         }
 
         layer->initialize( _mapOptions.referenceURI().value(), this );
@@ -752,6 +776,7 @@ Map::removeTerrainMaskLayer()
             Threading::ScopedWriteLock lock( _mapDataMutex );
             _terrainMaskLayer = 0L;
             newRevision = ++_dataModelRevision;
+            publish();
         }
         
         // a separate block b/c we don't need the mutex   
@@ -907,6 +932,9 @@ namespace
             ElevationLayer* layer = i->get();
             if (layer->getProfile() && layer->getEnabled() )
             {
+                if ( progress && progress->isCanceled() )
+                    return false;
+
                 osg::HeightField* hf = layer->createHeightField( key, progress );
                 //osg::ref_ptr< osg::HeightField > hf;
                 //layer->getHeightField( key, hf, progress );
@@ -944,6 +972,9 @@ namespace
                     osg::ref_ptr< osg::HeightField > hf;
                     while (hf_key.valid())
                     {
+                        if ( progress && progress->isCanceled() )
+                            return false;
+
                         hf = layer->createHeightField( hf_key, progress );
                         if ( hf.valid() )
                             break;
@@ -1011,6 +1042,13 @@ namespace
 		    //Create the new heightfield by sampling all of them.
             for (unsigned int c = 0; c < width; ++c)
             {
+                // check between columns so a canceled tile stops compositing right away.
+                if ( progress && progress->isCanceled() )
+                {
+                    out_result = 0L;
+                    return false;
+                }
+
                 double geoX = minx + (dx * (double)c);
                 for (unsigned r = 0; r < height; ++r)
                 {
@@ -1117,66 +1155,77 @@ Map::getHeightField(const TileKey& key,
         progress );
 }
 
+namespace
+{
+    // stand-ins for the parts of the model a frame didn't ask for
+    const ImageLayerVector     s_noImageLayers;
+    const ElevationLayerVector s_noElevationLayers;
+    const ModelLayerVector     s_noModelLayers;
+}
+
 bool
 Map::sync( MapFrame& frame ) const
 {
-    bool result = false;
+    // nothing to do if the frame is already at the current revision.
+    if ( frame._initialized && frame._mapDataModelRevision == _dataModelRevision )
+        return false;
 
-    if ( frame._mapDataModelRevision != _dataModelRevision || !frame._initialized )
+    // The snapshot is immutable, so the lock is only held long enough to take a
+    // reference to it; the layer lists themselves are never copied.
+    osg::ref_ptr<const Snapshot> snapshot;
     {
-        // hold the read lock while copying the layer lists.
         Threading::ScopedReadLock lock( const_cast<Map*>(this)->_mapDataMutex );
+        snapshot = _snapshot.get();
+    }
 
-        if ( frame._parts & IMAGE_LAYERS )
-        {
-            if ( !frame._initialized )
-                frame._imageLayers.reserve( _imageLayers.size() );
-            frame._imageLayers.clear();
-            if ( frame._copyValidDataOnly )
-            {
-                for( ImageLayerVector::const_iterator i = _imageLayers.begin(); i != _imageLayers.end(); ++i )
-                    if ( i->get()->getProfile() )
-                        frame._imageLayers.push_back( i->get() );
-            }
-            else
-                std::copy( _imageLayers.begin(), _imageLayers.end(), std::back_inserter(frame._imageLayers) );
-        }
+    if ( frame._initialized && frame._snapshot.get() == snapshot.get() )
+        return false;
 
-        if ( frame._parts & ELEVATION_LAYERS )
-        {
-            if ( !frame._initialized )
-                frame._elevationLayers.reserve( _elevationLayers.size() );
-            frame._elevationLayers.clear();
-            if ( frame._copyValidDataOnly )
-            {
-                for( ElevationLayerVector::const_iterator i = _elevationLayers.begin(); i != _elevationLayers.end(); ++i )
-                    if ( i->get()->getProfile() )
-                        frame._elevationLayers.push_back( i->get() );
-            }
-            else
-                std::copy( _elevationLayers.begin(), _elevationLayers.end(), std::back_inserter(frame._elevationLayers) );
-        }
+    frame._snapshot = snapshot.get();
 
-        if ( frame._parts & MODEL_LAYERS )
+    if ( frame._parts & IMAGE_LAYERS )
+    {
+        if ( frame._copyValidDataOnly )
         {
-            if ( !frame._initialized )
-                frame._modelLayers.reserve( _modelLayers.size() );
-            frame._modelLayers.clear();
-            std::copy( _modelLayers.begin(), _modelLayers.end(), std::back_inserter(frame._modelLayers) );
+            frame._validImageLayers.clear();
+            for( ImageLayerVector::const_iterator i = snapshot->_imageLayers.begin(); i != snapshot->_imageLayers.end(); ++i )
+                if ( i->get()->getProfile() )
+                    frame._validImageLayers.push_back( i->get() );
+            frame._imageLayers = &frame._validImageLayers;
         }
+        else
+            frame._imageLayers = &snapshot->_imageLayers;
+    }
 
-        if ( frame._parts & MASK_LAYERS )
+    if ( frame._parts & ELEVATION_LAYERS )
+    {
+        if ( frame._copyValidDataOnly )
         {
-            frame._maskLayer = _terrainMaskLayer.get();
+            frame._validElevationLayers.clear();
+            for( ElevationLayerVector::const_iterator i = snapshot->_elevationLayers.begin(); i != snapshot->_elevationLayers.end(); ++i )
+                if ( i->get()->getProfile() )
+                    frame._validElevationLayers.push_back( i->get() );
+            frame._elevationLayers = &frame._validElevationLayers;
         }
+        else
+            frame._elevationLayers = &snapshot->_elevationLayers;
+    }
 
-        // sync the revision numbers.
-        frame._initialized = true;
-        frame._mapDataModelRevision = _dataModelRevision;
-            
-        result = true;
-    }    
-    return result;
+    if ( frame._parts & MODEL_LAYERS )
+    {
+        frame._modelLayers = &snapshot->_modelLayers;
+    }
+
+    if ( frame._parts & MASK_LAYERS )
+    {
+        frame._maskLayer = snapshot->_maskLayer.get();
+    }
+
+    // sync the revision numbers.
+    frame._initialized = true;
+    frame._mapDataModelRevision = snapshot->_revision;
+
+    return true;
 }
 
 bool
@@ -1238,7 +1287,11 @@ _map( map ),
 _name( name ),
 _mapInfo( map ),
 _parts( parts ),
-_copyValidDataOnly( false )
+_copyValidDataOnly( false ),
+_imageLayers( &s_noImageLayers ),
+_elevationLayers( &s_noElevationLayers ),
+_modelLayers( &s_noModelLayers ),
+_maskLayer( 0L )
 {
     sync();
 }
@@ -1249,24 +1302,53 @@ _map( map ),
 _name( name ),
 _mapInfo( map ),
 _parts( parts ),
-_copyValidDataOnly( copyValidDataOnly )
+_copyValidDataOnly( copyValidDataOnly ),
+_imageLayers( &s_noImageLayers ),
+_elevationLayers( &s_noElevationLayers ),
+_modelLayers( &s_noModelLayers ),
+_maskLayer( 0L )
 {
     sync();
 }
 
 MapFrame::MapFrame( const MapFrame& src, const std::string& name ) :
-_initialized( src._initialized ),
 _map( src._map.get() ),
 _name( name ),
-_mapInfo( src._mapInfo ), // src._map.get() ),
-_parts( src._parts ),
-_copyValidDataOnly( src._copyValidDataOnly ),
-_mapDataModelRevision( src._mapDataModelRevision ),
-_imageLayers( src._imageLayers ),
-_elevationLayers( src._elevationLayers ),
-_modelLayers( src._modelLayers )
+_mapInfo( src._mapInfo ) // src._map.get() ),
+{
+    //no sync required here; we share the snapshot
+    assign( src );
+}
+
+MapFrame&
+MapFrame::operator = ( const MapFrame& rhs )
+{
+    if ( &rhs != this )
+    {
+        _map = rhs._map.get();
+        _name = rhs._name;
+        _mapInfo = rhs._mapInfo;
+        assign( rhs );
+    }
+    return *this;
+}
+
+void
+MapFrame::assign( const MapFrame& src )
 {
-    //no sync required here; we copied the arrays etc
+    _initialized = src._initialized;
+    _parts = src._parts;
+    _copyValidDataOnly = src._copyValidDataOnly;
+    _mapDataModelRevision = src._mapDataModelRevision;
+    _snapshot = src._snapshot.get();
+    _validImageLayers = src._validImageLayers;
+    _validElevationLayers = src._validElevationLayers;
+    _modelLayers = src._modelLayers;
+    _maskLayer = src._maskLayer;
+
+    // the "valid" lists belong to the frame, so don't point at the source's copies.
+    _imageLayers = src._imageLayers == &src._validImageLayers ? &_validImageLayers : src._imageLayers;
+    _elevationLayers = src._elevationLayers == &src._validElevationLayers ? &_validElevationLayers : src._elevationLayers;
 }
 
 bool
@@ -1284,34 +1366,34 @@ MapFrame::getHeightField(const TileKey& key,
                             ElevationSamplePolicy samplePolicy,
                             ProgressCallback* progress) const
 {
-    return s_getHeightField( key, _elevationLayers, _mapInfo.getProfile(), fallback, interpolation, samplePolicy, out_hf, out_isFallback, progress );
+    return s_getHeightField( key, *_elevationLayers, _mapInfo.getProfile(), fallback, interpolation, samplePolicy, out_hf, out_isFallback, progress );
 }
 
 int
 MapFrame::indexOf( ImageLayer* layer ) const
 {
-    ImageLayerVector::const_iterator i = std::find( _imageLayers.begin(), _imageLayers.end(), layer );
-    return i != _imageLayers.end() ? i - _imageLayers.begin() : -1;
+    ImageLayerVector::const_iterator i = std::find( _imageLayers->begin(), _imageLayers->end(), layer );
+    return i != _imageLayers->end() ? i - _imageLayers->begin() : -1;
 }
 
 int
 MapFrame::indexOf( ElevationLayer* layer ) const
 {
-    ElevationLayerVector::const_iterator i = std::find( _elevationLayers.begin(), _elevationLayers.end(), layer );
-    return i != _elevationLayers.end() ? i - _elevationLayers.begin() : -1;
+    ElevationLayerVector::const_iterator i = std::find( _elevationLayers->begin(), _elevationLayers->end(), layer );
+    return i != _elevationLayers->end() ? i - _elevationLayers->begin() : -1;
 }
 
 int
 MapFrame::indexOf( ModelLayer* layer ) const
 {
-    ModelLayerVector::const_iterator i = std::find( _modelLayers.begin(), _modelLayers.end(), layer );
-    return i != _modelLayers.end() ? i - _modelLayers.begin() : -1;
+    ModelLayerVector::const_iterator i = std::find( _modelLayers->begin(), _modelLayers->end(), layer );
+    return i != _modelLayers->end() ? i - _modelLayers->begin() : -1;
 }
 
 ImageLayer*
 MapFrame::getImageLayerByUID( UID uid ) const
 {
-    for(ImageLayerVector::const_iterator i = _imageLayers.begin(); i != _imageLayers.end(); ++i )
+    for(ImageLayerVector::const_iterator i = _imageLayers->begin(); i != _imageLayers->end(); ++i )
         if ( i->get()->getUID() == uid )
             return i->get();
     return 0L;
@@ -1320,7 +1402,7 @@ MapFrame::getImageLayerByUID( UID uid ) const
 ImageLayer*
 MapFrame::getImageLayerByName( const std::string& name ) const
 {
-    for(ImageLayerVector::const_iterator i = _imageLayers.begin(); i != _imageLayers.end(); ++i )
+    for(ImageLayerVector::const_iterator i = _imageLayers->begin(); i != _imageLayers->end(); ++i )
         if ( i->get()->getName() == name )
             return i->get();
     return 0L;
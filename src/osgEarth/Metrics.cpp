@@ -0,0 +1,386 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/Metrics>
+#include <osgEarth/Notify>
+#include <osg/Math>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/Thread>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <math.h>
+
+#define LC "[MetricsRegistry] "
+
+using namespace osgEarth;
+using namespace OpenThreads;
+
+//------------------------------------------------------------------------
+
+MetricHistogram::MetricHistogram( const volatile bool* enabled ) :
+_enabled( enabled ),
+_count  ( 0 ),
+_sum    ( 0.0 ),
+_min    ( 0.0 ),
+_max    ( 0.0 )
+{
+    for( int i=0; i<NUM_BUCKETS; ++i )
+        _buckets[i] = 0;
+}
+
+double
+MetricHistogram::getBucketLimit( int bucket )
+{
+    return ldexp( 1.0e-4, bucket );
+}
+
+void
+MetricHistogram::record( double seconds )
+{
+    if ( !*_enabled )
+        return;
+
+    // bucket i holds samples below 0.1ms * 2^i.
+    int bucket = 0;
+    double x = seconds / 1.0e-4;
+    if ( x >= 1.0 )
+    {
+        frexp( x, &bucket );
+        if ( bucket >= NUM_BUCKETS )
+            bucket = NUM_BUCKETS-1;
+    }
+
+    ScopedLock<Mutex> lock( _mutex );
+    _buckets[bucket]++;
+    _sum += seconds;
+    if ( _count == 0 || seconds < _min ) _min = seconds;
+    if ( _count == 0 || seconds > _max ) _max = seconds;
+    _count++;
+}
+
+void
+MetricHistogram::getSummary( Summary& out ) const
+{
+    unsigned long long buckets[NUM_BUCKETS];
+    {
+        ScopedLock<Mutex> lock( const_cast<MetricHistogram*>(this)->_mutex );
+        out._count = _count;
+        out._sum   = _sum;
+        out._min   = _min;
+        out._max   = _max;
+        for( int i=0; i<NUM_BUCKETS; ++i )
+            buckets[i] = _buckets[i];
+    }
+
+    // each percentile is the upper limit of the bucket it falls in (capped at the max).
+    const double p[3] = { 0.5, 0.9, 0.99 };
+    double* r[3] = { &out._p50, &out._p90, &out._p99 };
+    for( int k=0; k<3; ++k )
+    {
+        *r[k] = 0.0;
+        if ( out._count == 0 )
+            continue;
+
+        unsigned long long target = (unsigned long long)ceil( p[k] * (double)out._count );
+        unsigned long long total = 0;
+        for( int i=0; i<NUM_BUCKETS; ++i )
+        {
+            total += buckets[i];
+            if ( total >= target )
+            {
+                *r[k] = osg::clampBetween( getBucketLimit(i), out._min, out._max );
+                break;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+class MetricsRegistry::DumpThread : public OpenThreads::Thread
+{
+public:
+    DumpThread( MetricsRegistry* registry, const std::string& filename, double interval )
+        : _registry(registry), _filename(filename), _interval(interval), _done(false)
+    {
+        _json = osgDB::getLowerCaseFileExtension(filename) == "json";
+    }
+
+    void run()
+    {
+        bool first = true;
+        while( !_done )
+        {
+            // sleep in short steps so that stopping doesn't take a whole interval.
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            while( !_done && osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) < _interval )
+                OpenThreads::Thread::microSleep( 100000 );
+
+            if ( _json )
+            {
+                std::ofstream out( _filename.c_str() );
+                if ( out.is_open() )
+                    _registry->writeJSON( out );
+            }
+            else
+            {
+                std::ofstream out( _filename.c_str(), first ? std::ios::out : std::ios::app );
+                if ( out.is_open() )
+                    _registry->writeCSV( out, first );
+            }
+            first = false;
+        }
+    }
+
+    void stop()
+    {
+        _done = true;
+        while( isRunning() )
+            OpenThreads::Thread::YieldCurrentThread();
+    }
+
+private:
+    MetricsRegistry* _registry;
+    std::string      _filename;
+    double           _interval;
+    bool             _json;
+    volatile bool    _done;
+};
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    std::string
+    s_jsonEscape( const std::string& in )
+    {
+        std::string out;
+        out.reserve( in.length() );
+        for( std::string::const_iterator i = in.begin(); i != in.end(); ++i )
+        {
+            if ( *i == '"' || *i == '\\' )
+                out.push_back( '\\' );
+            if ( (unsigned char)*i >= 0x20 )
+                out.push_back( *i );
+        }
+        return out;
+    }
+
+    std::string
+    s_csvEscape( const std::string& in )
+    {
+        if ( in.find_first_of(",\"") == std::string::npos )
+            return in;
+        std::string out = "\"";
+        for( std::string::const_iterator i = in.begin(); i != in.end(); ++i )
+        {
+            if ( *i == '"' )
+                out.push_back( '"' );
+            out.push_back( *i );
+        }
+        out.push_back( '"' );
+        return out;
+    }
+}
+
+MetricsRegistry::MetricsRegistry() :
+osg::Referenced( true ),
+_enabled       ( true ),
+_lastWriteTime ( osg::Timer::instance()->tick() ),
+_dumpThread    ( 0L )
+{
+    //nop
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+    stopDumping();
+}
+
+MetricCounter*
+MetricsRegistry::getCounter( const std::string& name )
+{
+    ScopedLock<Mutex> lock( _mutex );
+    osg::ref_ptr<MetricCounter>& m = _counters[name];
+    if ( !m.valid() )
+        m = new MetricCounter( &_enabled );
+    return m.get();
+}
+
+MetricGauge*
+MetricsRegistry::getGauge( const std::string& name )
+{
+    ScopedLock<Mutex> lock( _mutex );
+    osg::ref_ptr<MetricGauge>& m = _gauges[name];
+    if ( !m.valid() )
+        m = new MetricGauge( &_enabled );
+    return m.get();
+}
+
+MetricHistogram*
+MetricsRegistry::getHistogram( const std::string& name )
+{
+    ScopedLock<Mutex> lock( _mutex );
+    osg::ref_ptr<MetricHistogram>& m = _histograms[name];
+    if ( !m.valid() )
+        m = new MetricHistogram( &_enabled );
+    return m.get();
+}
+
+double
+MetricsRegistry::getElapsedSinceLastWrite( osg::Timer_t now )
+{
+    double elapsed = osg::Timer::instance()->delta_s( _lastWriteTime, now );
+    _lastWriteTime = now;
+    return elapsed;
+}
+
+void
+MetricsRegistry::writeCSV( std::ostream& out, bool writeHeader )
+{
+    ScopedLock<Mutex> writeLock( _writeMutex );
+
+    // copy the lists so we don't hold up anyone creating new metrics.
+    CounterMap counters;
+    GaugeMap gauges;
+    HistogramMap histograms;
+    {
+        ScopedLock<Mutex> lock( _mutex );
+        counters = _counters;
+        gauges = _gauges;
+        histograms = _histograms;
+    }
+
+    osg::Timer_t now = osg::Timer::instance()->tick();
+    double time = osg::Timer::instance()->time_s();
+    double elapsed = getElapsedSinceLastWrite( now );
+
+    if ( writeHeader )
+        out << "time,name,type,value,rate,count,sum,min,max,p50,p90,p99" << std::endl;
+
+    out << std::setprecision(6);
+
+    for( CounterMap::const_iterator i = counters.begin(); i != counters.end(); ++i )
+    {
+        unsigned long long value = i->second->value();
+        unsigned long long& last = _lastCounterValues[i->first];
+        double rate = elapsed > 0.0 ? (double)(value - last) / elapsed : 0.0;
+        last = value;
+        out << time << "," << s_csvEscape(i->first) << ",counter," << value << "," << rate << ",,,,,,," << std::endl;
+    }
+
+    for( GaugeMap::const_iterator i = gauges.begin(); i != gauges.end(); ++i )
+    {
+        out << time << "," << s_csvEscape(i->first) << ",gauge," << i->second->value() << ",,,,,,,," << std::endl;
+    }
+
+    for( HistogramMap::const_iterator i = histograms.begin(); i != histograms.end(); ++i )
+    {
+        MetricHistogram::Summary s;
+        i->second->getSummary( s );
+        out << time << "," << s_csvEscape(i->first) << ",histogram,,,"
+            << s._count << "," << s._sum << "," << s._min << "," << s._max << ","
+            << s._p50 << "," << s._p90 << "," << s._p99 << std::endl;
+    }
+}
+
+void
+MetricsRegistry::writeJSON( std::ostream& out )
+{
+    ScopedLock<Mutex> writeLock( _writeMutex );
+
+    CounterMap counters;
+    GaugeMap gauges;
+    HistogramMap histograms;
+    {
+        ScopedLock<Mutex> lock( _mutex );
+        counters = _counters;
+        gauges = _gauges;
+        histograms = _histograms;
+    }
+
+    osg::Timer_t now = osg::Timer::instance()->tick();
+    double time = osg::Timer::instance()->time_s();
+    double elapsed = getElapsedSinceLastWrite( now );
+
+    out << std::setprecision(6);
+    out << "{\n  \"time\": " << time << ",\n  \"counters\": {";
+
+    for( CounterMap::const_iterator i = counters.begin(); i != counters.end(); ++i )
+    {
+        unsigned long long value = i->second->value();
+        unsigned long long& last = _lastCounterValues[i->first];
+        double rate = elapsed > 0.0 ? (double)(value - last) / elapsed : 0.0;
+        last = value;
+        out << (i == counters.begin() ? "\n" : ",\n")
+            << "    \"" << s_jsonEscape(i->first) << "\": { \"value\": " << value << ", \"rate\": " << rate << " }";
+    }
+
+    out << "\n  },\n  \"gauges\": {";
+
+    for( GaugeMap::const_iterator i = gauges.begin(); i != gauges.end(); ++i )
+    {
+        out << (i == gauges.begin() ? "\n" : ",\n")
+            << "    \"" << s_jsonEscape(i->first) << "\": " << i->second->value();
+    }
+
+    out << "\n  },\n  \"histograms\": {";
+
+    for( HistogramMap::const_iterator i = histograms.begin(); i != histograms.end(); ++i )
+    {
+        MetricHistogram::Summary s;
+        i->second->getSummary( s );
+        out << (i == histograms.begin() ? "\n" : ",\n")
+            << "    \"" << s_jsonEscape(i->first) << "\": { "
+            << "\"count\": " << s._count << ", \"sum\": " << s._sum
+            << ", \"min\": " << s._min << ", \"max\": " << s._max
+            << ", \"p50\": " << s._p50 << ", \"p90\": " << s._p90 << ", \"p99\": " << s._p99 << " }";
+    }
+
+    out << "\n  }\n}" << std::endl;
+}
+
+void
+MetricsRegistry::startDumping( const std::string& filename, double intervalSeconds )
+{
+    stopDumping();
+
+    ScopedLock<Mutex> lock( _mutex );
+    _dumpThread = new DumpThread( this, filename, osg::maximum(intervalSeconds, 0.1) );
+    _dumpThread->start();
+
+    OE_INFO << LC << "Writing metrics to " << filename << " every " << intervalSeconds << " s" << std::endl;
+}
+
+void
+MetricsRegistry::stopDumping()
+{
+    DumpThread* thread = 0L;
+    {
+        ScopedLock<Mutex> lock( _mutex );
+        thread = _dumpThread;
+        _dumpThread = 0L;
+    }
+
+    if ( thread )
+    {
+        thread->stop();
+        delete thread;
+    }
+}
@@ -0,0 +1,186 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/QuantizedHeightField>
+#include <osgEarth/HeightFieldUtils>
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+
+using namespace osgEarth;
+
+// largest sample that holds a height; NO_DATA_SAMPLE is reserved.
+#define MAX_SAMPLE 0xFFFE
+
+QuantizedHeightField::QuantizedHeightField() :
+_numColumns ( 0 ),
+_numRows    ( 0 ),
+_offset     ( 0.0f ),
+_scale      ( 1.0f ),
+_maxError   ( 0.0f ),
+_requestedPrecision( 1.0f ),
+_xInterval  ( 1.0f ),
+_yInterval  ( 1.0f ),
+_skirtHeight( 0.0f ),
+_borderWidth( 0 )
+{
+    //nop
+}
+
+QuantizedHeightField::QuantizedHeightField( unsigned int numColumns, unsigned int numRows, float offset, float scale ) :
+_numColumns ( numColumns ),
+_numRows    ( numRows ),
+_offset     ( offset ),
+_scale      ( scale ),
+_maxError   ( 0.0f ),
+_requestedPrecision( scale ),
+_xInterval  ( 1.0f ),
+_yInterval  ( 1.0f ),
+_skirtHeight( 0.0f ),
+_borderWidth( 0 ),
+_samples    ( numColumns * numRows, (unsigned short)NO_DATA_SAMPLE )
+{
+    //nop
+}
+
+QuantizedHeightField::QuantizedHeightField( const QuantizedHeightField& rhs, const osg::CopyOp& op ) :
+osg::Object ( rhs, op ),
+_numColumns ( rhs._numColumns ),
+_numRows    ( rhs._numRows ),
+_offset     ( rhs._offset ),
+_scale      ( rhs._scale ),
+_maxError   ( rhs._maxError ),
+_requestedPrecision( rhs._requestedPrecision ),
+_origin     ( rhs._origin ),
+_xInterval  ( rhs._xInterval ),
+_yInterval  ( rhs._yInterval ),
+_skirtHeight( rhs._skirtHeight ),
+_borderWidth( rhs._borderWidth ),
+_samples    ( rhs._samples )
+{
+    //nop
+}
+
+QuantizedHeightField::QuantizedHeightField( const osg::HeightField* hf, float precision ) :
+_numColumns ( hf->getNumColumns() ),
+_numRows    ( hf->getNumRows() ),
+_offset     ( 0.0f ),
+_scale      ( 1.0f ),
+_maxError   ( 0.0f ),
+_requestedPrecision( precision > 0.0f ? precision : 1.0f ),
+_origin     ( hf->getOrigin() ),
+_xInterval  ( hf->getXInterval() ),
+_yInterval  ( hf->getYInterval() ),
+_skirtHeight( hf->getSkirtHeight() ),
+_borderWidth( hf->getBorderWidth() )
+{
+    const osg::HeightField::HeightList& heights = hf->getHeightList();
+    unsigned int size = heights.size();
+    _samples.resize( size );
+
+    // find the range of valid heights:
+    float minHeight = FLT_MAX, maxHeight = -FLT_MAX;
+    for( unsigned int i = 0; i < size; ++i )
+    {
+        float h = heights[i];
+        if ( h != NO_DATA_VALUE )
+        {
+            if ( h < minHeight ) minHeight = h;
+            if ( h > maxHeight ) maxHeight = h;
+        }
+    }
+
+    if ( minHeight > maxHeight )
+    {
+        // nothing but NO_DATA
+        std::fill( _samples.begin(), _samples.end(), (unsigned short)NO_DATA_SAMPLE );
+        return;
+    }
+
+    _offset = minHeight;
+    _scale  = _requestedPrecision;
+    if ( (maxHeight - minHeight) / _scale > (float)MAX_SAMPLE )
+        _scale = (maxHeight - minHeight) / (float)MAX_SAMPLE;
+
+    const float invScale = 1.0f / _scale;
+    for( unsigned int i = 0; i < size; ++i )
+    {
+        float h = heights[i];
+        if ( h == NO_DATA_VALUE )
+        {
+            _samples[i] = NO_DATA_SAMPLE;
+        }
+        else
+        {
+            float q = floorf( (h - _offset) * invScale + 0.5f );
+            unsigned short s = q <= 0.0f ? 0 : q >= (float)MAX_SAMPLE ? MAX_SAMPLE : (unsigned short)q;
+            _samples[i] = s;
+
+            float err = fabs( (_offset + (float)s * _scale) - h );
+            if ( err > _maxError )
+                _maxError = err;
+        }
+    }
+}
+
+float
+QuantizedHeightField::getHeight( unsigned int c, unsigned int r ) const
+{
+    unsigned short s = _samples[r * _numColumns + c];
+    return s == NO_DATA_SAMPLE ? NO_DATA_VALUE : _offset + (float)s * _scale;
+}
+
+osg::HeightField*
+QuantizedHeightField::decode() const
+{
+    osg::HeightField* hf = new osg::HeightField();
+    hf->allocate( _numColumns, _numRows );
+    hf->setOrigin( _origin );
+    hf->setXInterval( _xInterval );
+    hf->setYInterval( _yInterval );
+    hf->setSkirtHeight( _skirtHeight );
+    hf->setBorderWidth( _borderWidth );
+
+    unsigned int size = _samples.size();
+    if ( size == 0 )
+        return hf;
+
+    // Branch-free multiply-add that the compiler can vectorize; the rare
+    // NO_DATA samples get patched up in a second pass.
+    const unsigned short* in  = &_samples.front();
+    float*                out = &hf->getHeightList().front();
+    const float offset = _offset, scale = _scale;
+    bool noData = false;
+
+    for( unsigned int i = 0; i < size; ++i )
+    {
+        out[i] = offset + (float)in[i] * scale;
+        noData |= (in[i] == NO_DATA_SAMPLE);
+    }
+
+    if ( noData )
+    {
+        for( unsigned int i = 0; i < size; ++i )
+        {
+            if ( in[i] == NO_DATA_SAMPLE )
+                out[i] = NO_DATA_VALUE;
+        }
+    }
+
+    return hf;
+}
@@ -38,6 +38,7 @@ Registry::Registry() :
 osg::Referenced(true),
 _gdal_registered( false ),
 _numGdalMutexGets( 0 ),
+_gdalLockWait( 0L ),
 _uidGen( 0 ),
 _caps( 0L )
 {
@@ -55,6 +56,16 @@ _caps( 0L )
 
     _shaderLib = new ShaderFactory();
     _taskServiceManager = new TaskServiceManager();
+
+    _metrics = new MetricsRegistry();
+    _gdalLockWait = _metrics->getHistogram( "gdal.lock_wait" );
+
+    const char* metricsFile = ::getenv( "OSGEARTH_METRICS_FILE" );
+    if ( metricsFile )
+    {
+        const char* interval = ::getenv( "OSGEARTH_METRICS_INTERVAL" );
+        _metrics->startDumping( metricsFile, interval ? ::atof(interval) : 10.0 );
+    }
 }
 
 Registry::~Registry()
@@ -77,6 +88,7 @@ Registry* Registry::instance(bool erase)
 void Registry::destruct()
 {
     _cacheOverride = 0;
+    _metrics->stopDumping();
 }
 
 
@@ -88,6 +100,21 @@ Registry::getGDALMutex()
     return _gdal_mutex;
 }
 
+//------------------------------------------------------------------------
+
+GDALScopedLock::GDALScopedLock() :
+_mutex( Registry::instance()->getGDALMutex() )
+{
+    MetricHistogram* wait = Registry::instance()->getGDALLockWaitMetric();
+    ScopedMetricTimer timer( wait );
+    _mutex.lock();
+}
+
+GDALScopedLock::~GDALScopedLock()
+{
+    _mutex.unlock();
+}
+
 
 const Profile*
 Registry::getGlobalGeodeticProfile() const
@@ -21,10 +21,13 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Cube>
 #include <OpenThreads/ScopedLock>
+#include <OpenThreads/Atomic>
 #include <osg/Notify>
 #include <ogr_api.h>
 #include <ogr_spatialref.h>
 #include <algorithm>
+#include <vector>
+#include <map>
 
 #define LC "[SpatialReference] "
 
@@ -72,12 +75,69 @@ namespace
 
 //------------------------------------------------------------------------
 
-SpatialReference::SpatialReferenceCache& SpatialReference::getSpatialReferenceCache()
+namespace
 {
-    //Make sure the registry is created before the cache
-    osgEarth::Registry::instance();
-    static SpatialReferenceCache s_cache;
-    return s_cache;
+    typedef std::map< std::string, osg::ref_ptr<SpatialReference> > SpatialReferenceCache;
+
+    /**
+     * Copy-on-write cache of SRS's by init string. Readers fetch the current snapshot
+     * without taking a lock. Writers serialize on a mutex, copy the snapshot, and
+     * publish the copy; the old snapshot is retired rather than deleted, because a
+     * reader may still be looking at it. The number of distinct init strings in an
+     * application is small, so the retired snapshots cost very little.
+     */
+    struct SpatialReferenceCacheSnapshots
+    {
+        SpatialReferenceCacheSnapshots() : _current( new SpatialReferenceCache() ) { }
+
+        ~SpatialReferenceCacheSnapshots()
+        {
+            delete static_cast<SpatialReferenceCache*>( _current.get() );
+            for( unsigned i=0; i<_retired.size(); ++i )
+                delete _retired[i];
+        }
+
+        const SpatialReferenceCache* get() const
+        {
+            return static_cast<const SpatialReferenceCache*>( _current.get() );
+        }
+
+        void insert( const std::string& init, SpatialReference* srs )
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _writeMutex );
+            SpatialReferenceCache* oldCache = static_cast<SpatialReferenceCache*>( _current.get() );
+            SpatialReferenceCache* newCache = new SpatialReferenceCache( *oldCache );
+            (*newCache)[init] = srs;
+            _current.assign( newCache, oldCache );
+            _retired.push_back( oldCache );
+        }
+
+        OpenThreads::AtomicPtr              _current;
+        OpenThreads::Mutex                  _writeMutex;
+        std::vector<SpatialReferenceCache*> _retired;
+    };
+
+    SpatialReferenceCacheSnapshots& getSpatialReferenceCache()
+    {
+        //Make sure the registry is created before the cache
+        osgEarth::Registry::instance();
+        static SpatialReferenceCacheSnapshots s_cache;
+        return s_cache;
+    }
+}
+
+void
+SpatialReference::registerSpatialReference( const std::string& init, SpatialReference* srs )
+{
+    getSpatialReferenceCache().insert( init, srs );
+}
+
+SpatialReference*
+SpatialReference::findInCache( const std::string& init )
+{
+    const SpatialReferenceCache* cache = getSpatialReferenceCache().get();
+    SpatialReferenceCache::const_iterator itr = cache->find( init );
+    return itr != cache->end() ? itr->second.get() : 0L;
 }
 
 
@@ -146,19 +206,23 @@ SpatialReference::createFromWKT( const std::string& init, const std::string& ini
 SpatialReference*
 SpatialReference::create( const std::string& init )
 {
+    // fast path: a known init string is a lock-free lookup.
+    SpatialReference* cached = findInCache( init );
+    if ( cached )
+        return cached;
+
+    // slow path: serialize creation, and check again in case another thread
+    // created the same SRS while we were waiting.
     static OpenThreads::Mutex s_mutex;
     OpenThreads::ScopedLock<OpenThreads::Mutex> exclusiveLock(s_mutex);
 
+    cached = findInCache( init );
+    if ( cached )
+        return cached;
+
     std::string low = init;
     std::transform( low.begin(), low.end(), low.begin(), ::tolower );
 
-    SpatialReferenceCache::iterator itr = getSpatialReferenceCache().find(init);
-    if (itr != getSpatialReferenceCache().end())
-    {
-        //OE_NOTICE << "Returning cached SRS" << std::endl;
-        return itr->second.get();
-    }
-
     osg::ref_ptr<SpatialReference> srs;
 
     // shortcut for spherical-mercator:
@@ -214,7 +278,11 @@ SpatialReference::create( const std::string& init )
         return NULL;
     }
 
-    getSpatialReferenceCache()[init] = srs;
+    // Note: the new SRS keeps its own handle and WKT even if it falls in the same
+    // equivalence class as an existing one. The class is only a fast path for
+    // isEquivalentTo(), and that test is loose (geographic SRS's compare on the
+    // ellipsoid alone), so substituting instances would lose datum shifts.
+    registerSpatialReference( init, srs.get() );
     return srs.get();
 }
 
@@ -291,6 +359,7 @@ SpatialReference::SpatialReference(void* handle,
                                    const std::string& name ) :
 osg::Referenced( true ),
 _initialized( false ),
+_equivClassId( 0 ),
 _handle( handle ),
 _owns_handle( true ),
 _name( name ),
@@ -304,6 +373,7 @@ _init_str( init_str )
 SpatialReference::SpatialReference(void* handle, bool ownsHandle) :
 osg::Referenced( true ),
 _initialized( false ),
+_equivClassId( 0 ),
 _handle( handle ),
 _owns_handle( ownsHandle )
 {
@@ -389,12 +459,78 @@ SpatialReference::getInitType() const
 bool
 SpatialReference::isEquivalentTo( const SpatialReference* rhs ) const
 {
+    if ( !rhs )
+        return false;
+
+    if ( this == rhs )
+        return true;
+
     if ( !_initialized )
         const_cast<SpatialReference*>(this)->init();
 
+    if ( !rhs->_initialized )
+        const_cast<SpatialReference*>(rhs)->init();
+
+    // the equivalence class already captures the result of _isEquivalentTo.
+    if ( _equivClassId != 0 && rhs->_equivClassId != 0 )
+        return _equivClassId == rhs->_equivClassId;
+
     return _isEquivalentTo( rhs );
 }
 
+unsigned
+SpatialReference::getEquivalenceClassId() const
+{
+    if ( !_initialized )
+        const_cast<SpatialReference*>(this)->init();
+    return _equivClassId;
+}
+
+void
+SpatialReference::assignEquivalenceClass()
+{
+    // One representative per equivalence class; the class ID is the index + 1. The caller
+    // holds the GDAL lock, which also protects this list.
+    static std::vector< osg::ref_ptr<SpatialReference> > s_reps;
+
+    for( unsigned i=0; i<s_reps.size(); ++i )
+    {
+        if ( _isEquivalentTo( s_reps[i].get() ) )
+        {
+            _equivClassId = i+1;
+            return;
+        }
+    }
+
+    s_reps.push_back( createEquivalenceRep() );
+    _equivClassId = s_reps.size();
+    s_reps.back()->_equivClassId = _equivClassId;
+}
+
+SpatialReference*
+SpatialReference::createEquivalenceRep() const
+{
+    // The rep gets its own copy of the OGR handle, since this SRS may not own its handle.
+    // Copy the flags through the accessors so that subclass overrides are captured.
+    SpatialReference* rep = new SpatialReference( OSRClone(_handle), true );
+    rep->_is_geographic   = isGeographic();
+    rep->_is_mercator     = isMercator();
+    rep->_is_north_polar  = isNorthPolar();
+    rep->_is_south_polar  = isSouthPolar();
+    rep->_is_cube         = isCube();
+    rep->_is_contiguous   = isContiguous();
+    rep->_is_user_defined = isUserDefined();
+    rep->_name            = _name;
+    rep->_wkt             = _wkt;
+    rep->_proj4           = _proj4;
+    rep->_init_type       = _init_type;
+    rep->_init_str        = _init_str;
+    rep->_init_str_lc     = _init_str_lc;
+    rep->_ellipsoid       = _ellipsoid.get();
+    rep->_initialized     = true;
+    return rep;
+}
+
 bool
 SpatialReference::_isEquivalentTo( const SpatialReference* rhs ) const
 {
@@ -1003,6 +1139,8 @@ SpatialReference::init()
         // calls the internal version, which can be overriden by the developer.
         // therefore do not call init() from the constructor!
         _init();
+
+        assignEquivalenceClass();
     }
 }
 
@@ -1069,6 +1207,11 @@ SpatialReference::_init()
         _init_str = _wkt;
         _init_type = "WKT";
     }
+    if ( _init_str_lc.empty() )
+    {
+        _init_str_lc = _init_str;
+        std::transform( _init_str_lc.begin(), _init_str_lc.end(), _init_str_lc.begin(), ::tolower );
+    }
     
     // Try to extract the PROJ4 initialization string:
     char* proj4buf;
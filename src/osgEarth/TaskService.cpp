@@ -17,7 +17,16 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/TaskService>
+#include <osgEarth/Registry>
+#include <osgEarth/Tracing>
 #include <osg/Notify>
+#include <OpenThreads/Thread>
+#include <math.h>
+#include <time.h>
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+#   include <windows.h>
+#endif
 
 using namespace osgEarth;
 using namespace OpenThreads;
@@ -26,10 +35,43 @@ using namespace OpenThreads;
 
 //------------------------------------------------------------------------
 
+namespace
+{
+    // CPU seconds used by the calling thread so far, or -1 if the platform
+    // can't tell us.
+    double
+    s_threadCpuTime()
+    {
+#if defined(WIN32) && !defined(__CYGWIN__)
+        FILETIME creation, exit, kernel, user;
+        if ( GetThreadTimes( GetCurrentThread(), &creation, &exit, &kernel, &user ) )
+        {
+            ULARGE_INTEGER k, u;
+            k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+            u.LowPart = user.dwLowDateTime;   u.HighPart = user.dwHighDateTime;
+            return (double)(k.QuadPart + u.QuadPart) * 1.0e-7;
+        }
+        return -1.0;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+        struct timespec ts;
+        if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 )
+            return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+        return -1.0;
+#else
+        return -1.0;
+#endif
+    }
+}
+
+//------------------------------------------------------------------------
+
 TaskRequest::TaskRequest( float priority ) :
 osg::Referenced( true ),
 _priority( priority ),
-_state( STATE_IDLE )
+_state( STATE_IDLE ),
+_startTime( 0 ),
+_endTime( 0 ),
+_queuedTime( 0 )
 {
     _progress = new ProgressCallback();
 }
@@ -66,8 +108,20 @@ TaskRequest::wasCanceled() const
 
 TaskRequestQueue::TaskRequestQueue() :
 osg::Referenced( true ),
-_done( false )
+_done( false ),
+_depthMetric( 0L ),
+_waitMetric( 0L ),
+_runMetric( 0L )
+{
+}
+
+void
+TaskRequestQueue::setMetrics( MetricGauge* depth, MetricHistogram* wait, MetricHistogram* run )
 {
+    ScopedLock<Mutex> lock(_mutex);
+    _depthMetric = depth;
+    _waitMetric  = wait;
+    _runMetric   = run;
 }
 
 void
@@ -75,6 +129,9 @@ TaskRequestQueue::clear()
 {
     ScopedLock<Mutex> lock(_mutex);
     _requests.clear();
+
+    if ( _depthMetric )
+        _depthMetric->set( 0.0 );
 }
 
 unsigned int
@@ -88,6 +145,7 @@ void
 TaskRequestQueue::add( TaskRequest* request )
 {
     request->setState( TaskRequest::STATE_PENDING );
+    request->setQueuedTime( osg::Timer::instance()->tick() );
 
     // install a progress callback if one isn't already installed
     if ( !request->getProgressCallback() )
@@ -98,6 +156,9 @@ TaskRequestQueue::add( TaskRequest* request )
     // insert by priority.
     _requests.insert( std::pair<float,TaskRequest*>(request->getPriority(), request) );
 
+    if ( _depthMetric )
+        _depthMetric->set( (double)_requests.size() );
+
 #if 0
     // insert by priority.
     bool inserted = false;
@@ -139,6 +200,9 @@ TaskRequestQueue::get()
     osg::ref_ptr<TaskRequest> next = _requests.begin()->second.get(); //_requests.front();
     _requests.erase( _requests.begin() ); //_requests.pop_front();
 
+    if ( _depthMetric )
+        _depthMetric->set( (double)_requests.size() );
+
     // I'm done, someone else take a turn:
     // (technically this shouldn't be necessary since add() bumps the semaphore once
     // for each request in the queue)
@@ -147,6 +211,30 @@ TaskRequestQueue::get()
     return next.release();
 }
 
+void
+TaskRequestQueue::record( double queueTime, double runTime, double cpuTime )
+{
+    ScopedLock<Mutex> lock(_mutex);
+    _stats._numTasks++;
+    _stats._queueTime += queueTime;
+    _stats._runTime   += runTime;
+    _stats._cpuTime   += cpuTime;
+
+    if ( _waitMetric )
+        _waitMetric->record( queueTime );
+    if ( _runMetric )
+        _runMetric->record( runTime );
+}
+
+void
+TaskRequestQueue::getStats( TaskServiceStats& out, bool reset )
+{
+    ScopedLock<Mutex> lock(_mutex);
+    out = _stats;
+    if ( reset )
+        _stats = TaskServiceStats();
+}
+
 void
 TaskRequestQueue::setDone()
 {
@@ -195,8 +283,23 @@ TaskThread::run()
                 if ( _request->getProgressCallback() )
                     _request->getProgressCallback()->onStarted();
 
+                osg::Timer_t pickupTime = osg::Timer::instance()->tick();
+                double queueTime = osg::Timer::instance()->delta_s( _request->queuedTime(), pickupTime );
+                double cpuStart = s_threadCpuTime();
+
+                OE_TRACE_COMPLETE( "task.queued", _request->queuedTime(), pickupTime, _request->getName(), "" );
+
                 _request->setState( TaskRequest::STATE_IN_PROGRESS );
-                _request->run();
+                {
+                    OE_TRACE_SCOPE( "task.run", _request->getName(), "" );
+                    _request->run();
+                }
+
+                // record where the time went, so the TaskServiceManager can tell
+                // CPU-bound services from ones that are waiting on I/O.
+                double runTime = _request->runTime();
+                double cpuTime = cpuStart >= 0.0 ? osg::minimum( s_threadCpuTime() - cpuStart, runTime ) : runTime;
+                _queue->record( queueTime, runTime, cpuTime );
 
                 //OE_INFO << LC << "Task \"" << _request->getName() << "\" runtime = " << _request->runTime() << " s." << std::endl;
             }
@@ -241,19 +344,44 @@ TaskThread::cancel()
 
 TaskService::TaskService( const std::string& name, int numThreads ):
 osg::Referenced( true ),
+_numThreads( 0 ),
 _lastRemoveFinishedThreadsStamp(0),
 _name(name)
 {
     _queue = new TaskRequestQueue();
+    initMetrics();
     setNumThreads( numThreads );
 }
 
+void
+TaskService::initMetrics()
+{
+    // unnamed services are not reported.
+    if ( _name.empty() )
+    {
+        _queue->setMetrics( 0L, 0L, 0L );
+        return;
+    }
+
+    MetricsRegistry* metrics = Registry::instance()->getMetrics();
+    _queue->setMetrics(
+        metrics->getGauge    ( "taskservice." + _name + ".queue_depth" ),
+        metrics->getHistogram( "taskservice." + _name + ".queue_wait" ),
+        metrics->getHistogram( "taskservice." + _name + ".run" ) );
+}
+
 unsigned int
 TaskService::getNumRequests() const
 {
     return _queue->getNumRequests();
 }
 
+void
+TaskService::getStats( TaskServiceStats& out, bool reset )
+{
+    _queue->getStats( out, reset );
+}
+
 void
 TaskService::add( TaskRequest* request )
 {   
@@ -382,7 +510,12 @@ TaskService::removeFinishedThreads()
 
 TaskServiceManager::TaskServiceManager( int numThreads ) :
 _numThreads( 0 ),
-_targetNumThreads( numThreads )
+_targetNumThreads( numThreads ),
+_autoTune( false ),
+_minThreadsPerService( 1 ),
+_maxThreadsPerService( 4 * OpenThreads::GetNumberOfProcessors() ),
+_autoTuneInterval( 2.0 ),
+_lastRebalance( osg::Timer::instance()->tick() )
 {
     //nop
 }
@@ -390,6 +523,8 @@ _targetNumThreads( numThreads )
 void
 TaskServiceManager::setNumThreads( int numThreads )
 {
+    ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+    _targetNumThreads = numThreads;
     reallocate( numThreads );
 }
 
@@ -417,6 +552,25 @@ TaskServiceManager::add( UID uid, float weight )
     }
 }
 
+void
+TaskServiceManager::add( UID uid, TaskService* service, float weight )
+{
+    ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+
+    if ( !service )
+        return;
+
+    if ( weight <= 0.0f )
+        weight = 0.001;
+
+    TaskServiceMap::iterator i = _services.find( uid );
+    if ( i != _services.end() && i->second.first.get() == service && i->second.second == weight )
+        return;
+
+    _services[uid] = WeightedTaskService( service, weight );
+    reallocate( _targetNumThreads );
+}
+
 TaskService*
 TaskServiceManager::get( UID uid ) const
 {
@@ -440,6 +594,7 @@ TaskServiceManager::remove( TaskService* service )
     {
         if ( i->second.first.get() == service ) 
         {
+            _stats.erase( i->first );
             _services.erase( i );
             reallocate( _targetNumThreads );
             break;
@@ -451,6 +606,7 @@ void
 TaskServiceManager::remove( UID uid )
 {
     ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+    _stats.erase( uid );
     _services.erase( uid );
     reallocate( _targetNumThreads );
 }
@@ -494,3 +650,175 @@ TaskServiceManager::reallocate( int numThreads )
         _numThreads += threads;
     }
 }
+
+void
+TaskServiceManager::setAutoTune( bool value )
+{
+    ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+    if ( value != _autoTune )
+    {
+        _autoTune = value;
+
+        // start measuring from now.
+        _lastRebalance = osg::Timer::instance()->tick();
+        TaskServiceStats dummy;
+        for( TaskServiceMap::iterator i = _services.begin(); i != _services.end(); ++i )
+            i->second.first->getStats( dummy, true );
+
+        if ( !_autoTune )
+            reallocate( _targetNumThreads );
+    }
+}
+
+void
+TaskServiceManager::setThreadLimits( int minPerService, int maxPerService )
+{
+    ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+    _minThreadsPerService = osg::maximum( 1, minPerService );
+    _maxThreadsPerService = osg::maximum( _minThreadsPerService, maxPerService );
+}
+
+void
+TaskServiceManager::update()
+{
+    if ( !_autoTune )
+        return;
+
+    ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+
+    osg::Timer_t now = osg::Timer::instance()->tick();
+    double elapsed = osg::Timer::instance()->delta_s( _lastRebalance, now );
+    if ( elapsed >= _autoTuneInterval )
+    {
+        rebalance( elapsed );
+        _lastRebalance = now;
+    }
+}
+
+void
+TaskServiceManager::getStats( ServiceStatsVector& out ) const
+{
+    ScopedLock<Mutex> lock( const_cast<TaskServiceManager*>(this)->_taskServiceMgrMutex );
+    out.clear();
+    for( TaskServiceMap::const_iterator i = _services.begin(); i != _services.end(); ++i )
+    {
+        ServiceStatsMap::const_iterator s = _stats.find( i->first );
+        ServiceStats stats = s != _stats.end() ? s->second : ServiceStats();
+        stats._uid = i->first;
+        stats._name = i->second.first->getName();
+        stats._weight = i->second.second;
+        stats._numThreads = i->second.first->getNumThreads();
+        out.push_back( stats );
+    }
+}
+
+void
+TaskServiceManager::rebalance( double elapsed )
+{
+    if ( _services.empty() )
+        return;
+
+    int numCores = osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+
+    std::vector<TaskService*> services;
+    std::vector<ServiceStats*> stats;
+    std::vector<int> limits;
+    std::vector<int> alloc;
+
+    int budget = _targetNumThreads;
+
+    for( TaskServiceMap::iterator i = _services.begin(); i != _services.end(); ++i )
+    {
+        TaskService* service = i->second.first.get();
+        ServiceStats& s = _stats[i->first];
+
+        TaskServiceStats totals;
+        service->getStats( totals, true );
+
+        s._uid        = i->first;
+        s._name       = service->getName();
+        s._weight     = i->second.second;
+        s._queueDepth = service->getNumRequests();
+        s._numTasks   = totals._numTasks;
+
+        if ( totals._numTasks > 0 )
+        {
+            s._avgQueueTime = totals._queueTime / (double)totals._numTasks;
+            s._avgRunTime   = totals._runTime / (double)totals._numTasks;
+            s._ioFraction   = totals._runTime > 0.0 ? 
+                osg::clampBetween( 1.0 - totals._cpuTime/totals._runTime, 0.0, 1.0 ) : 0.0;
+        }
+        // (otherwise keep the last interval's figures, they're the best guess we have)
+
+        // Demand is the number of threads that would have been busy for the whole
+        // interval running the tasks that finished, plus the ones still waiting.
+        double work = totals._runTime + (double)s._queueDepth * s._avgRunTime;
+        s._demand = work / elapsed;
+        if ( s._queueDepth > 0 && s._avgRunTime == 0.0 )
+            s._demand = (double)service->getNumThreads() + 1.0; // nothing measured yet, but there's a backlog
+
+        // Extra threads only help a CPU-bound service until it runs out of cores; a
+        // service that spends most of its time blocked can keep proportionally more busy.
+        int cap = (int)ceil( (double)numCores / osg::maximum( 1.0 - s._ioFraction, 0.05 ) );
+
+        int limit = (int)ceil( s._demand );
+        limit = osg::minimum( limit, cap );
+        limit = osg::clampBetween( limit, _minThreadsPerService, _maxThreadsPerService );
+
+        services.push_back( service );
+        stats.push_back( &s );
+        limits.push_back( limit );
+        alloc.push_back( _minThreadsPerService );
+        budget -= _minThreadsPerService;
+    }
+
+    // Hand out the remaining threads one at a time, each to the service with the
+    // most weighted demand per thread, until the budget runs out or everyone is at
+    // their limit.
+    while( budget > 0 )
+    {
+        int best = -1;
+        double bestScore = 0.0;
+        for( unsigned i=0; i<services.size(); ++i )
+        {
+            if ( alloc[i] < limits[i] )
+            {
+                double score = stats[i]->_weight * osg::maximum( stats[i]->_demand, 0.01 ) / (double)(alloc[i] + 1);
+                if ( score > bestScore )
+                {
+                    bestScore = score;
+                    best = i;
+                }
+            }
+        }
+
+        if ( best < 0 )
+            break;
+
+        alloc[best]++;
+        budget--;
+    }
+
+    // Move halfway toward the new allocation each time to damp oscillation.
+    _numThreads = 0;
+    for( unsigned i=0; i<services.size(); ++i )
+    {
+        int current = services[i]->getNumThreads();
+        int target  = alloc[i];
+        int threads = current + (target - current) / 2;
+        if ( threads == current && target != current )
+            threads += target > current ? 1 : -1;
+
+        if ( threads != current )
+        {
+            OE_DEBUG << LC << "Auto-tune: service \"" << stats[i]->_name << "\" "
+                << current << " -> " << threads << " threads (demand " << stats[i]->_demand
+                << ", I/O " << (int)(stats[i]->_ioFraction*100.0) << "%, queue " << stats[i]->_queueDepth << ")"
+                << std::endl;
+            services[i]->setNumThreads( threads );
+        }
+
+        stats[i]->_numThreads = threads;
+        _numThreads += threads;
+    }
+}
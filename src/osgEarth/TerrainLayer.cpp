@@ -143,6 +143,13 @@ TerrainLayer::init()
     _actualCacheOnly   = false;
     _actualEnabled     = true;
 
+    _createMetric            = 0L;
+    _fetchMetric             = 0L;
+    _cacheHitsMetric         = 0L;
+    _cacheMissesMetric       = 0L;
+    _cacheBytesReadMetric    = 0L;
+    _cacheBytesWrittenMetric = 0L;
+
 	// Parse any environment variables:
     if ( ::getenv("OSGEARTH_CACHE_ONLY") != 0 )
 	{
@@ -152,6 +159,22 @@ TerrainLayer::init()
 	}
 }
 
+void
+TerrainLayer::initMetrics()
+{
+    MetricsRegistry* metrics = Registry::instance()->getMetrics();
+
+    // layer names needn't be unique, so the UID keeps two same-named layers apart.
+    const std::string name = getName() + "#" + toString( getUID() );
+
+    _createMetric            = metrics->getHistogram( "layer." + name + ".create" );
+    _fetchMetric             = metrics->getHistogram( "layer." + name + ".fetch" );
+    _cacheHitsMetric         = metrics->getCounter( "cache." + name + ".hits" );
+    _cacheMissesMetric       = metrics->getCounter( "cache." + name + ".misses" );
+    _cacheBytesReadMetric    = metrics->getCounter( "cache." + name + ".bytes_read" );
+    _cacheBytesWrittenMetric = metrics->getCounter( "cache." + name + ".bytes_written" );
+}
+
 void
 TerrainLayer::setCache(Cache* cache)
 {
@@ -208,10 +231,24 @@ TerrainLayer::setCache(Cache* cache)
                 _actualCacheOnly = true;
 
             _cacheSpec = CacheSpec( cacheId, _actualCacheFormat, getName() );
+
+            if ( _tileSourceInitialized )
+                initTileSourceCache();
         }
     }
 }
 
+void
+TerrainLayer::initTileSourceCache()
+{
+    // a source that can't be cached one image per tile may still cache parts of its tiles.
+    if ( _tileSource.valid() && _cache.valid() && getTerrainLayerOptions().cacheEnabled() == true &&
+         !_tileSource->supportsPersistentCaching() )
+    {
+        _tileSource->setPersistentCache( _cache.get(), _cacheSpec );
+    }
+}
+
 void
 TerrainLayer::setTargetProfileHint( const Profile* profile )
 {
@@ -284,6 +321,17 @@ TerrainLayer::isDynamic() const
     return ts ? ts->isDynamic() : false;
 }
 
+bool
+TerrainLayer::usePersistentCache() const
+{
+    if ( !_cache.valid() || getTerrainLayerOptions().cacheEnabled() != true )
+        return false;
+
+    // with no tile source (cache-only), the cache is all there is.
+    TileSource* ts = getTileSource();
+    return !ts || ts->supportsPersistentCaching();
+}
+
 //TODO: move this to ImageLayer/ElevationLayer
 std::string
 TerrainLayer::suggestCacheFormat() const
@@ -341,6 +389,8 @@ TerrainLayer::initTileSource()
         _cacheSpec = CacheSpec( _cacheSpec.cacheId(), _actualCacheFormat, _cacheSpec.name() );
     }
 
+    initTileSourceCache();
+
     // Set the profile from the TileSource if possible:
     if ( _tileSource.valid() )
     {
@@ -30,7 +30,8 @@ _mode( MODE_STANDARD ),
 _numLoadingThreads( 4 ),
 _numLoadingThreadsPerCore( 2 ),
 _numCompileThreads( 2 ),
-_numCompileThreadsPerCore( 0.5 )
+_numCompileThreadsPerCore( 0.5 ),
+_autoTuneThreads( false )
 {
     fromConfig( conf );
 }
@@ -48,6 +49,7 @@ LoadingPolicy::fromConfig( const Config& conf )
     conf.getIfSet( "loading_threads_per_core", _numLoadingThreadsPerCore );
     conf.getIfSet( "compile_threads", _numCompileThreads );
     conf.getIfSet( "compile_threads_per_core", _numCompileThreadsPerCore );
+    conf.getIfSet( "auto_tune_threads", _autoTuneThreads );
 }
 
 Config
@@ -62,6 +64,7 @@ LoadingPolicy::getConfig() const
     conf.addIfSet( "loading_threads_per_core", _numLoadingThreadsPerCore );
     conf.addIfSet( "compile_threads", _numCompileThreads );
     conf.addIfSet( "compile_threads_per_core", _numCompileThreadsPerCore );
+    conf.addIfSet( "auto_tune_threads", _autoTuneThreads );
     return conf;
 }
 
@@ -18,6 +18,7 @@
  */
 
 #include <osgEarth/TileKey>
+#include <sstream>
 
 using namespace osgEarth;
 
@@ -45,20 +46,14 @@ TileKey::TileKey( unsigned int lod, unsigned int tile_x, unsigned int tile_y, co
         double ymin = ymax - height;
 
         _extent = GeoExtent( _profile->getSRS(), xmin, ymin, xmax, ymax );
-
-        std::stringstream buf;
-        buf << _lod << "_" << _x << "_" << _y;
-        _key = buf.str();
     }
     else
     {
         _extent = GeoExtent::INVALID;
-        _key = "invalid";
     }
 }
 
 TileKey::TileKey( const TileKey& rhs ) :
-_key( rhs._key ),
 _lod(rhs._lod),
 _x(rhs._x),
 _y(rhs._y),
@@ -68,6 +63,17 @@ _extent( rhs._extent )
     //NOP
 }
 
+std::string
+TileKey::str() const
+{
+    if ( !valid() )
+        return "invalid";
+
+    std::stringstream buf;
+    buf << _lod << "_" << _x << "_" << _y;
+    return buf.str();
+}
+
 const Profile*
 TileKey::getProfile() const
 {
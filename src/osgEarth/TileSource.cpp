@@ -146,6 +146,8 @@ _options( options )
     if ( *options.L2CacheSize() > 0 )
     {
         _memCache = new MemCache( *options.L2CacheSize() );
+        if ( options.L2CacheHeightPrecision().isSet() )
+            _memCache->setHeightPrecision( *options.L2CacheHeightPrecision() );
     }
     else
     {
@@ -201,8 +203,43 @@ TileSource::createImage(const TileKey& key, ImageOperation* prepOp, ProgressCall
         }
     }
 
+    // If another thread is already fetching this key, wait for its result
+    // instead of issuing a duplicate request to the driver.
+    osg::ref_ptr<PendingRequest> request;
+    bool isLeader = joinPendingRequest( _pendingImages, key, request );
+    if ( !isLeader )
+    {
+        // canceled while waiting: return NULL with the progress callback canceled,
+        // so the caller knows not to blacklist the tile.
+        if ( !waitForPendingRequest(request.get(), progress) )
+            return 0L;
+
+        if ( !request->_canceled )
+        {
+            const osg::Image* shared = dynamic_cast<const osg::Image*>( request->_result.get() );
+            if ( shared || !request->_hasResult )
+            {
+                osg::ref_ptr<osg::Image> image;
+                if ( shared )
+                    image = ImageUtils::cloneImage( shared );
+                if ( prepOp )
+                    (*prepOp)( image );
+                return image.release();
+            }
+
+            // joined after the result was shared out, so it's in the memcache by now.
+            osg::ref_ptr<const osg::Image> cachedImage;
+            if ( _memCache.valid() && _memCache->getImage( key, CacheSpec(), cachedImage ) )
+                return ImageUtils::cloneImage( cachedImage.get() );
+        }
+        // the original request was canceled (or its result is gone); fall through and issue our own.
+    }
+
     osg::ref_ptr<osg::Image> newImage = createImage(key, progress);
 
+    if ( isLeader )
+        sharePendingResult( request.get(), newImage.get(), progress && progress->isCanceled() );
+
     if ( prepOp )
         (*prepOp)( newImage );
 
@@ -212,6 +249,11 @@ TileSource::createImage(const TileKey& key, ImageOperation* prepOp, ProgressCall
         _memCache->setImage( key, CacheSpec(), newImage.get() );
     }
 
+    // only now stop coalescing, so that a new request for this key either joins us
+    // or finds the image in the memcache.
+    if ( isLeader )
+        completePendingRequest( _pendingImages, key, request.get() );
+
     return newImage.release();
 }
 
@@ -228,8 +270,43 @@ TileSource::createHeightField(const TileKey& key, HeightFieldOperation* prepOp,
         }
 	}
 
+    // If another thread is already fetching this key, wait for its result
+    // instead of issuing a duplicate request to the driver.
+    osg::ref_ptr<PendingRequest> request;
+    bool isLeader = joinPendingRequest( _pendingHeightFields, key, request );
+    if ( !isLeader )
+    {
+        // canceled while waiting: return NULL with the progress callback canceled,
+        // so the caller knows not to blacklist the tile.
+        if ( !waitForPendingRequest(request.get(), progress) )
+            return 0L;
+
+        if ( !request->_canceled )
+        {
+            const osg::HeightField* shared = dynamic_cast<const osg::HeightField*>( request->_result.get() );
+            if ( shared || !request->_hasResult )
+            {
+                osg::ref_ptr<osg::HeightField> hf;
+                if ( shared )
+                    hf = new osg::HeightField( *shared );
+                if ( prepOp )
+                    (*prepOp)( hf );
+                return hf.release();
+            }
+
+            // joined after the result was shared out, so it's in the memcache by now.
+            osg::ref_ptr<const osg::HeightField> cachedHF;
+            if ( _memCache.valid() && _memCache->getHeightField( key, CacheSpec(), cachedHF ) )
+                return new osg::HeightField( *cachedHF.get() );
+        }
+        // the original request was canceled (or its result is gone); fall through and issue our own.
+    }
+
     osg::ref_ptr<osg::HeightField> newHF = createHeightField( key, progress );
 
+    if ( isLeader )
+        sharePendingResult( request.get(), newHF.get(), progress && progress->isCanceled() );
+
     if ( prepOp )
         (*prepOp)( newHF );
 
@@ -238,10 +315,93 @@ TileSource::createHeightField(const TileKey& key, HeightFieldOperation* prepOp,
         _memCache->setHeightField( key, CacheSpec(), newHF.get() );
     }
 
+    // only now stop coalescing, so that a new request for this key either joins us
+    // or finds the heightfield in the memcache.
+    if ( isLeader )
+        completePendingRequest( _pendingHeightFields, key, request.get() );
+
     //TODO: why not just newHF.release()? -gw
     return newHF.valid() ? new osg::HeightField( *newHF.get() ) : 0L;
 }
 
+bool
+TileSource::joinPendingRequest(PendingRequestMap&             pending,
+                               const TileKey&                 key,
+                               osg::ref_ptr<PendingRequest>&  out_request )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _pendingMutex );
+
+    _coalescingStats._requests++;
+
+    TileKey::QuadKey qk = key.getQuadKey();
+    PendingRequestMap::iterator i = pending.find( qk );
+    if ( i != pending.end() )
+    {
+        out_request = i->second.get();
+        out_request->_waiters++;
+        _coalescingStats._coalesced++;
+        return false;
+    }
+
+    out_request = new PendingRequest();
+    pending[qk] = out_request.get();
+    return true;
+}
+
+bool
+TileSource::waitForPendingRequest( PendingRequest* request, ProgressCallback* progress )
+{
+    // poll so that we notice our own cancelation, and so that a spurious
+    // wakeup never passes for a completed request.
+    while( !request->_done.wait(20) )
+    {
+        if ( progress && progress->isCanceled() )
+            return false;
+    }
+    return true;
+}
+
+void
+TileSource::sharePendingResult(PendingRequest* request,
+                               osg::Object*    result,
+                               bool            canceled )
+{
+    unsigned waiters = 0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _pendingMutex );
+        waiters = request->_waiters;
+        request->_hasResult = result && !canceled;
+    }
+
+    // Only make the shared copy if someone is actually waiting; anyone who joins
+    // from here on reads the memcache instead. Waiters get a copy since the leader
+    // is free to modify its own result in place (with a prep operation for example).
+    if ( waiters > 0 && result && !canceled )
+    {
+        request->_result = result->clone( osg::CopyOp::DEEP_COPY_ALL );
+    }
+    request->_canceled = canceled;
+}
+
+void
+TileSource::completePendingRequest(PendingRequestMap& pending,
+                                   const TileKey&     key,
+                                   PendingRequest*    request )
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _pendingMutex );
+        pending.erase( key.getQuadKey() );
+    }
+    request->_done.set();
+}
+
+TileSource::CoalescingStats
+TileSource::getCoalescingStats() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( const_cast<TileSource*>(this)->_pendingMutex );
+    return _coalescingStats;
+}
+
 osg::HeightField*
 TileSource::createHeightField( const TileKey& key,
                                ProgressCallback* progress)
@@ -0,0 +1,238 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/Tracing>
+#include <osgEarth/Notify>
+#include <osg/Math>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+#define LC "[Tracer] "
+
+#if defined(_MSC_VER)
+#  define OE_THREAD_LOCAL __declspec(thread)
+#else
+#  define OE_THREAD_LOCAL __thread
+#endif
+
+using namespace osgEarth;
+using namespace OpenThreads;
+
+namespace
+{
+    // Ring of events owned by a single thread. Only the owner writes to it; the
+    // head counter is bumped after each slot is filled, so a reader can tell
+    // which slots were stable while it copied them.
+    struct ThreadBuffer
+    {
+        ThreadBuffer( unsigned id, unsigned capacity, bool isWorker )
+            : _id(id), _isWorker(isWorker), _events(capacity), _mask(capacity-1), _tail(0) { }
+
+        unsigned                _id;
+        bool                    _isWorker;
+        std::vector<TraceEvent> _events;
+        unsigned                _mask;
+        OpenThreads::Atomic     _head;  // total events written (wraps)
+        unsigned                _tail;  // events before this were cleared (reader side only)
+    };
+
+    typedef std::vector<ThreadBuffer*> ThreadBufferVector;
+
+    // buffers are never freed: a thread may exit while its events are still wanted.
+    OpenThreads::Mutex& s_buffersMutex() {
+        static OpenThreads::Mutex s_mutex;
+        return s_mutex;
+    }
+
+    ThreadBufferVector& s_buffers() {
+        static ThreadBufferVector s_vec;
+        return s_vec;
+    }
+
+    volatile bool s_enabled    = true;
+    unsigned      s_bufferSize = 4096;
+
+    OE_THREAD_LOCAL ThreadBuffer* s_threadBuffer = 0L;
+
+    ThreadBuffer* s_getThreadBuffer()
+    {
+        if ( !s_threadBuffer )
+        {
+            ScopedLock<Mutex> lock( s_buffersMutex() );
+            s_threadBuffer = new ThreadBuffer(
+                s_buffers().size() + 1,
+                s_bufferSize,
+                OpenThreads::Thread::CurrentThread() != 0L );
+            s_buffers().push_back( s_threadBuffer );
+        }
+        return s_threadBuffer;
+    }
+
+    void s_writeString( std::ostream& out, const char* str )
+    {
+        out << '"';
+        for( const char* c = str; *c; ++c )
+        {
+            if ( *c == '"' || *c == '\\' )
+                out << '\\';
+            if ( (unsigned char)*c >= 0x20 )
+                out << *c;
+        }
+        out << '"';
+    }
+}
+
+//------------------------------------------------------------------------
+
+void
+Tracer::setEnabled( bool value )
+{
+    s_enabled = value;
+}
+
+bool
+Tracer::isEnabled()
+{
+    return s_enabled;
+}
+
+void
+Tracer::setBufferSize( unsigned numEvents )
+{
+    unsigned size = 16;
+    while( size < numEvents && size < (1u << 24) )
+        size <<= 1;
+
+    ScopedLock<Mutex> lock( s_buffersMutex() );
+    s_bufferSize = size;
+}
+
+void
+Tracer::record( const TraceEvent& e )
+{
+    if ( !s_enabled )
+        return;
+
+    ThreadBuffer* buf = s_getThreadBuffer();
+    unsigned index = buf->_head;
+    buf->_events[index & buf->_mask] = e;
+    ++buf->_head;
+}
+
+void
+Tracer::record(const char* name, osg::Timer_t start, osg::Timer_t end,
+               const std::string& key, const std::string& layer )
+{
+    if ( !s_enabled )
+        return;
+
+    TraceEvent e;
+    e._name  = name;
+    e._start = start;
+    e._end   = end;
+    TraceEvent::setTag( e._key, key );
+    TraceEvent::setTag( e._layer, layer );
+    record( e );
+}
+
+void
+Tracer::clear()
+{
+    ScopedLock<Mutex> lock( s_buffersMutex() );
+    for( ThreadBufferVector::iterator i = s_buffers().begin(); i != s_buffers().end(); ++i )
+    {
+        (*i)->_tail = (*i)->_head;
+    }
+}
+
+void
+Tracer::writeJSON( std::ostream& out )
+{
+    ScopedLock<Mutex> lock( s_buffersMutex() );
+
+    osg::Timer* timer = osg::Timer::instance();
+    osg::Timer_t epoch = timer->getStartTick();
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::fixed << std::setprecision(3);
+
+    bool first = true;
+    std::vector<TraceEvent> copy;
+
+    for( ThreadBufferVector::iterator i = s_buffers().begin(); i != s_buffers().end(); ++i )
+    {
+        ThreadBuffer* buf = *i;
+        unsigned capacity = buf->_mask + 1;
+
+        // copy out the events, then throw away any the owner may have overwritten
+        // while we were copying.
+        unsigned head = buf->_head;
+        unsigned count = osg::minimum( head - buf->_tail, capacity );
+        unsigned begin = head - count;
+
+        copy.resize( count );
+        for( unsigned k = 0; k < count; ++k )
+            copy[k] = buf->_events[(begin + k) & buf->_mask];
+
+        unsigned headAfter = buf->_head;
+
+        out << (first ? "\n" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buf->_id
+            << ",\"args\":{\"name\":\"" << (buf->_isWorker ? "worker " : "thread ") << buf->_id << "\"}}";
+        first = false;
+
+        for( unsigned k = 0; k < count; ++k )
+        {
+            if ( headAfter - (begin + k) >= capacity )
+                continue;
+
+            const TraceEvent& e = copy[k];
+            out << ",\n{\"name\":";
+            s_writeString( out, e._name ? e._name : "" );
+            out << ",\"cat\":\"osgEarth\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buf->_id
+                << ",\"ts\":"  << timer->delta_u( epoch, e._start )
+                << ",\"dur\":" << timer->delta_u( e._start, e._end )
+                << ",\"args\":{\"key\":";
+            s_writeString( out, e._key );
+            out << ",\"layer\":";
+            s_writeString( out, e._layer );
+            out << "}}";
+        }
+    }
+
+    out << "\n]}" << std::endl;
+}
+
+bool
+Tracer::writeJSON( const std::string& filename )
+{
+    std::ofstream out( filename.c_str() );
+    if ( !out.is_open() )
+    {
+        OE_WARN << LC << "Cannot open \"" << filename << "\" for writing" << std::endl;
+        return false;
+    }
+
+    writeJSON( out );
+    OE_INFO << LC << "Wrote trace to " << filename << std::endl;
+    return true;
+}
@@ -38,6 +38,8 @@
 //#include "agg.h"
 
 #include <sstream>
+#include <vector>
+#include <string.h>
 #include <OpenThreads/Mutex>
 #include <OpenThreads/ScopedLock>
 
@@ -60,24 +62,62 @@ public:
         //nop
     }
 
+    virtual ~AGGLiteRasterizerTileSource()
+    {
+        for( unsigned i=0; i<_rasterizerPool.size(); ++i )
+            delete _rasterizerPool[i];
+    }
+
+    /**
+     * Rasterizers hold on to their cell and scanline buffers after a reset, so
+     * we pool them and reuse them from tile to tile instead of growing new
+     * buffers for every tile. Each tile in progress holds one.
+     */
+    agg::rasterizer* acquireRasterizer()
+    {
+        {
+            ScopedLock<Mutex> lock( _rasterizerPoolMutex );
+            if ( _rasterizerPool.size() > 0 )
+            {
+                agg::rasterizer* ras = _rasterizerPool.back();
+                _rasterizerPool.pop_back();
+                return ras;
+            }
+        }
+
+        agg::rasterizer* ras = new agg::rasterizer();
+        ras->gamma(1.3);
+        return ras;
+    }
+
+    void releaseRasterizer( agg::rasterizer* ras )
+    {
+        ras->reset();
+        ScopedLock<Mutex> lock( _rasterizerPoolMutex );
+        _rasterizerPool.push_back( ras );
+    }
+
     struct BuildData : public osg::Referenced {
-        BuildData() : _pass(0) { }
+        BuildData( AGGLiteRasterizerTileSource* source ) : _pass(0), _source(source) {
+            _ras = source->acquireRasterizer(); }
+        ~BuildData() {
+            _source->releaseRasterizer( _ras ); }
         int _pass;
+        AGGLiteRasterizerTileSource* _source;
+        agg::rasterizer* _ras;
     };
 
     //override
     osg::Referenced* createBuildData()
     {
-        return new BuildData();
+        return new BuildData( this );
     }
 
     //override
     bool preProcess(osg::Image* image, osg::Referenced* buildData)
     {
-        agg::rendering_buffer rbuf( image->data(), image->s(), image->t(), image->s()*4 );
-        agg::renderer<agg::span_abgr32> ren(rbuf);
-        ren.clear(agg::rgba8(0,0,0,0));
-        //ren.clear(agg::rgba8(255,255,255,0));
+        // clear to transparent black.
+        memset( image->data(), 0, image->getTotalSizeInBytes() );
         return true;
     }
 
@@ -217,15 +257,13 @@ public:
         xform.setLocalizeCoordinates( false );
         context = xform.push( features, context );
 
-        // set up the AGG renderer:
+        // set up the AGG renderer. We render straight into the RGBA image.
         agg::rendering_buffer rbuf( image->data(), image->s(), image->t(), image->s()*4 );
 
-        // Create the renderer and the rasterizer
-        agg::renderer<agg::span_abgr32> ren(rbuf);
-        agg::rasterizer ras;
-
-        // Setup the rasterizer
-        ras.gamma(1.3);
+        // Create the renderer, and set up the (pooled) rasterizer
+        agg::renderer<agg::span_rgba32> ren(rbuf);
+        agg::rasterizer& ras = *bd->_ras;
+        ras.reset();
         ras.filling_rule(agg::fill_even_odd);
 
         GeoExtent cropExtent = GeoExtent(imageExtent);
@@ -318,19 +356,6 @@ public:
         return true;            
     }
 
-    //override
-    bool postProcess( osg::Image* image, osg::Referenced* data )
-    {
-		//convert from ABGR to RGBA
-		unsigned char* pixel = image->data();
-		for(int i=0; i<image->s()*image->t()*4; i+=4, pixel+=4)
-		{
-			std::swap( pixel[0], pixel[3] );
-			std::swap( pixel[1], pixel[2] );
-		}
-        return true;
-    }
-
     virtual std::string getExtension()  const 
     {
         return "png";
@@ -339,6 +364,9 @@ public:
 private:
     const AGGLiteOptions _options;
     std::string _configPath;
+
+    std::vector<agg::rasterizer*> _rasterizerPool;
+    Mutex                         _rasterizerPoolMutex;
 };
 
 // Reads tiles from a TileCache disk cache.
@@ -0,0 +1,607 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "CacheChainOptions"
+
+#include <osgEarth/Metrics>
+#include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
+#include <osg/Math>
+#include <osgDB/ReaderWriter>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <map>
+#include <sstream>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+using namespace OpenThreads;
+
+#define LC "[CacheChain] "
+
+// --------------------------------------------------------------------------
+
+namespace
+{
+    /**
+     * Approximate access counts for recently requested tiles (a count-min
+     * sketch, as in TinyLFU). Uses a fixed amount of memory no matter how many
+     * distinct tiles go by; counts saturate at 15 and are halved every
+     * "sampleSize" accesses so that old popularity fades.
+     */
+    class FrequencySketch
+    {
+    public:
+        enum { DEPTH = 4, MAX_COUNT = 15 };
+
+        FrequencySketch( unsigned sampleSize )
+        {
+            unsigned width = 64;
+            while( width < sampleSize && width < (1u << 22) )
+                width <<= 1;
+            _mask = width - 1;
+            _counters.assign( width * DEPTH, 0 );
+            _sampleSize = osg::maximum( sampleSize, 1u );
+            _additions = 0;
+        }
+
+        /** Counts an access and returns the new estimate. */
+        unsigned increment( unsigned long long hash )
+        {
+            ScopedLock<Mutex> lock( _mutex );
+
+            unsigned estimate = MAX_COUNT;
+            for( unsigned i=0; i<DEPTH; ++i )
+                estimate = osg::minimum( estimate, (unsigned)_counters[index(hash, i)] );
+
+            // conservative update: only raise the counters that hold the minimum.
+            if ( estimate < MAX_COUNT )
+            {
+                for( unsigned i=0; i<DEPTH; ++i )
+                {
+                    unsigned char& c = _counters[index(hash, i)];
+                    if ( c == estimate )
+                        ++c;
+                }
+                ++estimate;
+            }
+
+            if ( ++_additions >= _sampleSize )
+            {
+                for( std::vector<unsigned char>::iterator c = _counters.begin(); c != _counters.end(); ++c )
+                    *c >>= 1;
+                _additions = 0;
+            }
+
+            return estimate;
+        }
+
+        /** Gets the estimated number of recent accesses. */
+        unsigned estimate( unsigned long long hash ) const
+        {
+            ScopedLock<Mutex> lock( const_cast<FrequencySketch*>(this)->_mutex );
+            unsigned estimate = MAX_COUNT;
+            for( unsigned i=0; i<DEPTH; ++i )
+                estimate = osg::minimum( estimate, (unsigned)_counters[index(hash, i)] );
+            return estimate;
+        }
+
+    private:
+        unsigned index( unsigned long long hash, unsigned row ) const
+        {
+            unsigned h1 = (unsigned)hash;
+            unsigned h2 = (unsigned)(hash >> 32) | 1u;
+            return row * (_mask + 1) + ((h1 + row * h2) & _mask);
+        }
+
+        Mutex                      _mutex;
+        std::vector<unsigned char> _counters;
+        unsigned                   _mask;
+        unsigned                   _sampleSize;
+        unsigned                   _additions;
+    };
+
+    // hashes a tile key and cache ID into 64 bits for the sketch.
+    unsigned long long hashTile( const TileKey& key, const CacheSpec& spec )
+    {
+        unsigned long long h = 14695981039346656037ULL; // FNV-1a over the cache ID
+        const std::string& id = spec.cacheId();
+        for( std::string::const_iterator c = id.begin(); c != id.end(); ++c )
+        {
+            h ^= (unsigned char)*c;
+            h *= 1099511628211ULL;
+        }
+
+        TileKey::QuadKey qk = key.getQuadKey();
+        h ^= qk._bits;
+        h ^= (unsigned long long)qk._deep << 32;
+
+        // final mix so that neighboring tiles land far apart
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+/**
+ * The tiers of a chain plus the writes still queued for them. Shared with the
+ * write-behind tasks so that a task never holds the last reference to the
+ * CacheChain itself (whose destructor shuts down the task threads).
+ */
+struct TierSet : public osg::Referenced
+{
+    struct Tier
+    {
+        osg::ref_ptr<Cache> _cache;
+        bool                _async;
+        bool                _admission;
+        MetricCounter*      _hitsMetric;
+    };
+    typedef std::vector<Tier> Tiers;
+
+    typedef std::pair<TileKey::QuadKey, std::string> PendingKey;
+
+    struct Pending
+    {
+        Pending() : _isHeightField(false), _tiers(0) { }
+        TileKey                         _key;
+        CacheSpec                       _spec;
+        osg::ref_ptr<const osg::Object> _object;
+        bool                            _isHeightField;
+        unsigned                        _tiers;  // bit mask of tiers still to write
+    };
+    typedef std::map<PendingKey, Pending> PendingMap;
+
+    TierSet( const std::string& name )
+        : _pendingMetric( Registry::instance()->getMetrics()->getGauge("cache." + name + ".pending_writes") ) { }
+
+    void write( unsigned tier, const TileKey& key, const CacheSpec& spec, const osg::Object* object, bool isHeightField )
+    {
+        Cache* cache = _tiers[tier]._cache.get();
+        if ( isHeightField )
+            cache->setHeightField( key, spec, static_cast<const osg::HeightField*>(object) );
+        else
+            cache->setImage( key, spec, static_cast<const osg::Image*>(object) );
+    }
+
+    bool read( unsigned tier, const TileKey& key, const CacheSpec& spec, bool isHeightField, osg::ref_ptr<const osg::Object>& out )
+    {
+        Cache* cache = _tiers[tier]._cache.get();
+        if ( isHeightField )
+        {
+            osg::ref_ptr<const osg::HeightField> hf;
+            if ( cache->getHeightField(key, spec, hf) )
+                out = hf.get();
+        }
+        else
+        {
+            osg::ref_ptr<const osg::Image> image;
+            if ( cache->getImage(key, spec, image) )
+                out = image.get();
+        }
+        return out.valid();
+    }
+
+    bool readPending( const TileKey& key, const CacheSpec& spec, bool isHeightField, osg::ref_ptr<const osg::Object>& out )
+    {
+        ScopedLock<Mutex> lock( _pendingMutex );
+        PendingMap::const_iterator i = _pending.find( PendingKey(key.getQuadKey(), spec.cacheId()) );
+        if ( i != _pending.end() && i->second._isHeightField == isHeightField )
+            out = i->second._object.get();
+        return out.valid();
+    }
+
+    bool isPending( const TileKey& key, const CacheSpec& spec )
+    {
+        ScopedLock<Mutex> lock( _pendingMutex );
+        return _pending.find( PendingKey(key.getQuadKey(), spec.cacheId()) ) != _pending.end();
+    }
+
+    /** Performs a queued write (if nobody else has yet). */
+    void completeWrite( const TileKey& key, const CacheSpec& spec )
+    {
+        Pending entry;
+        {
+            ScopedLock<Mutex> lock( _pendingMutex );
+            PendingMap::iterator i = _pending.find( PendingKey(key.getQuadKey(), spec.cacheId()) );
+            if ( i == _pending.end() )
+                return;
+            entry = i->second;
+            _pending.erase( i );
+            _pendingMetric->set( _pending.size() );
+        }
+
+        for( unsigned t=0; t<_tiers.size(); ++t )
+        {
+            if ( entry._tiers & (1u << t) )
+                write( t, key, spec, entry._object.get(), entry._isHeightField );
+        }
+    }
+
+    /** Performs every queued write on the calling thread. */
+    void flush()
+    {
+        PendingMap pending;
+        {
+            ScopedLock<Mutex> lock( _pendingMutex );
+            pending.swap( _pending );
+            _pendingMetric->set( 0 );
+        }
+
+        if ( pending.size() > 0 )
+        {
+            OE_INFO << LC << "Flushing " << pending.size() << " pending writes" << std::endl;
+        }
+
+        for( PendingMap::iterator i = pending.begin(); i != pending.end(); ++i )
+        {
+            for( unsigned t=0; t<_tiers.size(); ++t )
+            {
+                if ( i->second._tiers & (1u << t) )
+                    write( t, i->second._key, i->second._spec, i->second._object.get(), i->second._isHeightField );
+            }
+        }
+    }
+
+    Tiers        _tiers;
+    Mutex        _pendingMutex;
+    PendingMap   _pending;
+    MetricGauge* _pendingMetric;
+};
+
+struct WriteBehindTask : public TaskRequest
+{
+    WriteBehindTask( const TileKey& key, const CacheSpec& spec, TierSet* tiers )
+        : _key(key), _spec(spec), _tiers(tiers) { }
+
+    void operator()( ProgressCallback* progress )
+    {
+        _tiers->completeWrite( _key, _spec );
+    }
+
+    TileKey               _key;
+    CacheSpec             _spec;
+    osg::ref_ptr<TierSet> _tiers;
+};
+
+// --------------------------------------------------------------------------
+
+class CacheChain : public Cache
+{
+public:
+    CacheChain( const CacheOptions& options )
+        : Cache( options ),
+          _options( options ),
+          _sketch( _options.frequencySampleSize().value() ),
+          _set( 0L )
+    {
+        // numbered so that two chains (e.g. one per map) keep separate metrics.
+        static OpenThreads::Atomic s_numChains;
+        setName( "chain#" + toString<unsigned>(++s_numChains) );
+
+        _set = new TierSet( getName() );
+
+        MetricsRegistry* metrics = Registry::instance()->getMetrics();
+        _rejectsMetric = metrics->getCounter( "cache." + getName() + ".admission_rejects" );
+
+        bool writeBehind = _options.writeBehind() == true;
+        bool anyAsync = false;
+
+        const CacheChainOptions::TierOptionsVector& tiers = _options.tiers();
+        for( CacheChainOptions::TierOptionsVector::const_iterator i = tiers.begin(); i != tiers.end(); ++i )
+        {
+            if ( _set->_tiers.size() >= 32 )
+            {
+                OE_WARN << LC << "Too many tiers; ignoring the rest" << std::endl;
+                break;
+            }
+
+            Config conf = i->getConfig();
+            TierSet::Tier tier;
+
+            if ( i->getDriver() == "memory" )
+            {
+                MemCache* memCache = new MemCache( conf.value<int>("max_tiles", 256) );
+                memCache->setHeightPrecision( conf.value<float>("height_precision", 0.0f) );
+                tier._cache = memCache;
+                tier._async = false;
+                tier._admission = conf.value<bool>("admission", true);
+            }
+            else
+            {
+                CacheOptions tierOptions( *i );
+                tierOptions.setReferenceURI( options.getReferenceURI() );
+                tier._cache = CacheFactory::create( tierOptions );
+                tier._async = writeBehind;
+                tier._admission = conf.value<bool>("admission", false);
+            }
+
+            if ( !tier._cache.valid() )
+            {
+                OE_WARN << LC << "Failed to create tier \"" << i->getDriver() << "\"; skipping it" << std::endl;
+                continue;
+            }
+
+            std::stringstream buf;
+            buf << "cache." << getName() << "." << _set->_tiers.size() << "_" << i->getDriver() << ".hits";
+            tier._hitsMetric = metrics->getCounter( buf.str() );
+
+            OE_INFO << LC << "Tier " << _set->_tiers.size() << ": " << i->getDriver()
+                << (tier._async ? " (write-behind)" : "")
+                << (tier._admission ? " (admission)" : "") << std::endl;
+
+            anyAsync = anyAsync || tier._async;
+            _set->_tiers.push_back( tier );
+        }
+
+        if ( _set->_tiers.empty() )
+        {
+            OE_WARN << LC << "No tiers configured; nothing will be cached" << std::endl;
+        }
+
+        if ( anyAsync )
+        {
+            _writeService = new TaskService(
+                "CacheChain write-behind",
+                osg::maximum( _options.writeBehindThreads().value(), 1u ) );
+        }
+    }
+
+    // just here to satisfy the osg::Object requirements
+    CacheChain() : _sketch(1) { }
+    CacheChain( const CacheChain& rhs, const osg::CopyOp& op ) : _sketch(1) { }
+    META_Object(osgEarth,CacheChain);
+
+public: // Cache interface
+
+    bool isCached( const TileKey& key, const CacheSpec& spec ) const
+    {
+        if ( _set->isPending(key, spec) )
+            return true;
+
+        for( TierSet::Tiers::const_iterator t = _set->_tiers.begin(); t != _set->_tiers.end(); ++t )
+        {
+            if ( t->_cache->isCached(key, spec) )
+                return true;
+        }
+        return false;
+    }
+
+    bool getImage( const TileKey& key, const CacheSpec& spec, osg::ref_ptr<const osg::Image>& out_image )
+    {
+        osg::ref_ptr<const osg::Object> result;
+        if ( getObject(key, spec, false, result) )
+            out_image = static_cast<const osg::Image*>( result.get() );
+        return out_image.valid();
+    }
+
+    void setImage( const TileKey& key, const CacheSpec& spec, const osg::Image* image )
+    {
+        if ( image )
+            setObject( key, spec, image, false, _set->_tiers.size(), _sketch.estimate(hashTile(key, spec)) );
+    }
+
+    bool getHeightField( const TileKey& key, const CacheSpec& spec, osg::ref_ptr<const osg::HeightField>& out_hf )
+    {
+        osg::ref_ptr<const osg::Object> result;
+        if ( getObject(key, spec, true, result) )
+            out_hf = static_cast<const osg::HeightField*>( result.get() );
+        return out_hf.valid();
+    }
+
+    void setHeightField( const TileKey& key, const CacheSpec& spec, const osg::HeightField* hf )
+    {
+        if ( hf )
+            setObject( key, spec, hf, true, _set->_tiers.size(), _sketch.estimate(hashTile(key, spec)) );
+    }
+
+    void setReferenceURI( const std::string& value )
+    {
+        Cache::setReferenceURI( value );
+        for( TierSet::Tiers::iterator t = _set->_tiers.begin(); t != _set->_tiers.end(); ++t )
+            t->_cache->setReferenceURI( value );
+    }
+
+    void storeProperties( const CacheSpec& spec, const Profile* profile, unsigned int tileSize )
+    {
+        for( TierSet::Tiers::iterator t = _set->_tiers.begin(); t != _set->_tiers.end(); ++t )
+            t->_cache->storeProperties( spec, profile, tileSize );
+    }
+
+    bool loadProperties(
+        const std::string&           cacheId,
+        CacheSpec&                   out_spec,
+        osg::ref_ptr<const Profile>& out_profile,
+        unsigned int&                out_tileSize )
+    {
+        for( TierSet::Tiers::iterator t = _set->_tiers.begin(); t != _set->_tiers.end(); ++t )
+        {
+            if ( t->_cache->loadProperties(cacheId, out_spec, out_profile, out_tileSize) )
+                return true;
+        }
+        return false;
+    }
+
+    bool compact( bool async )
+    {
+        bool result = false;
+        for( TierSet::Tiers::iterator t = _set->_tiers.begin(); t != _set->_tiers.end(); ++t )
+            result = t->_cache->compact( async ) || result;
+        return result;
+    }
+
+    bool purge( const std::string& cacheId, int olderThanTimeStamp, bool async )
+    {
+        bool result = false;
+        for( TierSet::Tiers::iterator t = _set->_tiers.begin(); t != _set->_tiers.end(); ++t )
+            result = t->_cache->purge( cacheId, olderThanTimeStamp, async ) || result;
+        return result;
+    }
+
+protected:
+
+    virtual ~CacheChain()
+    {
+        // stop the writers, then write out whatever they did not get to.
+        _writeService = 0L;
+        if ( _set.valid() )
+            _set->flush();
+    }
+
+private:
+
+    bool getObject( const TileKey& key, const CacheSpec& spec, bool isHeightField, osg::ref_ptr<const osg::Object>& out )
+    {
+        unsigned frequency = _sketch.increment( hashTile(key, spec) );
+
+        // writes still queued for the slower tiers are as good as a hit there.
+        bool checkedPending = false;
+
+        for( unsigned t=0; t<_set->_tiers.size(); ++t )
+        {
+            if ( _set->_tiers[t]._async && !checkedPending )
+            {
+                checkedPending = true;
+                if ( _set->readPending(key, spec, isHeightField, out) )
+                {
+                    setObject( key, spec, out.get(), isHeightField, t, frequency );
+                    return true;
+                }
+            }
+
+            if ( _set->read(t, key, spec, isHeightField, out) )
+            {
+                _set->_tiers[t]._hitsMetric->add();
+
+                // promote into the faster tiers.
+                if ( t > 0 )
+                    setObject( key, spec, out.get(), isHeightField, t, frequency );
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // writes to the tiers above "endTier", subject to admission.
+    void setObject( const TileKey& key, const CacheSpec& spec, const osg::Object* object, bool isHeightField,
+                    unsigned endTier, unsigned frequency )
+    {
+        unsigned deferred = 0;
+
+        for( unsigned t=0; t<endTier; ++t )
+        {
+            const TierSet::Tier& tier = _set->_tiers[t];
+
+            if ( tier._admission && frequency < _options.admissionThreshold().value() )
+            {
+                _rejectsMetric->add();
+                continue;
+            }
+
+            if ( tier._async && _writeService.valid() )
+                deferred |= (1u << t);
+            else
+                _set->write( t, key, spec, object, isHeightField );
+        }
+
+        if ( deferred == 0 )
+            return;
+
+        bool queued = false;
+        {
+            ScopedLock<Mutex> lock( _set->_pendingMutex );
+            TierSet::PendingKey pkey( key.getQuadKey(), spec.cacheId() );
+            TierSet::PendingMap::iterator i = _set->_pending.find( pkey );
+            if ( i != _set->_pending.end() )
+            {
+                // already queued; the queued task will write the newest data.
+                i->second._object = object;
+                i->second._isHeightField = isHeightField;
+                i->second._tiers |= deferred;
+                return;
+            }
+
+            if ( _set->_pending.size() < _options.maxPendingWrites().value() )
+            {
+                TierSet::Pending& entry = _set->_pending[pkey];
+                entry._key = key;
+                entry._spec = spec;
+                entry._object = object;
+                entry._isHeightField = isHeightField;
+                entry._tiers = deferred;
+                _set->_pendingMetric->set( _set->_pending.size() );
+                queued = true;
+            }
+        }
+
+        if ( queued )
+        {
+            _writeService->add( new WriteBehindTask(key, spec, _set.get()) );
+        }
+        else
+        {
+            // the queue is full, so write on this thread.
+            for( unsigned t=0; t<endTier; ++t )
+            {
+                if ( deferred & (1u << t) )
+                    _set->write( t, key, spec, object, isHeightField );
+            }
+        }
+    }
+
+    CacheChainOptions         _options;
+    FrequencySketch           _sketch;
+    osg::ref_ptr<TierSet>     _set;
+    osg::ref_ptr<TaskService> _writeService;
+    MetricCounter*            _rejectsMetric;
+};
+
+// --------------------------------------------------------------------------
+
+class CacheChainFactory : public CacheDriver
+{
+public:
+    CacheChainFactory()
+    {
+        supportsExtension( "osgearth_cache_chain", "Tiered cache chain for osgEarth" );
+    }
+
+    virtual const char* className()
+    {
+        return "Tiered cache chain for osgEarth";
+    }
+
+    virtual ReadResult readObject(const std::string& file_name, const Options* options) const
+    {
+        if ( !acceptsExtension(osgDB::getLowerCaseFileExtension( file_name )))
+            return ReadResult::FILE_NOT_HANDLED;
+
+        return ReadResult( new CacheChain( getCacheOptions(options) ) );
+    }
+};
+
+REGISTER_OSGPLUGIN(osgearth_cache_chain, CacheChainFactory)
@@ -18,6 +18,7 @@
  */
 #include "Sqlite3CacheOptions"
 
+#include <osgEarth/CacheCodec>
 #include <osgEarth/FileUtils>
 #include <osgEarth/TaskService>
 #include <osgDB/FileNameUtils>
@@ -104,7 +105,8 @@ public:
     virtual void setImageSync(
         const TileKey& key,
         const CacheSpec& spec,
-        const osg::Image* image ) =0;
+        const osg::Image* image,
+        const std::string& encoded ) =0;
 };
 
 
@@ -312,6 +314,7 @@ struct ImageRecord
     int _created;
     int _accessed;
     osg::ref_ptr<const osg::Image> _image;
+    std::string _encoded; // already-serialized image, if available
 };
 
 #ifdef INSERT_POOL
@@ -490,6 +493,38 @@ struct LayerTable : public osg::Referenced
         purge(t, maxElementToRemove, db);
     }
 
+    // serializes an image with this layer's codec or ReaderWriter.
+    void serialize( const osg::Image& image, std::string& out )
+    {
+        if ( _codec.valid() )
+        {
+            _codec->encode( &image, out );
+        }
+        else
+        {
+            std::stringstream outStream;
+            _rw->writeImage( image, outStream, _rwOptions.get() );
+            out = outStream.str();
+        }
+    }
+
+    osgDB::ReaderWriter::ReadResult deserialize( const std::string& buf )
+    {
+        if ( _codec.valid() )
+        {
+            osg::Image* image = _codec->decodeImage( buf );
+            if ( image )
+                return osgDB::ReaderWriter::ReadResult( image );
+            else
+                return osgDB::ReaderWriter::ReadResult( "Failed to decode cached tile" );
+        }
+        else
+        {
+            std::stringstream inStream( buf );
+            return _rw->readImage( inStream );
+        }
+    }
+
     bool store( const ImageRecord& rec, sqlite3* db )
     {
         displayStats();
@@ -514,9 +549,9 @@ struct LayerTable : public osg::Referenced
 
         // serialize the image:
 #ifdef SPLIT_DB_FILE
-        std::stringstream outStream;
-        _rw->writeImage( *rec._image.get(), outStream, _rwOptions.get() );
-        std::string outBuf = outStream.str();
+        std::string outBuf = rec._encoded;
+        if ( outBuf.empty() )
+            serialize( *rec._image.get(), outBuf );
         std::string fname = _meta._layerName + "_" + keyStr+".osgb";
         {
             std::ofstream file(fname.c_str(), std::ios::out | std::ios::binary);
@@ -526,9 +561,9 @@ struct LayerTable : public osg::Referenced
         }
         sqlite3_bind_int( insert, 4, outBuf.length() );
 #else
-        std::stringstream outStream;
-        _rw->writeImage( *rec._image.get(), outStream, _rwOptions.get() );
-        std::string outBuf = outStream.str();
+        std::string outBuf = rec._encoded;
+        if ( outBuf.empty() )
+            serialize( *rec._image.get(), outBuf );
         sqlite3_bind_blob( insert, 4, outBuf.c_str(), outBuf.length(), SQLITE_STATIC );
 #endif
 
@@ -590,9 +625,8 @@ struct LayerTable : public osg::Referenced
 
             // serialize the image:
 #ifdef SPLIT_DB_FILE
-            std::stringstream outStream;
-            _rw->writeImage( * (it)->second._image.get(), outStream, _rwOptions.get() );
-            std::string outBuf = outStream.str();
+            std::string outBuf;
+            serialize( *(it)->second._image.get(), outBuf );
             std::string fname = _meta._layerName + "_" + keyStr+".osgb";
             {
                 std::ofstream file(fname.c_str(), std::ios::out | std::ios::binary);
@@ -602,9 +636,8 @@ struct LayerTable : public osg::Referenced
             }
             sqlite3_bind_int( insert, 4, outBuf.length() );
 #else
-            std::stringstream outStream;
-            _rw->writeImage( * (it)->second._image.get(), outStream, _rwOptions.get() );
-            std::string outBuf = outStream.str();
+            std::string outBuf;
+            serialize( *(it)->second._image.get(), outBuf );
             sqlite3_bind_blob( insert, 4, outBuf.c_str(), outBuf.length(), SQLITE_STATIC );
 #endif
             rc = sqlite3_step(insert);   // executes the INSERT
@@ -726,8 +759,7 @@ struct LayerTable : public osg::Referenced
 
         // deserialize the image from the buffer:
         std::string imageString( data, imageBufLen );
-        std::stringstream imageBufStream( imageString );
-        osgDB::ReaderWriter::ReadResult rr = _rw->readImage( imageBufStream );
+        osgDB::ReaderWriter::ReadResult rr = deserialize( imageString );
 #endif
         if ( rr.error() )
         {
@@ -883,6 +915,20 @@ struct LayerTable : public osg::Referenced
             //return false;
         }
 
+        // tiles written through a CacheCodec don't need a ReaderWriter:
+        if ( _meta._format == CacheCodec::getFormatName() )
+        {
+            _codec = CacheCodec::create( _meta._compressor );
+            if ( !_codec.valid() )
+            {
+                OE_WARN << LC << "Creating layer: Cannot initialize codec \""
+                    << _meta._compressor << "\"" << std::endl;
+                return false;
+            }
+            _statsLastCheck = _statsStartTimer = osg::Timer::instance()->tick();
+            return true;
+        }
+
         // next load the appropriate ReaderWriter:
 
 #if OSG_MIN_VERSION_REQUIRED(2,9,5)
@@ -917,6 +963,7 @@ struct LayerTable : public osg::Referenced
 
     osg::ref_ptr<osgDB::ReaderWriter> _rw;
     osg::ref_ptr<osgDB::ReaderWriter::Options> _rwOptions;
+    osg::ref_ptr<CacheCodec> _codec;
 
     osg::Timer_t _statsStartTimer;
     osg::Timer_t _statsLastCheck;
@@ -957,15 +1004,28 @@ struct AsyncInsert : public TaskRequest {
     void operator()( ProgressCallback* progress ) {
         osg::ref_ptr<AsyncCache> cache = _cache.get();
         if ( cache.valid() )
-            cache->setImageSync( _key, _cacheSpec, _image.get() );
+            cache->setImageSync( _key, _cacheSpec, _image.get(), _encoded );
     }
 
     CacheSpec _cacheSpec;
     TileKey _key;
     osg::ref_ptr<const osg::Image> _image;
+    std::string _encoded;
     osg::observer_ptr<AsyncCache> _cache;
 };
 
+class Sqlite3Cache;
+
+// encodes a tile on one of the encoder threads, then hands it to the writer.
+struct AsyncEncode : public TaskRequest
+{
+    AsyncEncode( AsyncInsert* insert, Sqlite3Cache* cache ) : _insert(insert), _cache(cache) { }
+    void operator()( ProgressCallback* progress );
+
+    osg::ref_ptr<AsyncInsert> _insert;
+    osg::observer_ptr<Sqlite3Cache> _cache;
+};
+
 class Sqlite3Cache;
 struct AsyncUpdateAccessTime : public TaskRequest
 {
@@ -1053,9 +1113,23 @@ public:
                 _db = 0L;
         }
 
+        if ( _options.codec().isSet() )
+        {
+            _codec = CacheCodec::create( _options.codec().value() );
+            if ( !_codec.valid() )
+                OE_WARN << LC << "New layers will be stored as osgb" << std::endl;
+        }
+
         if ( _db && _options.asyncWrites() == true )
         {
             _writeService = new osgEarth::TaskService( "Sqlite3Cache Write Service", 1 );
+
+            // encoding a raw tile is independent of the database, so it can run in
+            // parallel ahead of the single writer thread.
+            if ( _codec.valid() && _options.encodeThreads().value() > 0 )
+            {
+                _encodeService = new osgEarth::TaskService( "Sqlite3Cache Encode Service", _options.encodeThreads().value() );
+            }
         }
 
         
@@ -1113,12 +1187,20 @@ public: // Cache interface
         rec._profile = profile;
         rec._tileSize = tileSize;
 
+        if ( _codec.valid() )
+        {
+            rec._format = CacheCodec::getFormatName();
+            rec._compressor = _codec->getName();
+        }
+        else
+        {
 #ifdef USE_SERIALIZERS
-        rec._format = "osgb";
-        rec._compressor = "zlib";
+            rec._format = "osgb";
+            rec._compressor = "zlib";
 #else
-        rec._format = spec.format();
+            rec._format = spec.format();
 #endif
+        }
 
         _metadata.store( rec, db );
     }
@@ -1193,8 +1275,8 @@ public: // Cache interface
             }
 #else
             ScopedLock<Mutex> lock( _pendingWritesMutex );
-            std::string name = key.str() + spec.cacheId(); //layerName;
-            std::map<std::string,osg::ref_ptr<AsyncInsert> >::iterator i = _pendingWrites.find(name);
+            PendingWriteKey name( key.getQuadKey(), spec.cacheId() ); //layerName;
+            PendingWrites::iterator i = _pendingWrites.find(name);
             if ( i != _pendingWrites.end() )
             {
                 // todo: update the access time, or let it slide?
@@ -1285,12 +1367,15 @@ public: // Cache interface
                 it->second->addEntry(key, format, image);
             }
 #else
-            std::string name = key.str() + spec.cacheId();
+            PendingWriteKey name( key.getQuadKey(), spec.cacheId() );
             if ( _pendingWrites.find(name) == _pendingWrites.end() )
             {
                 AsyncInsert* req = new AsyncInsert(key, spec, image, this);
                 _pendingWrites[name] = req;
-                _writeService->add( req );
+                if ( _encodeService.valid() )
+                    _encodeService->add( new AsyncEncode(req, this) );
+                else
+                    _writeService->add( req );
             }
             else
             {
@@ -1302,7 +1387,7 @@ public: // Cache interface
         else
         {
 
-            setImageSync( key, spec, image );
+            setImageSync( key, spec, image, std::string() );
         }
     }
 
@@ -1473,7 +1558,20 @@ private:
         //OE_INFO << LC << "Pending writes: " << std::dec << _writeService->getNumRequests() << std::endl;
     }
 
-    void setImageSync( const TileKey& key, const CacheSpec& spec, const osg::Image* image )
+    /**
+     * Serializes the image for an insert (on an encoder thread) and queues
+     * the insert with the writer.
+     */
+    void encodeAndInsert( AsyncInsert* req )
+    {
+        ThreadTable tt = getTable( req->_cacheSpec.cacheId() );
+        if ( tt._table )
+            tt._table->serialize( *req->_image.get(), req->_encoded );
+
+        _writeService->add( req );
+    }
+
+    void setImageSync( const TileKey& key, const CacheSpec& spec, const osg::Image* image, const std::string& encoded )
     {
         if (_options.maxSize().value() > 0 && _nbRequest > MAX_REQUEST_TO_RUN_PURGE) {
             int t = (int)::time(0L);
@@ -1490,6 +1588,7 @@ private:
             rec._created = (int)t;
             rec._accessed = (int)t;
             rec._image = image;
+            rec._encoded = encoded;
 
             tt._table->store( rec, tt._db );
         }
@@ -1497,7 +1596,11 @@ private:
         if ( _options.asyncWrites() == true )
         {
             ScopedLock<Mutex> lock( _pendingWritesMutex );
+#ifdef INSERT_POOL
             std::string name = key.str() + spec.cacheId();
+#else
+            PendingWriteKey name( key.getQuadKey(), spec.cacheId() );
+#endif
             _pendingWrites.erase( name );
             displayPendingOperations();
         }
@@ -1645,12 +1748,17 @@ private:
 
     bool _useAsyncWrites;
     osg::ref_ptr<TaskService> _writeService;
+    osg::ref_ptr<TaskService> _encodeService;
+    osg::ref_ptr<CacheCodec>  _codec;
     Mutex _pendingWritesMutex;
 
 #ifdef INSERT_POOL
     std::map<std::string, osg::ref_ptr<AsyncInsertPool> > _pendingWrites;
 #else
-    std::map<std::string, osg::ref_ptr<AsyncInsert> > _pendingWrites;
+    // packed tile key + cache ID
+    typedef std::pair<TileKey::QuadKey, std::string> PendingWriteKey;
+    typedef std::map<PendingWriteKey, osg::ref_ptr<AsyncInsert> > PendingWrites;
+    PendingWrites _pendingWrites;
 #endif
     Mutex _pendingUpdateMutex;
     std::map<std::string, osg::ref_ptr<AsyncUpdateAccessTimePool> > _pendingUpdates;
@@ -1675,6 +1783,13 @@ private:
 
 
 
+void AsyncEncode::operator()( ProgressCallback* progress )
+{
+    osg::ref_ptr<Sqlite3Cache> cache = _cache.get();
+    if ( cache.valid() )
+        cache->encodeAndInsert( _insert.get() );
+}
+
 AsyncUpdateAccessTime::AsyncUpdateAccessTime( const TileKey& key, const std::string& cacheId, int timeStamp, Sqlite3Cache* cache ) : 
 _key(key), _cacheId(cacheId), _timeStamp(timeStamp), _cache(cache)
 {
@@ -48,6 +48,9 @@ _maxJobsPerFrame( MAX_JOBS_PER_FRAME )
     // fire up a task service to load textures.
     _imageService = new TaskService( "Image Service", 16 );
 
+    // avoid reallocating the node pool during the initial seeding.
+    _nodes.reserve( RESERVED_VERTICES );
+
     _amrGeom = new AMRGeometry();
     _amrGeom->setDataVariance( osg::Object::DYNAMIC );
 
@@ -71,8 +74,8 @@ MeshManager::addNode( const MeshNode& node )
     }
     else
     {
-        NodeIndex ni = _freeList.front();
-        _freeList.pop();
+        NodeIndex ni = _freeList.back();
+        _freeList.pop_back();
         _nodes[ni] = node;
         result = ni;
     }
@@ -89,7 +92,7 @@ MeshManager::addNode( const osg::Vec3d& manifoldCoord )
 void
 MeshManager::removeNode( NodeIndex ni )
 {
-    _freeList.push( ni );
+    _freeList.push_back( ni );
 }
 
 void
@@ -222,7 +222,8 @@ _quickReleaseGLObjects( quickReleaseGLObjects ),
 _key( key ),
 _keyLocator( keyLocator ),
 _verticalScale(1.0f),
-_mask( 0L )
+_mask( 0L ),
+_tileLayersMutex( 1 )
 {
     this->setLocator( keyLocator );
 
@@ -22,6 +22,8 @@
 
 #include <osgEarth/Cube>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/Registry>
+#include <osgEarth/Tracing>
 
 #include <osg/Point>
 #include <osg/Program>
@@ -61,6 +63,9 @@ _frontGeodeInstalled( false ),
 _debug( false )
 {
     this->setThreadSafeRefUnref(true);
+
+    _compiledMetric    = Registry::instance()->getMetrics()->getCounter( "terrain.tiles_compiled" );
+    _compileTimeMetric = Registry::instance()->getMetrics()->getHistogram( "terrain.tile_compile" );
 }
 
 SinglePassTerrainTechnique::SinglePassTerrainTechnique(const SinglePassTerrainTechnique& rhs, const osg::CopyOp& copyop):
@@ -73,7 +78,9 @@ _optimizeTriangleOrientation( rhs._optimizeTriangleOrientation ),
 _texCompositor( rhs._texCompositor.get() ),
 _frontGeodeInstalled( rhs._frontGeodeInstalled ),
 _debug( rhs._debug ),
-_parentTile( rhs._parentTile )
+_parentTile( rhs._parentTile ),
+_compiledMetric( rhs._compiledMetric ),
+_compileTimeMetric( rhs._compileTimeMetric )
 {
     //NOP
 }
@@ -131,6 +138,8 @@ SinglePassTerrainTechnique::compile( const TileUpdate& update, ProgressCallback*
 
     // serialize access to the compilation procedure.
     OpenThreads::ScopedLock<Mutex> exclusiveLock( _compileMutex );
+    ScopedMetricTimer timer( _compileTimeMetric );
+    OE_TRACE_SCOPE( "tile.compile", _tile->getKey().str(), "" );
     
     // make a frame to use during compilation.
     TileFrame tilef( _tile );
@@ -164,6 +173,7 @@ SinglePassTerrainTechnique::compile( const TileUpdate& update, ProgressCallback*
             _backGeode->setStateSet( stateSet.get() );
 
             _pendingGeometryUpdate = true;
+            _compiledMetric->add();
         }
     }
 
@@ -181,6 +191,7 @@ SinglePassTerrainTechnique::compile( const TileUpdate& update, ProgressCallback*
         _backGeode->setStateSet( stateSet.get() );
 
         _pendingGeometryUpdate = true;
+        _compiledMetric->add();
     }
 
     else // all other update types
@@ -208,7 +219,11 @@ SinglePassTerrainTechnique::compile( const TileUpdate& update, ProgressCallback*
         }
 
         // create the stateset for this tile, which contains all the texture information.
-        osg::StateSet* stateSet = createStateSet( tilef );
+        osg::StateSet* stateSet = 0L;
+        {
+            OE_TRACE_SCOPE( "tile.composite", _tile->getKey().str(), "" );
+            stateSet = createStateSet( tilef );
+        }
         if ( stateSet )
         {
             _backGeode->setStateSet( stateSet );
@@ -229,6 +244,7 @@ SinglePassTerrainTechnique::compile( const TileUpdate& update, ProgressCallback*
             OE_WARN << LC << "ILLEGAL! no stateset in BackGeode!!" << std::endl;
 
         _pendingFullUpdate = true;
+        _compiledMetric->add();
     }
 }
 
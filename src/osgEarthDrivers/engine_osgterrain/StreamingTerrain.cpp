@@ -31,6 +31,8 @@
 
 #include <OpenThreads/ScopedLock>
 
+#include <set>
+
 using namespace osgEarth;
 using namespace OpenThreads;
 
@@ -53,6 +55,13 @@ _numLoadingThreads( 0 )
     _numLoadingThreads = computeLoadingThreads(_loadingPolicy);
 
     OE_INFO << LC << "Using a total of " << _numLoadingThreads << " loading threads " << std::endl;
+
+    if ( _loadingPolicy.autoTuneThreads() == true )
+    {
+        _loadingServiceMgr = new TaskServiceManager( _numLoadingThreads );
+        _loadingServiceMgr->setAutoTune( true );
+        OE_INFO << LC << "Auto-tuning the loading threads" << std::endl;
+    }
 }
 
 StreamingTerrain::~StreamingTerrain()
@@ -222,6 +231,12 @@ StreamingTerrain::updateTraversal( osg::NodeVisitor& nv )
         }
     }
 
+    // let the loading threads follow the load, if enabled.
+    if ( _loadingServiceMgr.valid() )
+    {
+        _loadingServiceMgr->update();
+    }
+
     // next, go through the live tiles and process update-traversal requests. This
     // requires a read-lock on the master tiles table.
     {
@@ -332,6 +347,36 @@ StreamingTerrain::updateTaskServiceThreads( const MapFrame& mapf )
 
     float totalWeight = elevationWeight + totalImageWeight;
 
+    // When auto-tuning, the weights are just the starting point; the manager
+    // moves the threads around based on what the services actually do.
+    if ( _loadingServiceMgr.valid() )
+    {
+        TaskServiceManager::ServiceStatsVector current;
+        _loadingServiceMgr->getStats( current );
+
+        std::set<UID> live;
+        if ( elevationWeight > 0.0f )
+        {
+            _loadingServiceMgr->add( ELEVATION_TASK_SERVICE_ID, getElevationTaskService(), elevationWeight );
+            live.insert( ELEVATION_TASK_SERVICE_ID );
+        }
+
+        for (ImageLayerVector::const_iterator itr = mapf.imageLayers().begin(); itr != mapf.imageLayers().end(); ++itr)
+        {
+            UID uid = itr->get()->getUID();
+            _loadingServiceMgr->add( uid, getImageryTaskService(uid), itr->get()->getTerrainLayerOptions().loadingWeight().value() );
+            live.insert( uid );
+        }
+
+        // stop managing the services of layers that went away.
+        for( TaskServiceManager::ServiceStatsVector::const_iterator i = current.begin(); i != current.end(); ++i )
+        {
+            if ( live.find(i->_uid) == live.end() )
+                _loadingServiceMgr->remove( i->_uid );
+        }
+        return;
+    }
+
     if (elevationWeight > 0.0f)
     {
         //Determine how many threads each layer gets
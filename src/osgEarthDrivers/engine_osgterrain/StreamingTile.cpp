@@ -25,6 +25,7 @@
 #include <osgEarth/Locators>
 #include <osgEarth/Map>
 #include <osgEarth/FindNode>
+#include <osgEarth/Tracing>
 
 #include <osg/NodeCallback>
 #include <osg/NodeVisitor>
@@ -632,6 +633,8 @@ StreamingTile::serviceCompletedRequests( const MapFrame& mapf, bool tileTableLoc
             //TODO: consider waiting to apply if there are still more tile updates in the queue.
             if ( _tileUpdates.size() == 0 )
             {
+                // traced here rather than for the whole method, which runs every frame for every tile
+                OE_TRACE_SCOPE( "tile.merge", _key.str(), "" );
                 tileModified = tech->applyTileUpdates();
             }
         }
@@ -51,7 +51,8 @@ _verticalScale( 1.0f ),
 _mask( 0L ),
 _parentTileSet( false ),
 _tileId( key.getTileId() ),
-_dirty( true )
+_dirty( true ),
+_tileLayersMutex( 1 )
 {
     this->setThreadSafeRefUnref( true );
     this->setName( key.str() );
@@ -984,8 +984,8 @@ class CacheInitializer
 public:
     CacheInitializer()
     {
-        EulerSpatialReference::getSpatialReferenceCache()["euler-cube"]
-            = createEulerSRS();
+        EulerSpatialReference::registerSpatialReference(
+            "euler-cube", createEulerSRS() );
     }
 };
 
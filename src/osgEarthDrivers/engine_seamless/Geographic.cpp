@@ -13,7 +13,9 @@
 #include <osg/Texture2D>
 
 #include <osgEarth/ImageUtils>
+#include <osgEarth/Metrics>
 #include <osgEarth/Notify>
+#include <osgEarth/Registry>
 #include <osgEarth/VerticalSpatialReference>
 #include <osgEarth/TaskService>
 
@@ -28,6 +30,90 @@ using namespace osgEarth;
 
 typedef multi_array_ref<Vec3f, Vec3Array, 2> PatchArray;
 
+namespace
+{
+inline long long quantizeCoord(double v)
+{
+    return static_cast<long long>(floor(v * 1.0e9 + .5));
+}
+}
+
+bool PatchEdgeCache::Key::operator<(const Key& rhs) const
+{
+    if (revision != rhs.revision) return revision < rhs.revision;
+    if (lod != rhs.lod) return lod < rhs.lod;
+    if (horizontal != rhs.horizontal) return horizontal < rhs.horizontal;
+    if (fixedCoord != rhs.fixedCoord) return fixedCoord < rhs.fixedCoord;
+    return startCoord < rhs.startCoord;
+}
+
+PatchEdgeCache::PatchEdgeCache(unsigned maxEdges)
+    : _maxEdges(maxEdges), _hits(0), _misses(0)
+{
+    MetricsRegistry* metrics = Registry::instance()->getMetrics();
+    _hitsMetric = metrics->getCounter("seamless.edge_cache.hits");
+    _missesMetric = metrics->getCounter("seamless.edge_cache.misses");
+}
+
+PatchEdgeCache::Key PatchEdgeCache::makeKey(const TileKey& key, Edge edge,
+                                            int revision)
+{
+    const GeoExtent& extent = key.getExtent();
+    Key result;
+    result.revision = revision;
+    result.lod = key.getLevelOfDetail();
+    result.horizontal = edge == EDGE_SOUTH || edge == EDGE_NORTH;
+    switch (edge)
+    {
+    case EDGE_SOUTH:
+        result.fixedCoord = quantizeCoord(extent.yMin());
+        result.startCoord = quantizeCoord(extent.xMin());
+        break;
+    case EDGE_NORTH:
+        result.fixedCoord = quantizeCoord(extent.yMax());
+        result.startCoord = quantizeCoord(extent.xMin());
+        break;
+    case EDGE_WEST:
+        result.fixedCoord = quantizeCoord(extent.xMin());
+        result.startCoord = quantizeCoord(extent.yMin());
+        break;
+    default:
+        result.fixedCoord = quantizeCoord(extent.xMax());
+        result.startCoord = quantizeCoord(extent.yMin());
+        break;
+    }
+    return result;
+}
+
+bool PatchEdgeCache::get(const Key& key, std::vector<Vec3d>& out_coords)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    EdgeMap::const_iterator itr = _edges.find(key);
+    if (itr == _edges.end())
+    {
+        ++_misses;
+        _missesMetric->add();
+        return false;
+    }
+    ++_hits;
+    _hitsMetric->add();
+    out_coords = itr->second;
+    return true;
+}
+
+void PatchEdgeCache::put(const Key& key, const std::vector<Vec3d>& coords)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    if (!_edges.insert(EdgeMap::value_type(key, coords)).second)
+        return;
+    _order.push_back(key);
+    while (_order.size() > _maxEdges)
+    {
+        _edges.erase(_order.front());
+        _order.pop_front();
+    }
+}
+
 Geographic::Geographic(const Map* map,
                        const osgEarth::Drivers::SeamlessOptions& options)
     : PatchSet(options, new PatchOptions), _profile(new EulerProfile),
@@ -56,13 +142,18 @@ Geographic::Geographic(const Map* map,
     int serviceThreads = computeLoadingThreads(_options.loadingPolicy().get());
     _hfService = new TaskService("Height Field Service", serviceThreads);
     _imageService = new TaskService("Image Service", serviceThreads);
+    if (options.edgeCache() == true)
+        _edgeCache = new PatchEdgeCache;
+    _expandMetric = Registry::instance()->getMetrics()
+        ->getHistogram("seamless.patch.expand");
 }
 
 Geographic::Geographic(const Geographic& rhs, const osg::CopyOp& copyop)
     : PatchSet(rhs, copyop),
       _profile(static_cast<EulerProfile*>(copyop(rhs._profile.get()))),
       _eModel(static_cast<EllipsoidModel*>(copyop(rhs._eModel.get()))),
-      _hfService(rhs._hfService), _imageService(rhs._imageService)
+      _hfService(rhs._hfService), _imageService(rhs._imageService),
+      _edgeCache(rhs._edgeCache), _expandMetric(rhs._expandMetric)
 {
 }
 
@@ -163,10 +254,13 @@ mergeImages(const GeoExtent& targetExtent, const GeoImageVector& imgs)
 }
 
 // Create vertex arrays from the height field for a patch and install
-// them in the patch.
+// them in the patch. If an edge cache is supplied, border samples
+// already computed by a neighboring patch are reused, and this patch's
+// borders are published for its neighbors.
 void expandHeights(Geographic* gpatchset, const TileKey& key,
                    const GeoHeightField& hf, Vec3Array* verts,
-                   Vec3Array* normals)
+                   Vec3Array* normals, PatchEdgeCache* edgeCache = 0,
+                   int revision = 0)
 {
     int resolution = gpatchset->getResolution();
     const GeoExtent& patchExtent = key.getExtent();
@@ -183,36 +277,106 @@ void expandHeights(Geographic* gpatchset, const TileKey& key,
     const EllipsoidModel* eModel = gpatchset->getEllipsoidModel();
     const float verticalScale = gpatchset->getVerticalScale();
     PatchArray mverts(*verts, patchDim);
+    // Border rows and columns, indexed by PatchEdgeCache::Edge
+    PatchEdgeCache::Key edgeKeys[4];
+    vector<Vec3d> edgeCoords[4];
+    bool edgeCached[4] = { false, false, false, false };
+    bool edgeComplete[4] = { true, true, true, true };
+    if (edgeCache)
+    {
+        for (int e = 0; e < 4; ++e)
+        {
+            PatchEdgeCache::Edge edge = static_cast<PatchEdgeCache::Edge>(e);
+            edgeKeys[e] = PatchEdgeCache::makeKey(key, edge, revision);
+            edgeCached[e] = edgeCache->get(edgeKeys[e], edgeCoords[e])
+                && static_cast<int>(edgeCoords[e].size()) == patchDim;
+            if (!edgeCached[e])
+                edgeCoords[e].assign(patchDim, Vec3d());
+        }
+    }
     for (int j = 0; j < patchDim; ++j)
     {
         for (int i = 0; i < patchDim; i++)
         {
-            Vec2d cubeCoord(patchExtent.xMin() + i * xInc,
-                            patchExtent.yMin() + j * yInc);
-            double lon, lat;
-            srs->transform(cubeCoord.x(), cubeCoord.y(), geoSrs, lon, lat);
-            float elevation;
-
-            bool found = hf.getElevation(srs, cubeCoord.x(), cubeCoord.y(),
-                                         INTERP_BILINEAR, 0, elevation);
-            // Into ec coordinates
-            if (!found)
+            // Which borders is this sample on?
+            int onEdge[4], edgeIndex[4];
+            int numEdges = 0;
+            if (edgeCache)
             {
-                OE_WARN << "Couldn't find height sample for cube coordinates "
-                        << cubeCoord.x() << ", " << cubeCoord.y()
-                        << " (lon lat " << lon << ", " << lat << ")\n";
-                continue;
+                if (j == 0)
+                {
+                    onEdge[numEdges] = PatchEdgeCache::EDGE_SOUTH;
+                    edgeIndex[numEdges++] = i;
+                }
+                if (j == patchDim - 1)
+                {
+                    onEdge[numEdges] = PatchEdgeCache::EDGE_NORTH;
+                    edgeIndex[numEdges++] = i;
+                }
+                if (i == 0)
+                {
+                    onEdge[numEdges] = PatchEdgeCache::EDGE_WEST;
+                    edgeIndex[numEdges++] = j;
+                }
+                if (i == patchDim - 1)
+                {
+                    onEdge[numEdges] = PatchEdgeCache::EDGE_EAST;
+                    edgeIndex[numEdges++] = j;
+                }
             }
-            elevation *= verticalScale;
             Vec3d coord;
-            eModel->convertLatLongHeightToXYZ(
-                DegreesToRadians(lat), DegreesToRadians(lon), elevation,
-                coord.x(), coord.y(), coord.z());
+            bool haveCoord = false;
+            for (int k = 0; k < numEdges && !haveCoord; ++k)
+            {
+                if (edgeCached[onEdge[k]])
+                {
+                    coord = edgeCoords[onEdge[k]][edgeIndex[k]];
+                    haveCoord = true;
+                }
+            }
+            if (!haveCoord)
+            {
+                Vec2d cubeCoord(patchExtent.xMin() + i * xInc,
+                                patchExtent.yMin() + j * yInc);
+                double lon, lat;
+                srs->transform(cubeCoord.x(), cubeCoord.y(), geoSrs, lon, lat);
+                float elevation;
+
+                bool found = hf.getElevation(srs, cubeCoord.x(), cubeCoord.y(),
+                                             INTERP_BILINEAR, 0, elevation);
+                // Into ec coordinates
+                if (!found)
+                {
+                    OE_WARN << "Couldn't find height sample for cube coordinates "
+                            << cubeCoord.x() << ", " << cubeCoord.y()
+                            << " (lon lat " << lon << ", " << lat << ")\n";
+                    for (int k = 0; k < numEdges; ++k)
+                        edgeComplete[onEdge[k]] = false;
+                    continue;
+                }
+                elevation *= verticalScale;
+                eModel->convertLatLongHeightToXYZ(
+                    DegreesToRadians(lat), DegreesToRadians(lon), elevation,
+                    coord.x(), coord.y(), coord.z());
+            }
+            for (int k = 0; k < numEdges; ++k)
+            {
+                if (!edgeCached[onEdge[k]])
+                    edgeCoords[onEdge[k]][edgeIndex[k]] = coord;
+            }
             mverts[j][i] = coord - patchCenter;
             if (fabs(mverts[j][i].z()) > 6000000)
                 OE_WARN << "found huge coordinate.\n";
         }
     }
+    if (edgeCache)
+    {
+        for (int e = 0; e < 4; ++e)
+        {
+            if (!edgeCached[e] && edgeComplete[e])
+                edgeCache->put(edgeKeys[e], edgeCoords[e]);
+        }
+    }
     // Normals. Average the normals of the triangles around the sample
     // point. We're not following the actual tessallation of the grid.
     for (int j = 0; j < patchDim; ++j)
@@ -360,12 +524,14 @@ struct HeightFieldRequest : public TaskRequest
         {
             hf = getGeoHeightField(_mapf, _key, resolution);
         }
+        ScopedMetricTimer timer(_gpatchset->getExpandMetric());
         int patchDim = resolution + 1;
         Vec3Array* verts = new Vec3Array(patchDim * patchDim);
         _result = verts;
         _normalResult = new Vec3Array(patchDim * patchDim);
         expandHeights(_gpatchset.get(), _key, hf,
-                      verts, _normalResult.get());
+                      verts, _normalResult.get(),
+                      _gpatchset->getEdgeCache(), _mapf.getRevision());
     }
     ref_ptr<Geographic> _gpatchset;
     TileKey _key;
@@ -20,6 +20,7 @@
 #include "GeometryUtils"
 #include <osgEarthFeatures/Feature>
 #include <osgEarth/Registry>
+#include <OpenThreads/ScopedLock>
 #include <algorithm>
 
 #define OGR_SCOPED_LOCK GDAL_SCOPED_LOCK
@@ -27,13 +28,62 @@
 using namespace osgEarth;
 using namespace osgEarth::Features;
 
+//------------------------------------------------------------------------
+
+OGRDataSourcePool::OGRDataSourcePool()
+{
+    //nop
+}
+
+OGRDataSourcePool::~OGRDataSourcePool()
+{
+    // the handles came from OGROpen, not OGROpenShared, so destroy rather than release them.
+    OGR_SCOPED_LOCK;
+    for( std::vector<OGRDataSourceH>::iterator i = _idle.begin(); i != _idle.end(); ++i )
+        OGR_DS_Destroy( *i );
+}
+
+OGRDataSourceH
+OGRDataSourcePool::acquire()
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+        if ( !_idle.empty() )
+        {
+            OGRDataSourceH handle = _idle.back();
+            _idle.pop_back();
+            return handle;
+        }
+    }
+
+    // open a private (non-shared) handle, so that no other cursor can be handed
+    // the same one by OGR.
+    OGR_SCOPED_LOCK;
+    OGRSFDriverH driver = 0L;
+    return OGROpen( _url.c_str(), 0, &driver );
+}
+
+void
+OGRDataSourcePool::release( OGRDataSourceH handle )
+{
+    if ( handle )
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+        _idle.push_back( handle );
+    }
+}
+
+//------------------------------------------------------------------------
+
 
 FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH dsHandle,
+                                   OGRDataSourcePool* dsPool,
                                    OGRLayerH layerHandle,
                                    const FeatureProfile* profile,
                                    const Symbology::Query& query,
                                    const FeatureFilterList& filters ) :
 _dsHandle( dsHandle ),
+_dsPool( dsPool ),
 _layerHandle( layerHandle ),
 _resultSetHandle( 0L ),
 _spatialFilter( 0L ),
@@ -98,6 +148,17 @@ _filters( filters )
         if ( _resultSetHandle )
         {
             OGR_L_ResetReading( _resultSetHandle );
+
+            // cache the attribute names once, rather than lower-casing them for every feature.
+            OGRFeatureDefnH defn = OGR_L_GetLayerDefn( _resultSetHandle );
+            int numFields = OGR_FD_GetFieldCount( defn );
+            _fieldNames.reserve( numFields );
+            for( int i = 0; i < numFields; ++i )
+            {
+                std::string name = OGR_Fld_GetNameRef( OGR_FD_GetFieldDefn(defn, i) );
+                std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+                _fieldNames.push_back( name );
+            }
         }
     }
 
@@ -111,14 +172,19 @@ FeatureCursorOGR::~FeatureCursorOGR()
     if ( _nextHandleToQueue )
         OGR_F_Destroy( _nextHandleToQueue );
 
-    if ( _resultSetHandle != _layerHandle )
+    if ( _resultSetHandle && _resultSetHandle != _layerHandle )
         OGR_DS_ReleaseResultSet( _dsHandle, _resultSetHandle );
 
     if ( _spatialFilter )
         OGR_G_DestroyGeometry( _spatialFilter );
 
     if ( _dsHandle )
-        OGRReleaseDataSource( _dsHandle );
+    {
+        if ( _dsPool.valid() )
+            _dsPool->release( _dsHandle );
+        else
+            OGR_DS_Destroy( _dsHandle );
+    }
 }
 
 bool
@@ -146,8 +212,9 @@ FeatureCursorOGR::nextFeature()
 }
 
 
-// reads a chunk of features into a memory cache; do this for performance
-// and to avoid needing the OGR Mutex every time
+// reads a chunk of features into a memory cache; do this for performance.
+// The data source handle belongs to this cursor alone (see OGRDataSourcePool),
+// so reading from it does not require the OGR mutex.
 void
 FeatureCursorOGR::readChunk()
 {
@@ -155,8 +222,6 @@ FeatureCursorOGR::readChunk()
         return;
     
     FeatureList preProcessList;
-    
-    OGR_SCOPED_LOCK;
 
     if ( _nextHandleToQueue )
     {
@@ -212,7 +277,6 @@ FeatureCursorOGR::readChunk()
     //OE_NOTICE << "read " << _queue.size() << " features ... " << std::endl;
 }
 
-// NOTE: ASSUMES that OGR_SCOPED_LOCK is already in effect upon entry!
 Feature*
 FeatureCursorOGR::createFeature( OGRFeatureH handle )
 {
@@ -227,17 +291,14 @@ FeatureCursorOGR::createFeature( OGRFeatureH handle )
         feature->setGeometry( geom );
 	}
 
-    int numAttrs = OGR_F_GetFieldCount(handle); 
+    int numAttrs = osg::minimum( OGR_F_GetFieldCount(handle), (int)_fieldNames.size() );
     for (int i = 0; i < numAttrs; ++i) 
     { 
-        void* field_handle_ref = OGR_F_GetFieldDefnRef( handle, i ); 
-        const char* field_name = OGR_Fld_GetNameRef( field_handle_ref ); 
-        const char* field_value= OGR_F_GetFieldAsString(handle, i); 
-        std::string name = std::string( field_name ); 
-        std::string value = std::string( field_value); 
-        //Make the name lower case 
-        std::transform( name.begin(), name.end(), name.begin(), ::tolower ); 
-        feature->setAttr(name, value); 
+        // unset fields read back as empty strings anyway; skip the conversion.
+        if ( !OGR_F_IsFieldSet(handle, i) )
+            continue;
+
+        feature->setAttr( _fieldNames[i], OGR_F_GetFieldAsString(handle, i) );
     } 
 
     return feature;
@@ -30,6 +30,9 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <list>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <ogr_api.h>
 
 #define LC "[OGR FeatureSource] "
@@ -52,6 +55,7 @@ public:
       _dsHandle( 0L ),
       _layerHandle( 0L ),
       _ogrDriverHandle( 0L ),
+      _dsPool( new OGRDataSourcePool() ),
       _options( options )
     {
         _geometry = 
@@ -85,6 +89,7 @@ public:
         if ( _options.url().isSet() )
         {
             _absUrl = osgEarth::getFullPath( referenceURI, _options.url().value() );
+            _dsPool->setURL( _absUrl );
         }
     }
 
@@ -197,18 +202,16 @@ public:
         }
         else
         {
-            OGR_SCOPED_LOCK;
-
             // Each cursor requires its own DS handle so that multi-threaded access will work.
-            // The cursor impl will dispose of the new DS handle.
-
-	        OGRDataSourceH dsHandle = OGROpenShared( _absUrl.c_str(), 0, &_ogrDriverHandle );
+            // The cursor returns the handle to the pool when it's done with it.
+	        OGRDataSourceH dsHandle = _dsPool->acquire();
 	        if ( dsHandle )
 	        {
                 OGRLayerH layerHandle = OGR_DS_GetLayer( dsHandle, 0 );
 
                 return new FeatureCursorOGR( 
                     dsHandle,
+                    _dsPool.get(),
                     layerHandle, 
                     getFeatureProfile(),
                     query, 
@@ -249,6 +252,38 @@ protected:
         return GeometryUtils::createGeometryFromWKT( geomConf.value() );
     }
 
+    //override
+    std::string getDataFingerprint() const
+    {
+        // inline geometry is part of the options, which the caller hashes already.
+        if ( _options.geometryConfig().isSet() && !_options.geometry().valid() )
+            return "inline";
+
+        if ( _geometry.valid() || _absUrl.empty() || osgDB::containsServerAddress(_absUrl) )
+            return "";
+
+        // the size and modification time of the file, plus those of a shapefile's
+        // attribute and index files. A connection string (no such file) can't be
+        // fingerprinted.
+        std::stringstream buf;
+        if ( !appendFileStamp(_absUrl, buf) )
+            return "";
+
+        std::string base = osgDB::getNameLessExtension( _absUrl );
+        appendFileStamp( base + ".dbf", buf );
+        appendFileStamp( base + ".shx", buf );
+        return buf.str();
+    }
+
+    static bool appendFileStamp( const std::string& path, std::ostream& out )
+    {
+        struct stat info;
+        if ( ::stat(path.c_str(), &info) != 0 )
+            return false;
+        out << (unsigned long long)info.st_size << ":" << (unsigned long long)info.st_mtime << ";";
+        return true;
+    }
+
     // read the WKT geometry from a URL, then parse into a Geometry.
     Symbology::Geometry* parseGeometryUrl( const std::string& geomUrl )
     {
@@ -266,6 +301,7 @@ private:
     OGRDataSourceH _dsHandle;
     OGRLayerH _layerHandle;
     OGRSFDriverH _ogrDriverHandle;
+    osg::ref_ptr<OGRDataSourcePool> _dsPool;
     osg::ref_ptr<Symbology::Geometry> _geometry; // explicit geometry.
     const OGRFeatureOptions _options;
 };
@@ -946,6 +946,45 @@ public:
         return 0;
     }
 
+    /**
+    * Reads a window of a band into a byte buffer, like a single RasterIO call, but
+    * in strips of rows so that a canceled request can bail out part way through.
+    * Each strip covers a whole number of source rows, so the sampling is identical
+    * to reading the window in one go. Returns false if the request was canceled.
+    */
+    static bool readBand(GDALRasterBand* band, int off_x, int off_y, int width, int height,
+                         unsigned char* buffer, int target_width, int target_height,
+                         ProgressCallback* progress)
+    {
+        if ( progress && progress->isCanceled() )
+            return false;
+
+        // smallest run of target rows that maps onto a whole number of source rows:
+        int a = height, b = target_height;
+        while( b != 0 ) { int t = a % b; a = b; b = t; }
+        int targetStep = target_height / a;
+        int sourceStep = height / a;
+
+        int rowsPerStrip = targetStep * osg::maximum( 1, 32 / targetStep );
+        if ( !progress || rowsPerStrip >= target_height )
+        {
+            band->RasterIO(GF_Read, off_x, off_y, width, height, buffer, target_width, target_height, GDT_Byte, 0, 0);
+            return true;
+        }
+
+        for( int row = 0; row < target_height; row += rowsPerStrip )
+        {
+            int rows = osg::minimum( rowsPerStrip, target_height - row );
+            band->RasterIO(GF_Read,
+                off_x, off_y + (row / targetStep) * sourceStep, width, (rows / targetStep) * sourceStep,
+                buffer + row * target_width, target_width, rows, GDT_Byte, 0, 0);
+
+            if ( progress->isCanceled() )
+                return false;
+        }
+        return true;
+    }
+
     void pixelToGeo(double x, double y, double &geoX, double &geoY)
     {
         geoX = _geotransform[0] + _geotransform[1] * x + _geotransform[2] * y;
@@ -1050,13 +1089,19 @@ public:
                 memset(alpha, 255, target_width * target_height);
 
 
-                bandRed->RasterIO(GF_Read, off_x, off_y, width, height, red, target_width, target_height, GDT_Byte, 0, 0);
-                bandGreen->RasterIO(GF_Read, off_x, off_y, width, height, green, target_width, target_height, GDT_Byte, 0, 0);
-                bandBlue->RasterIO(GF_Read, off_x, off_y, width, height, blue, target_width, target_height, GDT_Byte, 0, 0);
+                bool ok =
+                    readBand(bandRed, off_x, off_y, width, height, red, target_width, target_height, progress) &&
+                    readBand(bandGreen, off_x, off_y, width, height, green, target_width, target_height, progress) &&
+                    readBand(bandBlue, off_x, off_y, width, height, blue, target_width, target_height, progress) &&
+                    (!bandAlpha || readBand(bandAlpha, off_x, off_y, width, height, alpha, target_width, target_height, progress));
 
-                if (bandAlpha)
+                if (!ok)
                 {
-                    bandAlpha->RasterIO(GF_Read, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte, 0, 0);
+                    delete []red;
+                    delete []green;
+                    delete []blue;
+                    delete []alpha;
+                    return NULL;
                 }
 
                 image = new osg::Image;
@@ -1093,11 +1138,15 @@ public:
                 //Initialize the alpha values to 255.
                 memset(alpha, 255, target_width * target_height);
 
-                bandGray->RasterIO(GF_Read, off_x, off_y, width, height, gray, target_width, target_height, GDT_Byte, 0, 0);
+                bool ok =
+                    readBand(bandGray, off_x, off_y, width, height, gray, target_width, target_height, progress) &&
+                    (!bandAlpha || readBand(bandAlpha, off_x, off_y, width, height, alpha, target_width, target_height, progress));
 
-                if (bandAlpha)
+                if (!ok)
                 {
-                    bandAlpha->RasterIO(GF_Read, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte, 0, 0);
+                    delete []gray;
+                    delete []alpha;
+                    return NULL;
                 }
 
                 image = new osg::Image;
@@ -1129,7 +1178,11 @@ public:
 			{
 				unsigned char *palette = new unsigned char[target_width * target_height];
 
-				bandPalette->RasterIO(GF_Read, off_x, off_y, width, height, palette, target_width, target_height, GDT_Byte, 0, 0);
+				if (!readBand(bandPalette, off_x, off_y, width, height, palette, target_width, target_height, progress))
+				{
+					delete []palette;
+					return NULL;
+				}
 
 				image = new osg::Image;
 				image->allocateImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
@@ -1439,6 +1492,9 @@ public:
 
             for (int c = 0; c < tileSize; ++c)
             {
+                if ( progress && progress->isCanceled() )
+                    return NULL;
+
                 double geoX = xmin + (dx * (double)c);
                 for (int r = 0; r < tileSize; ++r)
                 {
@@ -60,6 +60,9 @@ GeomCompiler::compile(FeatureCursor*        cursor,
     FeatureList workingSet;
     cursor->fill( workingSet );
 
+    // each stage below checks for cancelation so an abandoned tile frees up
+    // its worker thread as soon as possible.
+
     // create a filter context that will track feature data through the process
     FilterContext cx = context;
     if ( !cx.extent().isSet() )
@@ -86,6 +89,8 @@ GeomCompiler::compile(FeatureCursor*        cursor,
     if ( altitude && altitude->verticalOffset().isSet() )
         xform.setMatrix( osg::Matrixd::translate(0, 0, *altitude->verticalOffset()) );
     cx = xform.push( workingSet, cx );
+    if ( cx.isCanceled() )
+        return 0L;
 
     bool clampRequired =
         altitude && altitude->clamping() != AltitudeSymbol::CLAMP_NONE;
@@ -101,6 +106,8 @@ GeomCompiler::compile(FeatureCursor*        cursor,
             scatter.setRandom( marker->placement() == MarkerSymbol::PLACEMENT_RANDOM );
             scatter.setRandomSeed( *marker->randomSeed() );
             cx = scatter.push( workingSet, cx );
+            if ( cx.isCanceled() )
+                return 0L;
         }
 
         if ( clampRequired )
@@ -108,6 +115,8 @@ GeomCompiler::compile(FeatureCursor*        cursor,
             ClampFilter clamp;
             clamp.setIgnoreZ( altitude->clamping() == AltitudeSymbol::CLAMP_TO_TERRAIN );
             cx = clamp.push( workingSet, cx );
+            if ( cx.isCanceled() )
+                return 0L;
             clampRequired = false;
         }
 
@@ -117,6 +126,8 @@ GeomCompiler::compile(FeatureCursor*        cursor,
             sub.setModelMatrix( osg::Matrixd::scale( *marker->scale() ) );
 
         cx = sub.push( workingSet, cx );
+        if ( cx.isCanceled() )
+            return 0L;
 
         osg::Node* node = sub.getNode();
         if ( node )
@@ -131,6 +142,8 @@ GeomCompiler::compile(FeatureCursor*        cursor,
             ClampFilter clamp;
             clamp.setIgnoreZ( altitude->clamping() == AltitudeSymbol::CLAMP_TO_TERRAIN );
             cx = clamp.push( workingSet, cx );
+            if ( cx.isCanceled() )
+                return 0L;
             clampRequired = false;
         }
 
@@ -150,6 +163,8 @@ GeomCompiler::compile(FeatureCursor*        cursor,
         }
 
         osg::Node* node = extrude.push( workingSet, cx );
+        if ( cx.isCanceled() )
+            return 0L;
         if ( node )
             resultGroup->addChild( node );
     }
@@ -162,6 +177,8 @@ GeomCompiler::compile(FeatureCursor*        cursor,
             ClampFilter clamp;
             clamp.setIgnoreZ( altitude->clamping() == AltitudeSymbol::CLAMP_TO_TERRAIN );
             cx = clamp.push( workingSet, cx );
+            if ( cx.isCanceled() )
+                return 0L;
             clampRequired = false;
         }
 
@@ -171,6 +188,8 @@ GeomCompiler::compile(FeatureCursor*        cursor,
         if ( _options.mergeGeometry().isSet() )
             filter.mergeGeometry() = *_options.mergeGeometry();
         cx = filter.push( workingSet, cx );
+        if ( cx.isCanceled() )
+            return 0L;
 
         osg::Node* node = filter.getNode();
         if ( node )
@@ -184,11 +203,15 @@ GeomCompiler::compile(FeatureCursor*        cursor,
             ClampFilter clamp;
             clamp.setIgnoreZ( altitude->clamping() == AltitudeSymbol::CLAMP_TO_TERRAIN );
             cx = clamp.push( workingSet, cx );
+            if ( cx.isCanceled() )
+                return 0L;
             clampRequired = false;
         }
 
         BuildTextFilter filter( style );
         cx = filter.push( workingSet, cx );
+        if ( cx.isCanceled() )
+            return 0L;
 
         osg::Node* node = filter.takeNode();
         if ( node )
@@ -27,6 +27,7 @@
 #include <osgEarthFeatures/ConvertTypeFilter>
 #include <osgEarthFeatures/FeatureGridder>
 #include <osgEarthSymbology/StencilVolumeNode>
+#include <osgEarthSymbology/PolygonTriangulator>
 #include <osgEarthSymbology/Style>
 #include <osgEarthSymbology/StencilVolumeNode>
 #include <osg/Notify>
@@ -34,7 +35,6 @@
 #include <osg/ClusterCullingCallback>
 #include <osg/Geode>
 #include <osg/Projection>
-#include <osgUtil/Tessellator>
 #include <osg/MatrixTransform>
 #include <osgDB/FileNameUtils>
 #include <OpenThreads/Mutex>
@@ -95,11 +95,7 @@ namespace
 
     void tessellate( osg::Geometry* geom )
     {
-        osgUtil::Tessellator tess;
-        tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
-        tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
-    //    tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_POSITIVE );
-        tess.retessellatePolygons( *geom );
+        PolygonTriangulator::run( *geom );
     }
 
     osg::Geode*
@@ -474,6 +470,12 @@ namespace
             return volumes != 0L;
         }
 
+        //override - style groups are shared StencilVolumeNodes, which do not serialize.
+        bool supportsPersistentCaching() const
+        {
+            return false;
+        }
+
         //override
         osg::Group* getOrCreateStyleGroup( const Style& style, Session* session )
         {
@@ -28,7 +28,7 @@
 #include <osg/GLExtensions>
 #include <osg/Geode>
 #include <osg/Notify>
-#include <osgUtil/Tessellator>
+#include <osgEarthSymbology/PolygonTriangulator>
 #include <algorithm>
 
 #define ON_AND_PROTECTED  osg::StateAttribute::ON | osg::StateAttribute::PROTECTED
@@ -485,11 +485,7 @@ StencilVolumeNode::init()
 static
 void tessellate( osg::Geometry* geom )
 {
-    osgUtil::Tessellator tess;
-    tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
-    tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
-//    tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_POSITIVE );
-    tess.retessellatePolygons( *geom );
+    osgEarth::Symbology::PolygonTriangulator::run( *geom );
 }
 
 osg::Geode*
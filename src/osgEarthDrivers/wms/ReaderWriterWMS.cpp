@@ -21,6 +21,9 @@
 #include <osgEarth/ImageToHeightFieldConverter>
 #include <osgEarth/Registry>
 #include <osgEarth/XmlUtils>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/StringUtils>
 #include <osgEarthUtil/WMS>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -28,6 +31,9 @@
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
 #include <osg/ImageSequence>
+#include <osg/ImageStream>
+#include <osg/FrameStamp>
+#include <osg/NodeVisitor>
 #include <sstream>
 #include <stdlib.h>
 #include <string.h>
@@ -53,6 +59,125 @@ public:
     }
 };
 
+// A single time step of a WMS-T sequence, held in the encoded form in which
+// the server delivered it (PNG, GIF, etc.) along with the reader that can decode it.
+struct EncodedFrame
+{
+    std::string                        _data;
+    osg::ref_ptr<osgDB::ReaderWriter> _reader;
+    osg::ref_ptr<const osg::Image>     _image;  // already decoded, when it came from the cache uncompressed
+
+    bool valid() const { return _image.valid() || (_reader.valid() && !_data.empty()); }
+
+    /** Holds a decoded frame, re-encoding it as PNG if the frames are kept compressed. */
+    void setImage( const osg::Image* image, bool compress )
+    {
+        if ( compress )
+        {
+            osgDB::ReaderWriter* png = osgDB::Registry::instance()->getReaderWriterForExtension( "png" );
+            std::ostringstream buf;
+            if ( png && png->writeImage( *image, buf ).success() )
+            {
+                _reader = png;
+                _data   = buf.str();
+                return;
+            }
+        }
+        _image = image;
+    }
+
+    osg::Image* decode() const
+    {
+        if ( _image.valid() )
+        {
+            osg::Image* image = new osg::Image( *_image.get(), osg::CopyOp::DEEP_COPY_ALL );
+            ImageUtils::normalizeImage( image );
+            return image;
+        }
+
+        if ( !valid() ) return 0L;
+        std::istringstream buf( _data );
+        osgDB::ReaderWriter::ReadResult r = _reader->readImage( buf, 0L );
+        if ( r.error() || !r.getImage() ) return 0L;
+        osg::Image* image = r.takeImage();
+        ImageUtils::normalizeImage( image );
+        return image;
+    }
+};
+typedef std::vector<EncodedFrame> EncodedFrameVector;
+
+// An animated image that keeps each frame of a time series compressed in memory
+// and decodes only the frame currently on display. Like the SyncImageSequence,
+// all instances share a zero reference time so that looping tiles stay in sync.
+class EncodedFrameSequence : public osg::ImageStream
+{
+public:
+    EncodedFrameSequence() : _secondsPerFrame( 1.0 ), _currentFrame( -1 ) { }
+
+    EncodedFrameSequence( const EncodedFrameSequence& rhs, const osg::CopyOp& op =osg::CopyOp::SHALLOW_COPY ) :
+        osg::ImageStream( rhs, op ),
+        _frames( rhs._frames ),
+        _secondsPerFrame( rhs._secondsPerFrame ),
+        _currentFrame( rhs._currentFrame ) { }
+
+    META_Object( osgEarth, EncodedFrameSequence );
+
+    void setSecondsPerFrame( double value ) { _secondsPerFrame = value > 0.0 ? value : 1.0; }
+
+    void addFrame( const EncodedFrame& frame ) { _frames.push_back( frame ); }
+
+    unsigned getNumFrames() const { return _frames.size(); }
+
+    /** Decodes the specified frame into this image's buffer. */
+    bool setFrame( int index )
+    {
+        if ( index < 0 || index >= (int)_frames.size() )
+            return false;
+
+        osg::ref_ptr<osg::Image> frame = _frames[index].decode();
+        if ( !frame.valid() )
+            return false;
+
+        // take ownership of the decoded buffer rather than copying it:
+        osg::Image::AllocationMode mode = frame->getAllocationMode();
+        frame->setAllocationMode( osg::Image::NO_DELETE );
+        setImage(
+            frame->s(), frame->t(), frame->r(),
+            frame->getInternalTextureFormat(),
+            frame->getPixelFormat(),
+            frame->getDataType(),
+            frame->data(),
+            mode,
+            frame->getPacking() );
+
+        _currentFrame = index;
+        return true;
+    }
+
+    virtual bool requiresUpdateCall() const { return true; }
+
+    virtual void update( osg::NodeVisitor* nv )
+    {
+        if ( _frames.empty() || !nv || !nv->getFrameStamp() || getStatus() != PLAYING )
+            return;
+
+        double t = nv->getFrameStamp()->getSimulationTime();
+        int index = (int)( t / _secondsPerFrame ) % (int)_frames.size();
+        if ( index != _currentFrame )
+            setFrame( index );
+    }
+
+    virtual void play() { _status = PLAYING; }
+    virtual void pause() { _status = PAUSED; }
+
+protected:
+    virtual ~EncodedFrameSequence() { }
+
+    EncodedFrameVector _frames;
+    double             _secondsPerFrame;
+    int                _currentFrame;
+};
+
 
 class WMSSource : public TileSource
 {
@@ -242,6 +367,15 @@ public:
         // populate the data metadata:
         // TODO
 
+        // WMS-T: time steps are fetched concurrently, up to a limit on simultaneous
+        // requests to the host.
+        if ( _timesVec.size() > 1 )
+        {
+            _frameService = new TaskService(
+                "WMS-T " + _options.layers().value(),
+                osg::maximum( 1, _options.timeFetchThreads().value() ) );
+        }
+
 		setProfile( result.get() );
     }
 
@@ -252,6 +386,35 @@ public:
         return _timesVec.size() > 1;
     }
 
+    /* override */
+    bool supportsPersistentCaching() const
+    {
+        // The cache formats store a single image per tile, which would drop all but
+        // the first time step of a sequence. Instead each frame is cached under its
+        // own cache ID; see setPersistentCache.
+        return _timesVec.size() <= 1;
+    }
+
+    /* override */
+    void setPersistentCache( Cache* cache, const CacheSpec& spec )
+    {
+        // derive a cache ID per time step from the layer's. Time strings are hashed
+        // since they usually contain characters that aren't allowed in file names.
+        std::vector<CacheSpec> specs;
+        for( unsigned int r=0; r<_timesVec.size(); ++r )
+        {
+            std::stringstream buf;
+            buf << spec.cacheId() << "_t" << std::hex << osgEarth::hashString( _timesVec[r] );
+            specs.push_back( CacheSpec( buf.str(), spec.format(), spec.name() ) );
+            if ( cache && getProfile() )
+                cache->storeProperties( specs.back(), getProfile(), getPixelsPerTile() );
+        }
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _frameCacheMutex );
+        _frameCache      = cache;
+        _frameCacheSpecs = specs;
+    }
+
 public:
 
     // fetch a tile from the WMS service and report any exceptions.
@@ -341,26 +504,111 @@ public:
         return image.release();
     }
 
+    /** Fetches one encoded time step of a sequence; runs in the frame TaskService. */
+    struct FetchFrame
+    {
+        void execute()
+        {
+            if ( _progress.valid() && _progress->isCanceled() )
+                return;
+
+            if ( _cache.valid() )
+            {
+                osg::ref_ptr<const osg::Image> cached;
+                if ( _cache->getImage( _key, _cacheSpec, cached ) )
+                {
+                    _frame.setImage( cached.get(), _compress );
+                    return;
+                }
+            }
+
+            HTTPResponse response;
+            osgDB::ReaderWriter* reader = _source->fetchTileAndReader( _key, _extraAttrs, _progress.get(), response );
+            if ( reader )
+            {
+                _frame._reader = reader;
+                _frame._data   = response.getPartAsString( 0 );
+
+                if ( _cache.valid() )
+                {
+                    osg::ref_ptr<osg::Image> image = _frame.decode();
+                    if ( image.valid() )
+                        _cache->setImage( _key, _cacheSpec, image.get() );
+                }
+            }
+        }
+
+        WMSSource*                     _source;
+        TileKey                        _key;
+        std::string                    _extraAttrs;
+        osg::ref_ptr<ProgressCallback> _progress;
+        osg::ref_ptr<Cache>            _cache;
+        CacheSpec                      _cacheSpec;
+        bool                           _compress;
+        EncodedFrame                   _frame;
+    };
+
+    /** Fetches all the time steps for a key in parallel, preserving their order. */
+    void fetchFrames( const TileKey& key, ProgressCallback* progress, EncodedFrameVector& out_frames )
+    {
+        out_frames.clear();
+        out_frames.resize( _timesVec.size() );
+
+        osg::ref_ptr<Cache> cache;
+        std::vector<CacheSpec> cacheSpecs;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _frameCacheMutex );
+            cache      = _frameCache.get();
+            cacheSpecs = _frameCacheSpecs;
+        }
+
+        Threading::MultiEvent done( _timesVec.size() );
+        std::vector< osg::ref_ptr< ParallelTask<FetchFrame> > > tasks;
+        tasks.reserve( _timesVec.size() );
+
+        for( unsigned int r=0; r<_timesVec.size(); ++r )
+        {
+            ParallelTask<FetchFrame>* task = new ParallelTask<FetchFrame>( &done );
+            task->_source     = this;
+            task->_key        = key;
+            task->_extraAttrs = "TIME=" + _timesVec[r];
+            task->_progress   = progress;
+            task->_compress   = _options.compressFrames() == true;
+            if ( cache.valid() && r < cacheSpecs.size() )
+            {
+                task->_cache     = cache.get();
+                task->_cacheSpec = cacheSpecs[r];
+            }
+            tasks.push_back( task );
+            _frameService->add( task );
+        }
+
+        done.wait();
+
+        for( unsigned int r=0; r<tasks.size(); ++r )
+        {
+            out_frames[r] = tasks[r]->_frame;
+        }
+    }
+
     /** creates a 3D image from timestamped data. */
     osg::Image* createImage3D( const TileKey& key, ProgressCallback* progress )
     {
         osg::ref_ptr<osg::Image> image;
 
-        for( unsigned int r=0; r<_timesVec.size(); ++r )
+        EncodedFrameVector frames;
+        fetchFrames( key, progress, frames );
+
+        for( unsigned int r=0; r<frames.size(); ++r )
         {
-            std::string extraAttrs = "TIME=" + _timesVec[r];
-            HTTPResponse response;
-            osgDB::ReaderWriter* reader = fetchTileAndReader( key, extraAttrs, progress, response );
-            if ( reader )
+            if ( frames[r].valid() )
             {
-                osgDB::ReaderWriter::ReadResult readResult = reader->readImage( response.getPartStream( 0 ), 0L ); //getOptions() );
-                if ( readResult.error() ) {
+                osg::ref_ptr<osg::Image> timeImage = frames[r].decode();
+                if ( !timeImage.valid() ) {
                     OE_WARN << "WMS: image read failed for " << createURI(key) << std::endl;
                 }
                 else
                 {
-                    osg::ref_ptr<osg::Image> timeImage = readResult.getImage();
-
                     if ( !image.valid() )
                     {
                         image = new osg::Image();
@@ -382,52 +630,50 @@ public:
 
         return image.release();
     }
-    
-    ///** creates a 3D image from timestamped data. */
-    //osg::Image* createImageSequence( const TileKey& key, ProgressCallback* progress )
-    //{
-    //    osg::ImageSequence* seq = new osg::ImageSequence();
-
-    //    for( int r=0; r<_timesVec.size(); ++r )
-    //    {
-    //        std::string extraAttrs = "TIME=" + _timesVec[r];
-
-    //        std::string uri = createURI(key);
-    //        std::string delim = uri.find("?") == std::string::npos ? "?" : "&";
-    //        uri = uri + delim + extraAttrs;
-    //        uri = uri + "&." + _formatToUse;
-
-    //        seq->addImageFile( uri );
-    //    }
-
-    //    seq->play();
-    //    seq->setLength( (double)_timesVec.size() );
-    //    seq->setLoopingMode( osg::ImageStream::LOOPING );
-    //    
-    //    return seq;
-    //}
 
     /** creates a 3D image from timestamped data. */
     osg::Image* createImageSequence( const TileKey& key, ProgressCallback* progress )
     {
+        EncodedFrameVector frames;
+        fetchFrames( key, progress, frames );
+
+        if ( _options.compressFrames() == true )
+        {
+            osg::ref_ptr<EncodedFrameSequence> seq = new EncodedFrameSequence();
+            seq->setSecondsPerFrame( _options.secondsPerFrame().value() );
+            seq->setLoopingMode( osg::ImageStream::LOOPING );
+
+            for( unsigned int r=0; r<frames.size(); ++r )
+            {
+                if ( frames[r].valid() )
+                    seq->addFrame( frames[r] );
+            }
+
+            // decode the first frame up front so the image has a valid size and format.
+            if ( seq->getNumFrames() == 0 || !seq->setFrame( 0 ) )
+            {
+                OE_WARN << "WMS: image read failed for " << createURI(key) << std::endl;
+                return 0L;
+            }
+
+            seq->play();
+            return seq.release();
+        }
+
         osg::ImageSequence* seq = new SyncImageSequence(); //osg::ImageSequence();
 
         seq->setLoopingMode( osg::ImageStream::LOOPING );
         seq->setLength( _options.secondsPerFrame().value() * (double)_timesVec.size() );
         seq->play();
 
-        for( unsigned int r=0; r<_timesVec.size(); ++r )
+        for( unsigned int r=0; r<frames.size(); ++r )
         {
-            std::string extraAttrs = "TIME=" + _timesVec[r];
-
-            HTTPResponse response;
-            osgDB::ReaderWriter* reader = fetchTileAndReader( key, extraAttrs, progress, response );
-            if ( reader )
+            if ( frames[r].valid() )
             {
-                osgDB::ReaderWriter::ReadResult readResult = reader->readImage( response.getPartStream( 0 ), 0L ); //getOptions() );
-                if ( !readResult.error() )
+                osg::ref_ptr<osg::Image> image = frames[r].decode();
+                if ( image.valid() )
                 {
-                    seq->addImage( readResult.getImage() );
+                    seq->addImage( image.get() );
                 }
                 else
                 {
@@ -498,6 +744,10 @@ private:
     osg::ref_ptr<const Profile> _profile;
     std::string _prototype;
     std::vector<std::string> _timesVec;
+    osg::ref_ptr<TaskService> _frameService;
+    OpenThreads::Mutex _frameCacheMutex;
+    osg::ref_ptr<Cache> _frameCache;
+    std::vector<CacheSpec> _frameCacheSpecs;
 };
 
 
@@ -22,7 +22,7 @@
 #include <osgEarthSymbology/LineSymbol>
 #include <osgEarthSymbology/PolygonSymbol>
 #include <osgEarthSymbology/MeshSubdivider>
-#include <osgEarthSymbology/MeshConsolidator>
+#include <osgEarthSymbology/PolygonTriangulator>
 #include <osg/Geode>
 #include <osg/Geometry>
 #include <osg/LineWidth>
@@ -32,7 +32,6 @@
 #include <osg/MatrixTransform>
 #include <osg/ClusterCullingCallback>
 #include <osgText/Text>
-#include <osgUtil/Tessellator>
 #include <osgUtil/Optimizer>
 #include <osgDB/WriteFile>
 #include <osg/Version>
@@ -256,23 +255,12 @@ BuildGeometryFilter::pushRegularFeature( Feature* input, const FilterContext& co
             osgGeom->addPrimitiveSet( new osg::DrawArrays( primMode, 0, part->size() ) );
         }
 
-        // tessellate all polygon geometries. Tessellating each geometry separately
-        // with TESS_TYPE_GEOMETRY is much faster than doing the whole bunch together
-        // using TESS_TYPE_DRAWABLE.
+        // tessellate all polygon geometries. The triangulator replaces the outer ring
+        // and holes with a single GL_TRIANGLES primitive over the existing vertices.
 
         if ( part->getType() == Geometry::TYPE_POLYGON && tessellatePolys )
         {
-            osgUtil::Tessellator tess;
-            //tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_DRAWABLE );
-            //tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
-            tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
-            tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_POSITIVE );
-
-            tess.retessellatePolygons( *osgGeom );
-
-            // the tessellator results in a collection of trifans, strips, etc. This step will
-            // consolidate those into one (or more if necessary) GL_TRIANGLES primitive.
-            MeshConsolidator::run( *osgGeom );
+            PolygonTriangulator::run( *osgGeom, PolygonTriangulator::WINDING_POSITIVE );
 
             // mark this geometry as DYNAMIC because otherwise the OSG optimizer will destroy it.
             //osgGeom->setDataVariance( osg::Object::DYNAMIC );
@@ -33,8 +33,10 @@
 #include <osg/PolygonOffset>
 #include <osg/ClusterCullingCallback>
 #include <osgText/Text>
-#include <osgUtil/IntersectionVisitor>
-#include <osgUtil/PolytopeIntersector>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <cmath>
 
 #define LC "[BuildTextOperator] "
 
@@ -52,6 +54,112 @@ namespace
             return nv && nv->getEyePoint() * _n <= 0;
         }
     };
+
+    // a label waiting for the declutter pass.
+    struct LabelCandidate
+    {
+        osg::ref_ptr<osgText::Text> _text;
+        std::string                 _name;
+        double                      _priority;
+        unsigned                    _order;
+        osg::BoundingBox            _bound;
+    };
+
+    // highest priority first; ties keep the input order.
+    struct SortByPriority
+    {
+        bool operator()( const LabelCandidate* lhs, const LabelCandidate* rhs ) const
+        {
+            return lhs->_priority > rhs->_priority ||
+                   (lhs->_priority == rhs->_priority && lhs->_order < rhs->_order);
+        }
+    };
+
+    /**
+     * Uniform grid over the XY extents of the labels accepted so far. Each accepted
+     * label is registered in every cell its box touches, so an overlap query only
+     * looks at the labels in the cells under the candidate instead of all of them.
+     * The rare box that would span a great many cells goes on a short list that
+     * every query checks instead.
+     */
+    class LabelGrid
+    {
+    public:
+        LabelGrid( double originX, double originY, double cellSize )
+            : _x0(originX), _y0(originY), _cellSize(cellSize) { }
+
+        bool overlaps( const osg::BoundingBox& box ) const
+        {
+            for( std::vector<unsigned>::const_iterator i = _large.begin(); i != _large.end(); ++i )
+            {
+                if ( intersects(box, _boxes[*i]) )
+                    return true;
+            }
+
+            int cx0, cy0, cx1, cy1;
+            getCells( box, cx0, cy0, cx1, cy1 );
+            for( int cy = cy0; cy <= cy1; ++cy )
+            {
+                for( int cx = cx0; cx <= cx1; ++cx )
+                {
+                    Cells::const_iterator c = _cells.find( Cell(cx, cy) );
+                    if ( c == _cells.end() )
+                        continue;
+
+                    for( std::vector<unsigned>::const_iterator i = c->second.begin(); i != c->second.end(); ++i )
+                    {
+                        if ( intersects(box, _boxes[*i]) )
+                            return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void insert( const osg::BoundingBox& box )
+        {
+            unsigned index = _boxes.size();
+            _boxes.push_back( box );
+
+            int cx0, cy0, cx1, cy1;
+            getCells( box, cx0, cy0, cx1, cy1 );
+            if ( (double)(cx1-cx0+1) * (double)(cy1-cy0+1) > MAX_CELLS_PER_BOX )
+            {
+                _large.push_back( index );
+                return;
+            }
+
+            for( int cy = cy0; cy <= cy1; ++cy )
+                for( int cx = cx0; cx <= cx1; ++cx )
+                    _cells[Cell(cx, cy)].push_back( index );
+        }
+
+    private:
+        typedef std::pair<int,int> Cell;
+        typedef std::map< Cell, std::vector<unsigned> > Cells;
+
+        enum { MAX_CELLS_PER_BOX = 256 };
+
+        static bool intersects( const osg::BoundingBox& a, const osg::BoundingBox& b )
+        {
+            return
+                a.xMin() <= b.xMax() && b.xMin() <= a.xMax() &&
+                a.yMin() <= b.yMax() && b.yMin() <= a.yMax();
+        }
+
+        void getCells( const osg::BoundingBox& box, int& cx0, int& cy0, int& cx1, int& cy1 ) const
+        {
+            cx0 = (int)::floor( (box.xMin() - _x0) / _cellSize );
+            cy0 = (int)::floor( (box.yMin() - _y0) / _cellSize );
+            cx1 = (int)::floor( (box.xMax() - _x0) / _cellSize );
+            cy1 = (int)::floor( (box.yMax() - _y0) / _cellSize );
+        }
+
+        double                        _x0, _y0, _cellSize;
+        Cells                         _cells;
+        std::vector<osg::BoundingBox> _boxes;
+        std::vector<unsigned>         _large;
+    };
 }
 
 using namespace osgEarth::Symbology;
@@ -107,6 +215,14 @@ osg::Node* BuildTextOperator::operator()(const FeatureList&   features,
 
     StringExpression contentExpr = *symbol->content();
 
+    bool usePriority = symbol->priority().isSet();
+    NumericExpression priorityExpr;
+    if ( usePriority )
+        priorityExpr = *symbol->priority();
+
+    std::vector<LabelCandidate> candidates;
+    candidates.reserve( features.size() );
+
     osg::Geode* result = new osg::Geode;
     for (FeatureList::const_iterator itr = features.begin(); itr != features.end(); ++itr)
     {
@@ -136,9 +252,6 @@ osg::Node* BuildTextOperator::operator()(const FeatureList&   features,
 
         if (text.empty()) continue;
 
-        //See if there is a duplicate name
-        if (removeDuplicateLabels && labelNames.find(text) != labelNames.end()) continue;
-
         bool rotateToScreen = symbol->rotateToScreen().isSet() ? symbol->rotateToScreen().value() : false;
 
         // find the centroid
@@ -247,24 +360,59 @@ osg::Node* BuildTextOperator::operator()(const FeatureList&   features,
             t->setCullCallback( new CullPlaneCallback( position * context.inverseReferenceFrame() ) );
         }
 
-        if (_hideClutter)
-		    {
-			      osg::BoundingBox tBound = t->getBound();
-			      osg::ref_ptr<osgUtil::PolytopeIntersector> intersector = new osgUtil::PolytopeIntersector(osgUtil::Intersector::MODEL, tBound.xMin(), tBound.yMin(), tBound.xMax(), tBound.yMax());
-			      osgUtil::IntersectionVisitor intersectVisitor(intersector.get());
-			      result->accept(intersectVisitor);
-
-			      if (!intersector->containsIntersections())
-			      {
-				        result->addDrawable( t );
-				        if (removeDuplicateLabels) labelNames.insert(text);
-			      }
-	      }
-	      else
-	      {
-		        result->addDrawable( t );
-		        if (removeDuplicateLabels) labelNames.insert(text);
-	      }
+        LabelCandidate candidate;
+        candidate._text     = t;
+        candidate._name     = text;
+        candidate._priority = usePriority ? feature->eval( priorityExpr ) : 0.0;
+        candidate._order    = candidates.size();
+        candidates.push_back( candidate );
+    }
+
+    // visit the labels in priority order. Duplicate names and (if we are hiding clutter)
+    // labels that overlap one already placed are dropped, so the higher-priority label wins.
+    std::vector<LabelCandidate*> ordered;
+    ordered.reserve( candidates.size() );
+
+    osg::BoundingBox extent;
+    double totalSize = 0.0;
+    for( std::vector<LabelCandidate>::iterator c = candidates.begin(); c != candidates.end(); ++c )
+    {
+        ordered.push_back( &(*c) );
+        if ( _hideClutter )
+        {
+            c->_bound = c->_text->getBound();
+            extent.expandBy( c->_bound );
+            totalSize += std::max( c->_bound.xMax()-c->_bound.xMin(), c->_bound.yMax()-c->_bound.yMin() );
+        }
+    }
+
+    if ( usePriority )
+        std::sort( ordered.begin(), ordered.end(), SortByPriority() );
+
+    // size the grid cells to the average label so that each query touches a few cells.
+    double cellSize = candidates.size() > 0 ? totalSize / (double)candidates.size() : 0.0;
+    if ( !(cellSize > 0.0) )
+        cellSize = 1.0;
+
+    LabelGrid grid( extent.xMin(), extent.yMin(), cellSize );
+
+    for( std::vector<LabelCandidate*>::iterator i = ordered.begin(); i != ordered.end(); ++i )
+    {
+        LabelCandidate* c = *i;
+
+        if ( removeDuplicateLabels && labelNames.find(c->_name) != labelNames.end() )
+            continue;
+
+        if ( _hideClutter )
+        {
+            if ( grid.overlaps(c->_bound) )
+                continue;
+            grid.insert( c->_bound );
+        }
+
+        result->addDrawable( c->_text.get() );
+        if (removeDuplicateLabels) labelNames.insert(c->_name);
     }
+
     return result;
 }
@@ -19,10 +19,10 @@
 #include <osgEarthFeatures/ExtrudeGeometryFilter>
 #include <osgEarthSymbology/MeshSubdivider>
 #include <osgEarthSymbology/MeshConsolidator>
+#include <osgEarthSymbology/PolygonTriangulator>
 #include <osg/Geode>
 #include <osg/Geometry>
 #include <osg/ClusterCullingCallback>
-#include <osgUtil/Tessellator>
 #include <osgUtil/Optimizer>
 #include <osgUtil/SmoothingVisitor>
 #include <osg/Version>
@@ -394,19 +394,14 @@ ExtrudeGeometryFilter::pushFeature( Feature* input, const FilterContext& context
             // tessellate and add the roofs if necessary:
             if ( rooflines.valid() )
             {
-                osgUtil::Tessellator tess;
-                tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
-                tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD ); //POSITIVE );
-                tess.retessellatePolygons( *(rooflines.get()) );
+                // triangulate into a single triangle set.
+                PolygonTriangulator::run( *rooflines.get() );
 
                 // generate default normals (no crease angle necessary; they are all pointing up)
                 osgUtil::SmoothingVisitor::smooth( *rooflines.get() );
 
                 // texture the rooflines if necessary
                 //applyOverlayTexturing( rooflines.get(), input, env );
-                
-                // reorganize the drawable into a single triangle set.
-                MeshConsolidator::run( *rooflines.get() );
 
                 // mark this geometry as DYNAMIC because otherwise the OSG optimizer will destroy it.
                 rooflines->setDataVariance( osg::Object::DYNAMIC );
@@ -459,10 +454,8 @@ ExtrudeGeometryFilter::push( FeatureList& input, const FilterContext& context )
     osgUtil::Optimizer optimizer;
     optimizer.optimize( _geode.get(), osgUtil::Optimizer::MERGE_GEOMETRY );
 
-    //optimizer.optimize( _geode.get(), osgUtil::Optimizer::INDEX_MESH );
-
-    //TODO: figure out whether this helps
-    //optimizer.optimize( _geode, osgUtil::Optimizer::VERTEX_PRETRANSFORM | osgUtil::Optimizer::VERTEX_POSTTRANSFORM );
+    // weld, reorder for the vertex caches, and shrink the indices where possible
+    MeshConsolidator::optimize( *_geode.get() );
     
     // activate the VBOs after optimization
     EnableVBO visitor;
@@ -103,18 +103,6 @@ _policy( policy )
     _cellsX = osg::clampAbove( _cellsX, 1 );
     _cellsY = osg::clampAbove( _cellsY, 1 );
 
-#ifndef OSGEARTH_HAVE_GEOS
-
-    if ( _policy.cullingTechnique().isSetTo( GriddingPolicy::CULL_BY_CROPPING ) )
-    {
-        OE_WARN 
-            << "Warning: Gridding policy 'cull by cropping' requires GEOS. Falling back on 'cull by centroid'." 
-            << std::endl;
-
-        _policy.cullingTechnique() = GriddingPolicy::CULL_BY_CENTROID;
-    }
-
-#endif // !OSGEARTH_HAVE_GEOS
 }
 
 FeatureGridder::~FeatureGridder()
@@ -180,18 +168,8 @@ FeatureGridder::cullFeatureListToCell( int i, FeatureList& features ) const
             }
         }
 
-        else // CULL_BY_CROPPING (requires GEOS)
+        else // CULL_BY_CROPPING
         {
-
-#ifdef OSGEARTH_HAVE_GEOS
-
-            // create the intersection polygon:
-            osg::ref_ptr<Symbology::Polygon> poly = new Symbology::Polygon( 4 );
-            poly->push_back( osg::Vec3d( b.xMin(), b.yMin(), 0 ));
-            poly->push_back( osg::Vec3d( b.xMax(), b.yMin(), 0 ));
-            poly->push_back( osg::Vec3d( b.xMax(), b.yMax(), 0 ));
-            poly->push_back( osg::Vec3d( b.xMin(), b.yMax(), 0 ));
-
             for( FeatureList::iterator f_i = features.begin(); f_i != features.end();  )
             {
                 bool keepFeature = false;
@@ -201,7 +179,7 @@ FeatureGridder::cullFeatureListToCell( int i, FeatureList& features ) const
                 if ( featureGeom )
                 {
                     osg::ref_ptr<Symbology::Geometry> croppedGeometry;
-                    if ( featureGeom->crop( poly.get(), croppedGeometry ) )
+                    if ( featureGeom->crop( b, croppedGeometry ) )
                     {
                         feature->setGeometry( croppedGeometry.get() );
                         keepFeature = true;
@@ -213,9 +191,6 @@ FeatureGridder::cullFeatureListToCell( int i, FeatureList& features ) const
                 else
                     f_i = features.erase( f_i );
             }  
-
-#endif // OSGEARTH_HAVE_GEOS
-
         }
 
     }
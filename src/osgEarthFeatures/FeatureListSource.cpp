@@ -0,0 +1,120 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/FeatureListSource>
+
+#define LC "[FeatureListSource] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    Bounds
+    s_getBounds( const Feature* feature )
+    {
+        return feature && feature->getGeometry() ? feature->getGeometry()->getBounds() : Bounds();
+    }
+}
+
+//------------------------------------------------------------------------
+
+FeatureListSource::FeatureListSource( const GeoExtent& extent, unsigned maxChanges ) :
+FeatureSource(),
+_extent( extent )
+{
+    setMaxChanges( maxChanges );
+}
+
+void
+FeatureListSource::insertFeature( Feature* feature )
+{
+    if ( !feature )
+        return;
+
+    osg::ref_ptr<Feature> newFeature = feature;
+    osg::ref_ptr<Feature> oldFeature;
+    {
+        Threading::ScopedWriteLock exclusive( _featuresMutex );
+        osg::ref_ptr<Feature>& slot = _features[feature->getFID()];
+        oldFeature = slot.get();
+        slot = newFeature.get();
+
+        // record the change while still holding the lock, so that a reader never
+        // sees the new data at an old revision.
+        recordChange( FeatureChange(
+            oldFeature.valid() ? FeatureChange::MODIFIED : FeatureChange::ADDED,
+            feature->getFID(),
+            s_getBounds( oldFeature.get() ),
+            s_getBounds( newFeature.get() ) ) );
+    }
+}
+
+bool
+FeatureListSource::removeFeature( FeatureID fid )
+{
+    Threading::ScopedWriteLock exclusive( _featuresMutex );
+
+    FeatureMap::iterator i = _features.find( fid );
+    if ( i == _features.end() )
+        return false;
+
+    Bounds oldBounds = s_getBounds( i->second.get() );
+    _features.erase( i );
+
+    recordChange( FeatureChange( FeatureChange::DELETED, fid, oldBounds, Bounds() ) );
+    return true;
+}
+
+unsigned
+FeatureListSource::getNumFeatures() const
+{
+    Threading::ScopedReadLock shared( _featuresMutex );
+    return _features.size();
+}
+
+FeatureCursor*
+FeatureListSource::createFeatureCursor( const Symbology::Query& query )
+{
+    FeatureList result;
+    {
+        Threading::ScopedReadLock shared( _featuresMutex );
+
+        for( FeatureMap::const_iterator i = _features.begin(); i != _features.end(); ++i )
+        {
+            const Feature* feature = i->second.get();
+
+            if ( query.bounds().isSet() && !query.bounds()->intersects2d(s_getBounds(feature)) )
+                continue;
+
+            // the filter chain modifies features in place, so hand out copies.
+            result.push_back( new Feature(*feature, osg::CopyOp::DEEP_COPY_ALL) );
+        }
+    }
+
+    return new FeatureListCursor( result );
+}
+
+const FeatureProfile*
+FeatureListSource::createFeatureProfile()
+{
+    return new FeatureProfile( _extent );
+}
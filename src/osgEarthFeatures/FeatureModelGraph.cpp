@@ -21,11 +21,19 @@
 #include <osgEarthFeatures/CropFilter>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/NodeUtils>
+#include <osgEarth/StringUtils>
+#include <osg/ClusterCullingCallback>
+#include <osg/Geode>
 #include <osg/PagedLOD>
 #include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
 #include <osgDB/ReaderWriter>
+#include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
 #include <osgUtil/Optimizer>
+#include <cstdio>
+#include <deque>
+#include <iomanip>
 
 #define LC "[FeatureModelGraph] "
 
@@ -63,7 +71,7 @@ struct osgEarthFeatureModelPseudoLoader : public osgDB::ReaderWriter
 
         UID uid;
         unsigned levelIndex, x, y;
-        sscanf( uri.c_str(), "%u.%d_%d_%d.%*s", &uid, &levelIndex, &x, &y );
+        sscanf( uri.c_str(), "%d.%u_%u_%u.%*s", &uid, &levelIndex, &x, &y );
 
         //OE_INFO << LC << "Page in: " << uri << std::endl;
 
@@ -124,8 +132,135 @@ namespace
             fullExtent.xMin() + w * (double)(tileX+1),
             fullExtent.yMin() + h * (double)(tileY+1) );
     }
+
+    // gathers the pseudo-URIs of all the paged children under a node.
+    struct CollectPagedURIs : public osg::NodeVisitor
+    {
+        CollectPagedURIs() : osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN ) { }
+
+        void apply( osg::PagedLOD& plod )
+        {
+            for( unsigned i=0; i<plod.getNumFileNames(); ++i )
+            {
+                if ( !plod.getFileName(i).empty() )
+                    _uris.push_back( plod.getFileName(i) );
+            }
+            traverse( plod );
+        }
+
+        std::vector<std::string> _uris;
+    };
+
+    // finds nodes or drawables with callbacks that the .ive format can't store. It
+    // stores cluster culling callbacks (which we install for horizon culling) and
+    // nothing else.
+    struct FindCallbacks : public osg::NodeVisitor
+    {
+        FindCallbacks() : osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN ), _found( false ) { }
+
+        static bool transient( const osg::Object* callback )
+        {
+            return callback && !dynamic_cast<const osg::ClusterCullingCallback*>( callback );
+        }
+
+        void apply( osg::Node& node )
+        {
+            const osg::NodeCallback* cull = node.getCullCallback();
+            if ( transient(cull) || (cull && cull->getNestedCallback()) || node.getUpdateCallback() || node.getEventCallback() )
+                _found = true;
+            else
+                traverse( node );
+        }
+
+        void apply( osg::Geode& geode )
+        {
+            for( unsigned i=0; i<geode.getNumDrawables() && !_found; ++i )
+            {
+                const osg::Drawable* d = geode.getDrawable(i);
+                if ( transient(d->getCullCallback()) || d->getUpdateCallback() || d->getEventCallback() )
+                    _found = true;
+            }
+            if ( !_found )
+                apply( static_cast<osg::Node&>(geode) );
+        }
+
+        bool _found;
+    };
 }
 
+//---------------------------------------------------------------------------
+
+/**
+ * Container for the compiled geometry of one tile, when the graph is following
+ * edits to its source. Remembers how to rebuild the tile, and registers itself
+ * with the graph once it is live in the scene graph.
+ */
+class FeatureModelGraph::TileNode : public osg::Group
+{
+public:
+    TileNode(FeatureModelGraph* graph, const FeatureLevel& level, const GeoExtent& extent,
+             const TileKey* key, int builtRevision ) :
+      _graph        ( graph ),
+      _level        ( level ),
+      _extent       ( extent ),
+      _hasKey       ( key != 0L ),
+      _key          ( key ? *key : TileKey() ),
+      _builtRevision( builtRevision ),
+      _registered   ( false ),
+      _dirty        ( false )
+    {
+        // a name keeps RemoveEmptyGroupsVisitor from collapsing an empty tile.
+        setName( "FeatureModelGraph tile" );
+
+        // request an update traversal so we can register with the graph.
+        setNumChildrenRequiringUpdateTraversal( 1 );
+    }
+
+    void traverse( osg::NodeVisitor& nv )
+    {
+        if ( !_registered && nv.getVisitorType() == osg::NodeVisitor::UPDATE_VISITOR )
+        {
+            _registered = true;
+            _graph->registerTile( this );
+            setNumChildrenRequiringUpdateTraversal( getNumChildrenRequiringUpdateTraversal() - 1 );
+        }
+        osg::Group::traverse( nv );
+    }
+
+    FeatureModelGraph*        _graph;
+    FeatureLevel              _level;
+    GeoExtent                 _extent;
+    bool                      _hasKey;
+    TileKey                   _key;
+    int                       _builtRevision;
+    bool                      _registered;
+    bool                      _dirty;
+    osg::ref_ptr<RebuildTask> _pending;
+};
+
+/**
+ * Recompiles the geometry for one tile in the background.
+ */
+class FeatureModelGraph::RebuildTask : public TaskRequest
+{
+public:
+    RebuildTask( TileNode* tile ) : _tile( tile ) { }
+
+    void operator()( ProgressCallback* progress )
+    {
+        if ( progress && progress->isCanceled() )
+            return;
+
+        _result = _tile->_graph->build( _tile->_level, _tile->_extent, _tile->_hasKey ? &_tile->_key : 0L, progress );
+
+        // a partial build is no use to anyone.
+        if ( progress && progress->isCanceled() )
+            _result = 0L;
+    }
+
+    osg::ref_ptr<TileNode> _tile;
+};
+
 
 //---------------------------------------------------------------------------
 
@@ -167,6 +302,19 @@ _session( session )
     if ( _useTiledSource && options.levels().isSet() && options.levels()->getNumLevels() > 0 )
         _useTiledSource = false;
 
+    // a source that journals its edits can be followed incrementally, so that an
+    // edit only recompiles the tiles it touches.
+    _incremental = _source->tracksChanges();
+    if ( _incremental )
+    {
+        _source->sync( _revision );
+        _rebuildService = new TaskService( "FeatureModelGraph", 1 );
+        setNumChildrenRequiringUpdateTraversal( getNumChildrenRequiringUpdateTraversal() + 1 );
+    }
+
+    // persistent tile cache, if the user asked for one:
+    setupCache();
+
     // if there's a display schema in place, set up for quadtree paging.
     if ( options.levels().isSet() || _useTiledSource ) //_source->getFeatureProfile()->getTiled() )
     {
@@ -175,7 +323,7 @@ _session( session )
     else
     {
         FeatureLevel defaultLevel( 0.0f, FLT_MAX );
-        osg::Node* node = build( defaultLevel, GeoExtent::INVALID, 0 );
+        osg::Node* node = buildTile( defaultLevel, GeoExtent::INVALID, 0, 0, 0, 0 );
         if ( node )
             this->addChild( node );
     }
@@ -184,6 +332,131 @@ _session( session )
 FeatureModelGraph::~FeatureModelGraph()
 {
     osgEarthFeatureModelPseudoLoader::unregisterGraph( _uid );
+
+    // stop the rebuild thread before anything it uses goes away.
+    _rebuildService = 0L;
+
+    // break the tile <-> task reference cycles.
+    for( TileNodeVector::iterator i = _liveTiles.begin(); i != _liveTiles.end(); ++i )
+        (*i)->_pending = 0L;
+}
+
+void
+FeatureModelGraph::traverse( osg::NodeVisitor& nv )
+{
+    if ( _incremental && nv.getVisitorType() == osg::NodeVisitor::UPDATE_VISITOR )
+    {
+        updateTiles();
+    }
+    osg::Group::traverse( nv );
+}
+
+void
+FeatureModelGraph::registerTile( TileNode* tile )
+{
+    // if the source changed while the tile was compiling, we may have already
+    // processed those changes without it; so rebuild it to be safe.
+    if ( tile->_builtRevision != (int)_revision )
+        tile->_dirty = true;
+
+    _liveTiles.push_back( tile );
+}
+
+void
+FeatureModelGraph::updateTiles()
+{
+    // Find out what changed since the last update. If the source can't tell us,
+    // every tile is suspect.
+    FeatureChangeSet changes;
+    bool changedAll = false;
+
+    if ( _source->outOfSyncWith(_revision) )
+    {
+        Revision current;
+        _source->sync( current );
+        changedAll = !_source->getChanges( _revision, changes );
+        _revision = current;
+    }
+
+    unsigned numScheduled = 0;
+
+    for( TileNodeVector::iterator i = _liveTiles.begin(); i != _liveTiles.end(); )
+    {
+        TileNode* tile = i->get();
+
+        // the pager expired this tile; forget about it.
+        if ( tile->getNumParents() == 0 )
+        {
+            if ( tile->_pending.valid() )
+                tile->_pending->cancel();
+            tile->_pending = 0L;
+            i = _liveTiles.erase( i );
+            continue;
+        }
+
+        // swap in a finished rebuild:
+        if ( tile->_pending.valid() && tile->_pending->isCompleted() )
+        {
+            if ( !tile->_pending->wasCanceled() )
+            {
+                osg::Node* result = dynamic_cast<osg::Node*>( tile->_pending->getResult() );
+                tile->removeChildren( 0, tile->getNumChildren() );
+                if ( result )
+                    tile->addChild( result );
+            }
+            tile->_pending = 0L;
+        }
+
+        // see whether any of the changes touch this tile:
+        if ( !tile->_dirty )
+        {
+            if ( changedAll || !tile->_extent.isValid() )
+            {
+                tile->_dirty = changedAll || changes.size() > 0;
+            }
+            else
+            {
+                const Bounds tileBounds = tile->_extent.bounds();
+                for( FeatureChangeSet::const_iterator c = changes.begin(); c != changes.end() && !tile->_dirty; ++c )
+                {
+                    tile->_dirty =
+                        tileBounds.intersects2d( c->_oldBounds ) ||
+                        tileBounds.intersects2d( c->_newBounds );
+                }
+            }
+        }
+
+        // and schedule the rebuild, superseding any rebuild already in flight.
+        if ( tile->_dirty )
+        {
+            if ( tile->_pending.valid() )
+                tile->_pending->cancel();
+
+            tile->_pending = new RebuildTask( tile );
+            _rebuildService->add( tile->_pending.get() );
+            tile->_dirty = false;
+            ++numScheduled;
+        }
+
+        ++i;
+    }
+
+    if ( numScheduled > 0 )
+    {
+        OE_DEBUG << LC << "Rebuilding " << numScheduled << " of " << _liveTiles.size() << " tiles" << std::endl;
+    }
+}
+
+unsigned
+FeatureModelGraph::getNumPendingRebuilds() const
+{
+    unsigned count = 0;
+    for( TileNodeVector::const_iterator i = _liveTiles.begin(); i != _liveTiles.end(); ++i )
+    {
+        if ( (*i)->_dirty || (*i)->_pending.valid() )
+            ++count;
+    }
+    return count;
 }
 
 osg::BoundingSphered
@@ -355,7 +628,7 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
         FeatureLevel level( 0, maxRange );
         
         TileKey key(lod, tileX, tileY, _source->getFeatureProfile()->getProfile());
-        osg::Group* geometry = build( level, tileExtent, &key );
+        osg::Group* geometry = buildTile( level, tileExtent, &key, levelIndex, tileX, tileY );
         result = geometry;
 
         if (lod < _source->getFeatureProfile()->getMaxLevel())
@@ -385,7 +658,7 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
     {
         // no levels defined; just load all the features.
         FeatureLevel all( 0.0f, FLT_MAX );
-        result = build( all, GeoExtent::INVALID, 0 );
+        result = buildTile( all, GeoExtent::INVALID, 0, 0, 0, 0 );
     }
 
     else
@@ -405,7 +678,7 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
                 s_getTileExtent( lod, tileX, tileY, _usableFeatureExtent ) :
                 GeoExtent::INVALID;
 
-            osg::Group* geometry = build( *level, tileExtent, 0 );
+            osg::Group* geometry = buildTile( *level, tileExtent, 0, levelIndex, tileX, tileY );
             result = geometry;
 
             // see if there are any more levels. If so, build some pagedlods to bring the
@@ -445,7 +718,7 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
         RemoveEmptyGroupsVisitor::run( result );
     }
 
-    if ( result->getNumChildren() == 0 )
+    if ( result->getNumChildren() == 0 && !_incremental )
     {
         Threading::ScopedWriteLock exclusiveLock( _blacklistMutex );
         _blacklist.insert( uri );
@@ -456,8 +729,234 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
     return result;
 }
 
+void
+FeatureModelGraph::setupCache()
+{
+    if ( !_options.cachePath().isSet() || _options.cachePath()->empty() )
+        return;
+
+    if ( _incremental )
+    {
+        OE_INFO << LC << "Feature source is live; tile cache disabled" << std::endl;
+        return;
+    }
+
+    if ( !_factory->supportsPersistentCaching() )
+    {
+        OE_INFO << LC << "Node factory does not support persistent caching; tile cache disabled" << std::endl;
+        return;
+    }
+
+    // tiles compiled from data that may since have changed would be served forever,
+    // so the source has to be able to tell us what state its data is in.
+    std::string fingerprint = _source->getDataFingerprint();
+    if ( fingerprint.empty() )
+    {
+        OE_INFO << LC << "Feature source can't fingerprint its data; tile cache disabled" << std::endl;
+        return;
+    }
+
+    // The cache ID is a hash of everything that affects the compiled output: the
+    // feature source and the state of its data, the styles, the layout and the
+    // compilation options. Changing the data moves the cache to a new folder.
+    Config hashConf = _options.getConfig();
+    hashConf.remove( "name" );
+    hashConf.remove( "cache_path" );
+    hashConf.update( "features", _source->getFeatureSourceOptions().getConfig() );
+    hashConf.update( "data", fingerprint );
+    hashConf.update( "stylesheet", _styles.getConfig() );
+
+    // the tiles on disk match the source as configured; once it's edited they don't.
+    _source->sync( _cacheRevision );
+    if ( !_source->inSyncWith(_cacheRevision) )
+    {
+        OE_INFO << LC << "Feature source is always dirty; tile cache disabled" << std::endl;
+        return;
+    }
+
+    std::stringstream buf;
+    buf << *_options.cachePath() << "/"
+        << std::hex << std::setw(8) << std::setfill('0')
+        << osgEarth::hashString( hashConf.toHashString() );
+    _cacheDir = buf.str();
+
+    OE_INFO << LC << "Feature tile cache at " << _cacheDir << std::endl;
+}
+
+std::string
+FeatureModelGraph::getCacheFileName( unsigned levelIndex, unsigned tileX, unsigned tileY ) const
+{
+    // Revisions are counted per process, so they can't go in the path (the data
+    // fingerprint is, instead). Once the source is edited in this session the cache
+    // is bypassed.
+    if ( !_source->inSyncWith(_cacheRevision) )
+        return "";
+
+    std::stringstream buf;
+    buf << _cacheDir << "/"
+        << levelIndex << "/" << tileX << "/" << tileY << ".ive";
+    std::string str = buf.str();
+    return str;
+}
+
+bool
+FeatureModelGraph::readTileFromCache( const std::string& filename, osg::ref_ptr<osg::Group>& out_group ) const
+{
+    if ( !osgDB::fileExists(filename) )
+        return false;
+
+    osg::ref_ptr<osg::Node> node = osgDB::readNodeFile( filename );
+    if ( !node.valid() || !node->asGroup() )
+    {
+        OE_WARN << LC << "Failed to read cached tile " << filename << "; recompiling" << std::endl;
+        return false;
+    }
+
+    out_group = node->asGroup();
+    return true;
+}
+
+void
+FeatureModelGraph::writeTileToCache( const std::string& filename, osg::Group* group ) const
+{
+    // empty tiles are cached too, as empty groups, so we don't re-query them.
+    osg::ref_ptr<osg::Group> empty;
+    if ( !group )
+    {
+        empty = new osg::Group();
+        group = empty.get();
+    }
+
+    // Most callbacks don't survive a round trip through the .ive writer (e.g. the cull
+    // plane callbacks on text), so a reloaded tile would behave differently. Don't cache those.
+    FindCallbacks findCallbacks;
+    group->accept( findCallbacks );
+    if ( findCallbacks._found )
+    {
+        OE_DEBUG << LC << "Tile has callbacks; not caching " << filename << std::endl;
+        return;
+    }
+
+    if ( !osgDB::makeDirectoryForFile(filename) )
+    {
+        OE_WARN << LC << "Failed to create folder for " << filename << std::endl;
+        return;
+    }
+
+    // write to a temporary file and then move it into place, so that a concurrent or
+    // subsequent reader never sees a partially written tile.
+    // (keep the extension intact so osgDB picks the right writer.)
+    std::string tempName = osgDB::getNameLessExtension(filename) + ".tmp." + osgDB::getFileExtension(filename);
+    if ( !osgDB::writeNodeFile(*group, tempName) )
+    {
+        OE_WARN << LC << "Failed to write cached tile " << filename << std::endl;
+        ::remove( tempName.c_str() );
+        return;
+    }
+
+    ::remove( filename.c_str() );
+    if ( ::rename(tempName.c_str(), filename.c_str()) != 0 )
+    {
+        ::remove( tempName.c_str() );
+    }
+}
+
+osg::Group*
+FeatureModelGraph::buildTile(const FeatureLevel& level,
+                             const GeoExtent&    extent,
+                             const TileKey*      key,
+                             unsigned            levelIndex,
+                             unsigned            tileX,
+                             unsigned            tileY )
+{
+    std::string filename;
+    if ( isCacheEnabled() )
+    {
+        filename = getCacheFileName( levelIndex, tileX, tileY );
+        if ( !filename.empty() )
+        {
+            osg::ref_ptr<osg::Group> cached;
+            if ( readTileFromCache(filename, cached) )
+            {
+                OE_DEBUG << LC << "Cache hit: " << filename << std::endl;
+                return cached->getNumChildren() > 0 ? cached.release() : 0L;
+            }
+        }
+    }
+
+    Revision builtRevision;
+    if ( _incremental )
+        _source->sync( builtRevision );
+
+    osg::Group* geometry = build( level, extent, key );
+
+    if ( !filename.empty() )
+        writeTileToCache( filename, geometry );
+
+    // to follow edits, wrap the geometry in a container that we can rebuild in place.
+    // it's returned even if it's empty, since features may appear in it later.
+    if ( _incremental )
+    {
+        TileNode* tile = new TileNode( this, level, extent, key, builtRevision );
+        if ( geometry )
+            tile->addChild( geometry );
+        return tile;
+    }
+
+    return geometry;
+}
+
+void
+FeatureModelGraph::seed( unsigned maxLevelIndex, ProgressCallback* progress )
+{
+    if ( !isCacheEnabled() )
+    {
+        OE_WARN << LC << "No tile cache is configured for this layer; nothing to seed" << std::endl;
+        return;
+    }
+
+    // walk the paging hierarchy breadth-first, starting with the top-level paged children.
+    // loading each tile compiles it and writes it to the cache.
+    std::deque<std::string> queue;
+    {
+        CollectPagedURIs collector;
+        this->accept( collector );
+        queue.insert( queue.end(), collector._uris.begin(), collector._uris.end() );
+    }
+
+    unsigned count = 0;
+    while( queue.size() > 0 )
+    {
+        std::string uri = queue.front();
+        queue.pop_front();
+
+        UID uid;
+        unsigned levelIndex, x, y;
+        if ( sscanf( uri.c_str(), "%d.%u_%u_%u.%*s", &uid, &levelIndex, &x, &y ) != 4 )
+            continue;
+
+        if ( levelIndex > maxLevelIndex )
+            continue;
+
+        osg::ref_ptr<osg::Node> node = load( levelIndex, x, y, uri );
+        ++count;
+
+        if ( progress && progress->reportProgress( (double)count, (double)(count + queue.size()), uri ) )
+            break;
+
+        if ( node.valid() )
+        {
+            CollectPagedURIs collector;
+            node->accept( collector );
+            queue.insert( queue.end(), collector._uris.begin(), collector._uris.end() );
+        }
+    }
+
+    OE_INFO << LC << "Seeded " << count << " tiles to " << _cacheDir << std::endl;
+}
+
 osg::Group*
-FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, const TileKey* key )
+FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, const TileKey* key, ProgressCallback* progress )
 {
     osg::ref_ptr<osg::Group> group = new osg::Group();
 
@@ -476,7 +975,7 @@ FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, co
     // if there are none, just build once with the default style and query.
     if ( levelSelectors.size() == 0 )
     {
-        osg::Node* node = build( Style(), query, extent );
+        osg::Node* node = build( Style(), query, extent, progress );
         if ( node )
             group->addChild( node );
     }
@@ -485,6 +984,9 @@ FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, co
     {
         for( StyleSelectorVector::const_iterator i = levelSelectors.begin(); i != levelSelectors.end(); ++i )
         {
+            if ( progress && progress->isCanceled() )
+                return 0L;
+
             const StyleSelector& selector = *i;
 
             // fetch the selector's style:
@@ -495,7 +997,7 @@ FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, co
             Query selectorQuery = 
                 selector.query().isSet() ? query.combineWith( *selector.query() ) : query;
 
-            osg::Node* node = build( selectorStyle, selectorQuery, extent );
+            osg::Node* node = build( selectorStyle, selectorQuery, extent, progress );
             if ( node )
                 group->addChild( node );
         }
@@ -543,7 +1045,7 @@ FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, co
 }
 
 osg::Group*
-FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const GeoExtent& workingExtent )
+FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const GeoExtent& workingExtent, ProgressCallback* progress )
 {
     osg::ref_ptr<osg::Group> group = new osg::Group();
 
@@ -555,6 +1057,9 @@ FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const
         osg::ref_ptr<FeatureCursor> cursor = _source->createFeatureCursor( baseQuery );
         while( cursor->hasMore() )
         {
+            if ( progress && progress->isCanceled() )
+                return 0L;
+
             Feature* feature = cursor->nextFeature();
             if ( feature )
             {
@@ -563,6 +1068,7 @@ FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const
                 osg::ref_ptr<FeatureCursor> cursor = new FeatureListCursor(list);
 
                 FilterContext context( _session.get(), _source->getFeatureProfile(), workingExtent );
+                context.setProgressCallback( progress );
 
                 // note: gridding is not supported for embedded styles.
                 osg::ref_ptr<osg::Node> node;
@@ -587,6 +1093,9 @@ FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const
         {
             for( StyleSelectorList::const_iterator i = _styles.selectors().begin(); i != _styles.selectors().end(); ++i )
             {
+                if ( progress && progress->isCanceled() )
+                    return 0L;
+
                 // pull the selected style...
                 const StyleSelector& sel = *i;
 
@@ -599,7 +1108,7 @@ FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const
                 Query combinedQuery = baseQuery.combineWith( *sel.query() );
 
                 // then create the node.
-                osg::Group* styleGroup = createNodeForStyle( combinedStyle, combinedQuery );
+                osg::Group* styleGroup = createNodeForStyle( combinedStyle, combinedQuery, progress );
                 if ( styleGroup && !group->containsNode(styleGroup) )
                     group->addChild( styleGroup );
             }
@@ -614,7 +1123,7 @@ FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const
             if ( baseStyle.empty() )
                 _styles.getDefaultStyle( combinedStyle );
 
-            osg::Group* styleGroup = createNodeForStyle( combinedStyle, baseQuery );
+            osg::Group* styleGroup = createNodeForStyle( combinedStyle, baseQuery, progress );
             if ( styleGroup && !group->containsNode(styleGroup) )
                 group->addChild( styleGroup );
         }
@@ -624,7 +1133,7 @@ FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const
 }
 
 osg::Group*
-FeatureModelGraph::createNodeForStyle(const Style& style, const Query& query)
+FeatureModelGraph::createNodeForStyle(const Style& style, const Query& query, ProgressCallback* progress)
 {
     osg::Group* styleGroup = 0L;
 
@@ -643,6 +1152,7 @@ FeatureModelGraph::createNodeForStyle(const Style& style, const Query& query)
             query.bounds().isSet() ? *query.bounds() : extent.bounds();
 
         FilterContext context( _session.get(), profile, GeoExtent(profile->getSRS(), cellBounds) );
+        context.setProgressCallback( progress );
 
         // start by culling our feature list to the working extent. By default, this is done by
         // checking feature centroids. But the user can override this to crop feature geometry to
@@ -666,7 +1176,7 @@ FeatureModelGraph::createNodeForStyle(const Style& style, const Query& query)
             context = crop2.push( workingSet, context );
         }
 
-        if ( workingSet.size() > 0 )
+        if ( workingSet.size() > 0 && !context.isCanceled() )
         {
             // next ask the implementation to construct OSG geometry for the cell features.
             osg::ref_ptr<osg::Node> node;
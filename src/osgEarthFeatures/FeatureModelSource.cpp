@@ -19,6 +19,7 @@
 #include <osgEarthFeatures/FeatureModelSource>
 #include <osgEarthFeatures/FeatureModelGraph>
 #include <osgEarth/SpatialReference>
+#include <osgEarth/FileUtils>
 #include <osg/Notify>
 #include <osg/Timer>
 #include <osg/LOD>
@@ -59,6 +60,7 @@ FeatureModelSourceOptions::fromConfig( const Config& conf )
     conf.getIfSet( "max_granularity", _maxGranularity_deg );
     conf.getIfSet( "merge_geometry", _mergeGeometry );
     conf.getIfSet( "cluster_culling", _clusterCulling );
+    conf.getIfSet( "cache_path", _cachePath );
 
     std::string gt = conf.value( "geometry_type" );
     if ( gt == "line" || gt == "lines" || gt == "linestring" )
@@ -82,6 +84,7 @@ FeatureModelSourceOptions::getConfig() const
     conf.updateIfSet( "max_granularity", _maxGranularity_deg );
     conf.updateIfSet( "merge_geometry", _mergeGeometry );
     conf.updateIfSet( "cluster_culling", _clusterCulling );
+    conf.updateIfSet( "cache_path", _cachePath );
 
     if ( _geomTypeOverride.isSet() ) {
         if ( _geomTypeOverride == Geometry::TYPE_LINESTRING )
@@ -134,6 +137,8 @@ FeatureModelSource::initialize( const std::string& referenceURI, const osgEarth:
 {
     ModelSource::initialize( referenceURI, map );
 
+    _referenceURI = referenceURI;
+
     if ( _features.valid() )
     {
         _features->initialize( referenceURI );
@@ -155,9 +160,14 @@ FeatureModelSource::createNode( ProgressCallback* progress )
     if ( !_factory.valid() )
         return 0L;
 
+    // resolve the tile cache location relative to the earth file:
+    FeatureModelSourceOptions options = _options;
+    if ( options.cachePath().isSet() && !options.cachePath()->empty() )
+        options.cachePath() = osgEarth::getFullPath( _referenceURI, *options.cachePath() );
+
     FeatureModelGraph* graph = new FeatureModelGraph( 
         _features.get(), 
-        _options, 
+        options, 
         _factory.get(),
         *_options.styles(),
         new Session( _map ) );
@@ -129,11 +129,79 @@ FeatureSourceOptions::getConfig() const
 //------------------------------------------------------------------------
 
 FeatureSource::FeatureSource( const ConfigOptions& options ) :
-_options( options )
+_options        ( options ),
+_maxChanges     ( 0 ),
+_changesFloor   ( 0 ),
+_changesRevision( 0 )
 {    
     //nop
 }
 
+void
+FeatureSource::setMaxChanges( unsigned maxChanges )
+{
+    ScopedLock<Mutex> lock( _changesMutex );
+    _maxChanges = maxChanges;
+    while( _changes.size() > _maxChanges )
+    {
+        _changesFloor = _changes.front().first;
+        _changes.pop_front();
+    }
+}
+
+void
+FeatureSource::recordChange( const FeatureChange& change )
+{
+    ScopedLock<Mutex> lock( _changesMutex );
+
+    dirty();
+
+    Revision rev;
+    sync( rev );
+    _changesRevision = rev;
+
+    if ( _maxChanges > 0 )
+    {
+        _changes.push_back( std::make_pair(_changesRevision, change) );
+
+        // once an entry falls off the journal, the changes at its revision are
+        // no longer fully accounted for.
+        while( _changes.size() > _maxChanges )
+        {
+            _changesFloor = _changes.front().first;
+            _changes.pop_front();
+        }
+    }
+}
+
+bool
+FeatureSource::getChanges( const Revision& since, FeatureChangeSet& out_changes ) const
+{
+    ScopedLock<Mutex> lock( _changesMutex );
+
+    if ( _maxChanges == 0 )
+        return false;
+
+    Revision current;
+    sync( current );
+
+    // a plain dirty() (or an always-dirty source) bypasses the journal, so we
+    // cannot say what changed.
+    if ( !inSyncWith(current) || (int)current != _changesRevision )
+        return false;
+
+    if ( (int)since < _changesFloor || (int)since > (int)current )
+        return false;
+
+    for( ChangeJournal::const_iterator i = _changes.begin(); i != _changes.end(); ++i )
+    {
+        if ( i->first > (int)since )
+            out_changes.push_back( i->second );
+    }
+
+    return true;
+}
+
 const FeatureProfile*
 FeatureSource::getFeatureProfile() const
 {
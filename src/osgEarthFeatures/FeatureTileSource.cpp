@@ -20,6 +20,7 @@
 #include <osgEarth/Registry>
 #include <osgDB/WriteFile>
 #include <osg/Notify>
+#include <OpenThreads/ScopedLock>
 
 using namespace osgEarth;
 using namespace osgEarth::Features;
@@ -27,6 +28,32 @@ using namespace osgEarth::Symbology;
 
 #define LC "[FeatureTileSource] "
 
+// Tiles share a feature bucket with the other tiles under the same ancestor
+// this many levels up (i.e., 4x4 tiles per bucket).
+#define BUCKET_LEVELS 2
+
+// Maximum number of feature buckets to keep around.
+#define MAX_BUCKETS 16
+
+namespace
+{
+    // intersects an image extent with the feature extent, returning the result in
+    // the feature SRS.
+    bool
+    s_getQueryExtent( const GeoExtent& featuresExtent, const GeoExtent& imageExtent, GeoExtent& out_extent )
+    {
+        // convert them both to WGS84, intersect the extents, and convert back.
+        GeoExtent featuresExtentWGS84 = featuresExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
+        GeoExtent imageExtentWGS84 = imageExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
+        GeoExtent queryExtentWGS84 = featuresExtentWGS84.intersectionSameSRS( imageExtentWGS84.bounds() );
+        if ( !queryExtentWGS84.isValid() )
+            return false;
+
+        out_extent = queryExtentWGS84.transform( featuresExtent.getSRS() );
+        return true;
+    }
+}
+
 /*************************************************************************/
 
 FeatureTileSourceOptions::FeatureTileSourceOptions( const ConfigOptions& options ) :
@@ -196,19 +223,19 @@ FeatureTileSource::createImage( const TileKey& key, ProgressCallback* progress )
                 const StyleSelector& sel = *i;
                 Style style;
                 styles->getStyle( sel.getSelectedStyleName(), style );
-                queryAndRenderFeaturesForStyle( style, sel.query().value(), buildData.get(), key.getExtent(), image.get() );
+                queryAndRenderFeaturesForStyle( style, sel.query().value(), buildData.get(), key, image.get() );
             }
         }
         else
         {
             Style style;
             styles->getDefaultStyle( style );
-            queryAndRenderFeaturesForStyle( style, Query(), buildData.get(), key.getExtent(), image.get() );
+            queryAndRenderFeaturesForStyle( style, Query(), buildData.get(), key, image.get() );
         }
     }
     else
     {
-        queryAndRenderFeaturesForStyle( Style(), Query(), buildData.get(), key.getExtent(), image.get() );
+        queryAndRenderFeaturesForStyle( Style(), Query(), buildData.get(), key, image.get() );
     }
 
     // final tile processing after all styles are done
@@ -218,25 +245,42 @@ FeatureTileSource::createImage( const TileKey& key, ProgressCallback* progress )
 }
 
 
-bool
-FeatureTileSource::queryAndRenderFeaturesForStyle(const Style&     style,
-                                                  const Query&     query,
-                                                  osg::Referenced* data,
-                                                  const GeoExtent& imageExtent,
-                                                  osg::Image*      out_image)
-{   
-    // first we need the overall extent of the layer:
-    const GeoExtent& featuresExtent = getFeatureSource()->getFeatureProfile()->getExtent();
-    
-    // convert them both to WGS84, intersect the extents, and convert back.
-    GeoExtent featuresExtentWGS84 = featuresExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
-    GeoExtent imageExtentWGS84 = imageExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
-    GeoExtent queryExtentWGS84 = featuresExtentWGS84.intersectionSameSRS( imageExtentWGS84.bounds() );
-    if ( queryExtentWGS84.isValid() )
+void
+FeatureTileSource::getOrCreateBucket(const TileKey&               bucketKey,
+                                     const Query&                 query,
+                                     osg::ref_ptr<FeatureBucket>& out_bucket )
+{
+    std::string id = bucketKey.str() + ":" + query.getConfig().toHashString();
+
     {
-        GeoExtent queryExtent = queryExtentWGS84.transform( featuresExtent.getSRS() );
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _bucketMutex );
+
+        // start over if the features changed.
+        if ( _features->outOfSyncWith(_bucketRevision) )
+        {
+            _buckets.clear();
+            _bucketLRU.clear();
+            _features->sync( _bucketRevision );
+        }
+
+        FeatureBucketMap::iterator i = _buckets.find( id );
+        if ( i != _buckets.end() )
+        {
+            _bucketLRU.remove( id );
+            _bucketLRU.push_front( id );
+            out_bucket = i->second.get();
+            return;
+        }
+    }
+
+    osg::ref_ptr<FeatureBucket> bucket = new FeatureBucket();
+
+    const GeoExtent& featuresExtent = getFeatureSource()->getFeatureProfile()->getExtent();
 
-	    // incorporate the image extent into the feature query for this style:
+    GeoExtent queryExtent;
+    if ( s_getQueryExtent(featuresExtent, bucketKey.getExtent(), queryExtent) )
+    {
+	    // incorporate the bucket extent into the feature query for this style:
         Query localQuery = query;
         localQuery.bounds() = query.bounds().isSet()?
 		    query.bounds()->unionWith( queryExtent.bounds() ) :
@@ -245,9 +289,8 @@ FeatureTileSource::queryAndRenderFeaturesForStyle(const Style&     style,
         // query the feature source:
         osg::ref_ptr<FeatureCursor> cursor = _features->createFeatureCursor( localQuery );
 
-        // now copy the resulting feature set into a list, converting the data
+        // now copy the resulting feature set into the bucket, converting the data
         // types along the way if a geometry override is in place:
-        FeatureList cellFeatures;
         while( cursor->hasMore() )
         {
             Feature* feature = cursor->nextFeature();
@@ -265,22 +308,77 @@ FeatureTileSource::queryAndRenderFeaturesForStyle(const Style&     style,
             }
             if ( geom )
             {
-                cellFeatures.push_back( feature );
+                bucket->_features.push_back( feature );
+                bucket->_bounds.push_back( geom->getBounds() );
             }
         }
+    }
 
-        //OE_NOTICE
-        //    << "Rendering "
-        //    << cellFeatures.size()
-        //    << " features in ("
-        //    << queryExtent.toString() << ")"
-        //    << std::endl;
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _bucketMutex );
 
-	    return renderFeaturesForStyle( style, cellFeatures, data, imageExtent, out_image );
+    // another thread may have beaten us to it.
+    FeatureBucketMap::iterator i = _buckets.find( id );
+    if ( i != _buckets.end() )
+    {
+        out_bucket = i->second.get();
+        return;
     }
-    else
+
+    _buckets[id] = bucket.get();
+    _bucketLRU.push_front( id );
+    while( _bucketLRU.size() > MAX_BUCKETS )
     {
-        return false;
+        _buckets.erase( _bucketLRU.back() );
+        _bucketLRU.pop_back();
     }
+
+    out_bucket = bucket.get();
 }
 
+bool
+FeatureTileSource::queryAndRenderFeaturesForStyle(const Style&     style,
+                                                  const Query&     query,
+                                                  osg::Referenced* data,
+                                                  const TileKey&   key,
+                                                  osg::Image*      out_image)
+{   
+    const GeoExtent& imageExtent = key.getExtent();
+
+    // the part of the layer that this tile covers:
+    const GeoExtent& featuresExtent = getFeatureSource()->getFeatureProfile()->getExtent();
+    GeoExtent queryExtent;
+    if ( !s_getQueryExtent(featuresExtent, imageExtent, queryExtent) )
+        return false;
+
+    Bounds tileBounds = query.bounds().isSet() ?
+        query.bounds()->unionWith( queryExtent.bounds() ) :
+        queryExtent.bounds();
+
+    // the features come from a bucket shared with the neighbouring tiles:
+    unsigned lod = key.getLevelOfDetail();
+    TileKey bucketKey = lod > BUCKET_LEVELS ? key.createAncestorKey( lod - BUCKET_LEVELS ) : key;
+
+    osg::ref_ptr<FeatureBucket> bucket;
+    getOrCreateBucket( bucketKey, query, bucket );
+
+    // take the features that fall within this tile. The renderer modifies the
+    // features it gets, so they are copies.
+    FeatureList cellFeatures;
+    FeatureList::const_iterator f = bucket->_features.begin();
+    for( unsigned k = 0; f != bucket->_features.end(); ++f, ++k )
+    {
+        if ( bucket->_bounds[k].intersects2d( tileBounds ) )
+        {
+            cellFeatures.push_back( new Feature( *f->get(), osg::CopyOp::DEEP_COPY_ALL ) );
+        }
+    }
+
+    //OE_NOTICE
+    //    << "Rendering "
+    //    << cellFeatures.size()
+    //    << " features in ("
+    //    << queryExtent.toString() << ")"
+    //    << std::endl;
+
+    return renderFeaturesForStyle( style, cellFeatures, data, imageExtent, out_image );
+}
@@ -39,7 +39,8 @@ _isGeocentric( rhs._isGeocentric ),
 _extent( rhs._extent ),
 _referenceFrame( rhs._referenceFrame ),
 _inverseReferenceFrame( rhs._inverseReferenceFrame ),
-_optimizerHints( rhs._optimizerHints )
+_optimizerHints( rhs._optimizerHints ),
+_progress( rhs._progress.get() )
 {
     //nop
 }
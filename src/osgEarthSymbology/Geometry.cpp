@@ -19,6 +19,7 @@
 #include <osgEarthSymbology/Geometry>
 #include <osgEarthSymbology/GEOS>
 #include <algorithm>
+#include <cmath>
 #include <iterator>
 
 using namespace osgEarth;
@@ -245,6 +246,445 @@ Geometry::crop( const Polygon* cropPoly, osg::ref_ptr<Geometry>& output ) const
 #endif // OSGEARTH_HAVE_GEOS
 }
 
+namespace
+{
+    // Liang-Barsky clipping of the segment p0-p1; returns false if none of it is inside.
+    bool clipSegment( const osg::Vec3d& p0, const osg::Vec3d& p1, const Bounds& b, double& t0, double& t1 )
+    {
+        double dx = p1.x() - p0.x(), dy = p1.y() - p0.y();
+        double p[4] = { -dx, dx, -dy, dy };
+        double q[4] = { p0.x() - b.xMin(), b.xMax() - p0.x(), p0.y() - b.yMin(), b.yMax() - p0.y() };
+
+        t0 = 0.0;
+        t1 = 1.0;
+        for( int k=0; k<4; ++k )
+        {
+            if ( p[k] == 0.0 )
+            {
+                if ( q[k] < 0.0 )
+                    return false;
+            }
+            else
+            {
+                double r = q[k] / p[k];
+                if ( p[k] < 0.0 )
+                {
+                    if ( r > t1 ) return false;
+                    if ( r > t0 ) t0 = r;
+                }
+                else
+                {
+                    if ( r < t0 ) return false;
+                    if ( r < t1 ) t1 = r;
+                }
+            }
+        }
+        return true;
+    }
+
+    void clipLine( const Geometry* input, const Bounds& b, GeometryCollection& output )
+    {
+        osg::ref_ptr<LineString> run;
+        for( unsigned i=0; i+1 < input->size(); ++i )
+        {
+            const osg::Vec3d& p0 = (*input)[i];
+            const osg::Vec3d& p1 = (*input)[i+1];
+            double t0, t1;
+            if ( !clipSegment(p0, p1, b, t0, t1) )
+            {
+                run = 0L;
+                continue;
+            }
+
+            if ( !run.valid() || t0 > 0.0 )
+            {
+                run = new LineString();
+                run->push_back( p0 + (p1-p0)*t0 );
+                output.push_back( run.get() );
+            }
+            run->push_back( p0 + (p1-p0)*t1 );
+
+            // the line leaves the rectangle; the next piece (if any) starts a new part.
+            if ( t1 < 1.0 )
+                run = 0L;
+        }
+
+        // single-point lines are not valid, drop them:
+        for( GeometryCollection::iterator i = output.begin(); i != output.end(); )
+        {
+            if ( (*i)->size() < 2 )
+                i = output.erase( i );
+            else
+                ++i;
+        }
+    }
+
+    // Polygons are clipped Weiler-Atherton style. Each ring is cut into "runs", the
+    // stretches of it that lie inside the rectangle; every run enters and leaves through
+    // the border. Walking the border counter-clockwise from where one run leaves to
+    // where the next one enters stitches the runs back into rings, so a concave polygon
+    // that the rectangle cuts into several pieces comes out as several rings.
+
+    struct Run
+    {
+        std::vector<osg::Vec3d> points;
+        double                  entry, exit;  // positions along the border
+        bool                    used;
+    };
+
+    typedef std::vector<osg::Vec3d> Points;
+
+    double signedArea( const Points& v )
+    {
+        double sum = 0.0;
+        for( unsigned i=0, j=v.size()-1; i<v.size(); j = i++ )
+            sum += v[j].x()*v[i].y() - v[i].x()*v[j].y();
+        return 0.5*sum;
+    }
+
+    // copies the ring open, wound counter-clockwise (outer rings) or clockwise (holes)
+    // so that the polygon's interior is always on the left.
+    void wind( const Ring* ring, bool ccw, Points& v )
+    {
+        v.assign( ring->begin(), ring->end() );
+        while( v.size() > 1 && v.front() == v.back() )
+            v.pop_back();
+        if ( v.size() >= 3 && (signedArea(v) > 0.0) != ccw )
+            std::reverse( v.begin(), v.end() );
+    }
+
+    // inverse-distance weighted elevation of a ring at (x,y), for points the clip adds
+    // that have no counterpart in the source.
+    double zAt( const Points& v, double x, double y )
+    {
+        double sum = 0.0, weights = 0.0;
+        for( Points::const_iterator i = v.begin(); i != v.end(); ++i )
+        {
+            double dx = i->x()-x, dy = i->y()-y, d2 = dx*dx + dy*dy;
+            if ( d2 == 0.0 )
+                return i->z();
+            sum += i->z()/d2;
+            weights += 1.0/d2;
+        }
+        return weights > 0.0 ? sum/weights : 0.0;
+    }
+
+    bool inside( const Points& v, const Bounds& b )
+    {
+        for( Points::const_iterator i = v.begin(); i != v.end(); ++i )
+            if ( i->x() < b.xMin() || i->x() > b.xMax() || i->y() < b.yMin() || i->y() > b.yMax() )
+                return false;
+        return true;
+    }
+
+    // snaps a point onto the nearest side of the rectangle and returns its position
+    // along the border, measured counter-clockwise from (xMin,yMin).
+    double borderPosition( osg::Vec3d& p, const Bounds& b )
+    {
+        double w = b.width(), h = b.height();
+        double d[4] = { p.y()-b.yMin(), b.xMax()-p.x(), b.yMax()-p.y(), p.x()-b.xMin() };
+        int side = 0;
+        for( int k=1; k<4; ++k )
+            if ( fabs(d[k]) < fabs(d[side]) )
+                side = k;
+
+        double pos;
+        switch( side )
+        {
+        case 0:  p.y() = b.yMin(); pos = p.x() - b.xMin(); break;
+        case 1:  p.x() = b.xMax(); pos = w + p.y() - b.yMin(); break;
+        case 2:  p.y() = b.yMax(); pos = w + h + b.xMax() - p.x(); break;
+        default: p.x() = b.xMin(); pos = w + w + h + b.yMax() - p.y(); break;
+        }
+        return pos >= 2.0*(w+h) ? 0.0 : pos < 0.0 ? 0.0 : pos;
+    }
+
+    // true if the edge runs along the border with the polygon's interior (on its left)
+    // outside the rectangle. Such an edge only touches the crop, so it ends a run.
+    bool outsideAlongBorder( const osg::Vec3d& p0, const osg::Vec3d& p1, const Bounds& b )
+    {
+        return
+            (p0.y() == b.yMin() && p1.y() == b.yMin() && p1.x() < p0.x()) ||
+            (p0.x() == b.xMax() && p1.x() == b.xMax() && p1.y() < p0.y()) ||
+            (p0.y() == b.yMax() && p1.y() == b.yMax() && p1.x() > p0.x()) ||
+            (p0.x() == b.xMin() && p1.x() == b.xMin() && p1.y() > p0.y());
+    }
+
+    // cuts a wound ring with at least one vertex outside the rectangle into runs.
+    void cutRuns( const Points& v, const Bounds& b, std::vector<Run>& runs )
+    {
+        // start at a vertex outside so that no run wraps around the end of the ring.
+        unsigned n = v.size(), s = 0;
+        while( s < n && v[s].x() >= b.xMin() && v[s].x() <= b.xMax() && v[s].y() >= b.yMin() && v[s].y() <= b.yMax() )
+            ++s;
+        if ( s == n )
+            return;
+
+        int current = -1;
+        for( unsigned k=0; k<n; ++k )
+        {
+            const osg::Vec3d& p0 = v[(s+k) % n];
+            const osg::Vec3d& p1 = v[(s+k+1) % n];
+            double t0, t1;
+            if ( !clipSegment(p0, p1, b, t0, t1) || (t1 <= t0 && p0 != p1) || outsideAlongBorder(p0, p1, b) )
+            {
+                current = -1;
+                continue;
+            }
+
+            if ( current < 0 || t0 > 0.0 )
+            {
+                runs.push_back( Run() );
+                current = runs.size()-1;
+                Run& run = runs.back();
+                run.used = false;
+                run.points.push_back( p0 + (p1-p0)*t0 );
+                run.entry = borderPosition( run.points.back(), b );
+            }
+            runs[current].points.push_back( p0 + (p1-p0)*t1 );
+
+            if ( t1 < 1.0 )
+                current = -1;
+        }
+
+        // the ring ends outside, so every run ends on the border:
+        for( std::vector<Run>::iterator r = runs.begin(); r != runs.end(); ++r )
+            r->exit = borderPosition( r->points.back(), b );
+    }
+
+    void stitchRuns( std::vector<Run>& runs, const Bounds& b, std::vector<Points>& rings )
+    {
+        double w = b.width(), h = b.height(), perimeter = 2.0*(w+h);
+        const double cornerPos[4] = { 0.0, w, w+h, w+w+h };
+        const double cornerX[4]   = { b.xMin(), b.xMax(), b.xMax(), b.xMin() };
+        const double cornerY[4]   = { b.yMin(), b.yMin(), b.yMax(), b.yMax() };
+
+        for( unsigned first = 0; first < runs.size(); ++first )
+        {
+            if ( runs[first].used )
+                continue;
+
+            Points ring;
+            unsigned r = first;
+            while( true )
+            {
+                Run& run = runs[r];
+                run.used = true;
+                ring.insert( ring.end(), run.points.begin(), run.points.end() );
+
+                // the next run to enter, counter-clockwise along the border:
+                unsigned next = first;
+                double best = runs[first].entry - run.exit;
+                if ( best < 0.0 ) best += perimeter;
+                for( unsigned i = 0; i < runs.size(); ++i )
+                {
+                    if ( runs[i].used ) continue;
+                    double d = runs[i].entry - run.exit;
+                    if ( d < 0.0 ) d += perimeter;
+                    if ( d < best )
+                    {
+                        best = d;
+                        next = i;
+                    }
+                }
+
+                // pick up the rectangle's corners on the way there, interpolating the
+                // elevation along the border from this run's exit to the next one's entry:
+                double z0 = run.points.back().z();
+                double z1 = runs[next].points.front().z();
+                int k0 = 0;
+                while( k0 < 4 && cornerPos[k0] <= run.exit )
+                    ++k0;
+                for( int j = 0; j < 4; ++j )
+                {
+                    int k = (k0 + j) % 4;
+                    double d = cornerPos[k] - run.exit;
+                    if ( d <= 0.0 ) d += perimeter;
+                    if ( d >= best ) break;
+                    ring.push_back( osg::Vec3d(cornerX[k], cornerY[k], best > 0.0 ? z0 + (z1-z0)*d/best : z0) );
+                }
+
+                if ( next == first )
+                    break;
+                r = next;
+            }
+
+            // runs that only trace the border close into slivers; drop them.
+            if ( ring.size() >= 3 && signedArea(ring) > 0.0 )
+                rings.push_back( ring );
+        }
+    }
+
+    // clips a polygon's outer ring and holes, adding one polygon per piece to the output.
+    void clipPolygon( const Ring* outer, const RingCollection& holes, const Bounds& b, std::vector< osg::ref_ptr<Polygon> >& output )
+    {
+        Points v;
+        wind( outer, true, v );
+        if ( v.size() < 3 )
+            return;
+
+        std::vector<Run> runs;
+        cutRuns( v, b, runs );
+
+        // holes that cross the border take part in the stitching. Of the rest, the ones
+        // inside the rectangle get handed to whichever piece surrounds them.
+        std::vector<Points> innerHoles;
+        bool holeCoversCenter = false;
+        Points hv;
+        for( RingCollection::const_iterator h = holes.begin(); h != holes.end(); ++h )
+        {
+            wind( h->get(), false, hv );
+            if ( hv.size() < 3 )
+                continue;
+
+            if ( inside(hv, b) )
+            {
+                innerHoles.push_back( hv );
+            }
+            else
+            {
+                unsigned before = runs.size();
+                cutRuns( hv, b, runs );
+                if ( runs.size() == before && h->get()->contains2D(b.center2d().x(), b.center2d().y()) )
+                    holeCoversCenter = true;
+            }
+        }
+
+        std::vector<Points> rings;
+        if ( !runs.empty() )
+        {
+            stitchRuns( runs, b, rings );
+        }
+        else if ( !holeCoversCenter && outer->contains2D(b.center2d().x(), b.center2d().y()) )
+        {
+            // nothing crosses the border and the polygon surrounds the rectangle:
+            Points rect;
+            rect.push_back( osg::Vec3d(b.xMin(), b.yMin(), zAt(v, b.xMin(), b.yMin())) );
+            rect.push_back( osg::Vec3d(b.xMax(), b.yMin(), zAt(v, b.xMax(), b.yMin())) );
+            rect.push_back( osg::Vec3d(b.xMax(), b.yMax(), zAt(v, b.xMax(), b.yMax())) );
+            rect.push_back( osg::Vec3d(b.xMin(), b.yMax(), zAt(v, b.xMin(), b.yMax())) );
+            rings.push_back( rect );
+        }
+
+        unsigned first = output.size();
+        for( std::vector<Points>::const_iterator i = rings.begin(); i != rings.end(); ++i )
+        {
+            Polygon* poly = new Polygon();
+            poly->insert( poly->end(), i->begin(), i->end() );
+            output.push_back( poly );
+        }
+
+        for( std::vector<Points>::const_iterator h = innerHoles.begin(); h != innerHoles.end(); ++h )
+        {
+            bool placed = false;
+            for( Points::const_iterator p = h->begin(); p != h->end() && !placed; ++p )
+            {
+                for( unsigned i = first; i < output.size() && !placed; ++i )
+                {
+                    if ( output[i]->contains2D(p->x(), p->y()) )
+                    {
+                        Ring* hole = new Ring();
+                        hole->insert( hole->end(), h->begin(), h->end() );
+                        output[i]->getHoles().push_back( hole );
+                        placed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    void cropPart( const Geometry* part, const Bounds& b, GeometryCollection& output )
+    {
+        switch( part->getType() )
+        {
+        case Geometry::TYPE_POINTSET:
+            {
+                osg::ref_ptr<PointSet> points = new PointSet();
+                for( Geometry::const_iterator i = part->begin(); i != part->end(); ++i )
+                    if ( b.contains(i->x(), i->y()) )
+                        points->push_back( *i );
+                if ( points->isValid() )
+                    output.push_back( points.get() );
+            }
+            break;
+
+        case Geometry::TYPE_LINESTRING:
+            clipLine( part, b, output );
+            break;
+
+        case Geometry::TYPE_RING:
+        case Geometry::TYPE_POLYGON:
+            {
+                const Ring* input = static_cast<const Ring*>( part );
+                Bounds partBounds = input->getBounds();
+                if (partBounds.xMin() >= b.xMin() && partBounds.xMax() <= b.xMax() &&
+                    partBounds.yMin() >= b.yMin() && partBounds.yMax() <= b.yMax() )
+                {
+                    if ( input->isValid() )
+                        output.push_back( static_cast<Geometry*>( input->clone(osg::CopyOp::DEEP_COPY_ALL) ) );
+                    break;
+                }
+
+                bool isPolygon = part->getType() == Geometry::TYPE_POLYGON;
+                std::vector< osg::ref_ptr<Polygon> > pieces;
+                clipPolygon( input, isPolygon ? static_cast<const Polygon*>(part)->getHoles() : RingCollection(), b, pieces );
+
+                for( std::vector< osg::ref_ptr<Polygon> >::iterator i = pieces.begin(); i != pieces.end(); ++i )
+                {
+                    if ( isPolygon )
+                        output.push_back( i->get() );
+                    else
+                        output.push_back( new Ring( i->get() ) );
+                }
+            }
+            break;
+
+        case Geometry::TYPE_MULTI:
+            {
+                const GeometryCollection& parts = static_cast<const MultiGeometry*>( part )->getComponents();
+                for( GeometryCollection::const_iterator i = parts.begin(); i != parts.end(); ++i )
+                    cropPart( i->get(), b, output );
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+bool
+Geometry::crop( const Bounds& bounds, osg::ref_ptr<Geometry>& output ) const
+{
+    output = 0L;
+
+    // trivial accept and reject:
+    Bounds myBounds = getBounds();
+    if (myBounds.xMin() >= bounds.xMin() && myBounds.xMax() <= bounds.xMax() &&
+        myBounds.yMin() >= bounds.yMin() && myBounds.yMax() <= bounds.yMax() )
+    {
+        if ( isValid() )
+            output = static_cast<Geometry*>( clone(osg::CopyOp::DEEP_COPY_ALL) );
+        return output.valid();
+    }
+
+    if (myBounds.xMin() > bounds.xMax() || myBounds.xMax() < bounds.xMin() ||
+        myBounds.yMin() > bounds.yMax() || myBounds.yMax() < bounds.yMin() )
+    {
+        return false;
+    }
+
+    GeometryCollection parts;
+    cropPart( this, bounds, parts );
+
+    if ( parts.size() == 1 )
+        output = parts.front().get();
+    else if ( parts.size() > 1 )
+        output = new MultiGeometry( parts );
+
+    return output.valid();
+}
+
 bool
 Geometry::difference( const Polygon* diffPolygon, osg::ref_ptr<Geometry>& output ) const
 {
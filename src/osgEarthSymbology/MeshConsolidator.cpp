@@ -20,8 +20,13 @@
 #include <osgEarthSymbology/LineFunctor>
 #include <osg/TriangleFunctor>
 #include <osg/TriangleIndexFunctor>
+#include <osg/Notify>
+#include <algorithm>
 #include <limits>
 #include <map>
+#include <vector>
+#include <math.h>
+#include <string.h>
 
 #define LC "[MeshConsolidator] "
 
@@ -306,3 +311,564 @@ MeshConsolidator::run( osg::Geode& geode )
     geode.removeDrawables( 0, geode.getNumDrawables() );
     geode.addDrawable( newGeom );
 }
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // gathers the triangle indices of a geometry into a single list.
+    struct TriangleGatherer
+    {
+        std::vector<unsigned>* _indices;
+
+        void operator()( unsigned i0, unsigned i1, unsigned i2 )
+        {
+            _indices->push_back( i0 );
+            _indices->push_back( i1 );
+            _indices->push_back( i2 );
+        }
+    };
+
+    void
+    s_gatherTriangles( const osg::Geometry& geom, std::vector<unsigned>& out_indices )
+    {
+        osg::TriangleIndexFunctor<TriangleGatherer> gatherer;
+        gatherer._indices = &out_indices;
+        geom.accept( gatherer );
+    }
+
+    // average cache miss ratio of an index list for a FIFO cache.
+    double
+    s_computeACMR( const std::vector<unsigned>& indices, unsigned numVerts, unsigned cacheSize )
+    {
+        if ( indices.size() < 3 )
+            return 0.0;
+
+        // a vertex is in the cache if it was one of the last "cacheSize" vertices to miss.
+        std::vector<int> missedAt( numVerts, -(int)cacheSize - 1 );
+        int misses = 0;
+        for( std::vector<unsigned>::const_iterator i = indices.begin(); i != indices.end(); ++i )
+        {
+            if ( misses - missedAt[*i] > (int)cacheSize )
+            {
+                missedAt[*i] = misses++;
+            }
+        }
+
+        return (double)misses / (double)(indices.size()/3);
+    }
+
+    // the arrays that hold one element per vertex, and so must be welded and reordered.
+    struct PerVertexArrays
+    {
+        std::vector<osg::Array*>      _arrays;
+        std::vector<unsigned>         _elementSizes;
+        std::vector<const unsigned char*> _data;
+
+        void add( osg::Array* array )
+        {
+            _arrays.push_back( array );
+            _elementSizes.push_back( array->getTotalDataSize() / array->getNumElements() );
+            _data.push_back( static_cast<const unsigned char*>(array->getDataPointer()) );
+        }
+
+        unsigned hash( unsigned v ) const
+        {
+            // FNV-1a
+            unsigned h = 2166136261u;
+            for( unsigned a=0; a<_arrays.size(); ++a )
+            {
+                const unsigned char* p = _data[a] + v*_elementSizes[a];
+                for( unsigned b=0; b<_elementSizes[a]; ++b )
+                    h = (h ^ p[b]) * 16777619u;
+            }
+            return h;
+        }
+
+        bool equal( unsigned v0, unsigned v1 ) const
+        {
+            for( unsigned a=0; a<_arrays.size(); ++a )
+            {
+                if ( memcmp( _data[a] + v0*_elementSizes[a], _data[a] + v1*_elementSizes[a], _elementSizes[a] ) != 0 )
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    bool
+    s_perVertexBinding( osg::Geometry::AttributeBinding binding, bool& out_ok )
+    {
+        if (binding == osg::Geometry::BIND_PER_PRIMITIVE ||
+            binding == osg::Geometry::BIND_PER_PRIMITIVE_SET )
+        {
+            out_ok = false;
+        }
+        return binding == osg::Geometry::BIND_PER_VERTEX;
+    }
+
+    // collects the per-vertex arrays; returns false if the geometry can't be reordered.
+    bool
+    s_getPerVertexArrays( osg::Geometry& geom, PerVertexArrays& out )
+    {
+        if (geom.getVertexIndices() || geom.getNormalIndices() || geom.getColorIndices() ||
+            geom.getSecondaryColorIndices() || geom.getFogCoordIndices() )
+        {
+            return false;
+        }
+
+        osg::Array* verts = geom.getVertexArray();
+        if ( !verts || verts->getNumElements() == 0 )
+            return false;
+
+        unsigned numVerts = verts->getNumElements();
+        bool ok = true;
+
+        out.add( verts );
+
+        if ( geom.getNormalArray() && s_perVertexBinding(geom.getNormalBinding(), ok) )
+            out.add( geom.getNormalArray() );
+
+        if ( geom.getColorArray() && s_perVertexBinding(geom.getColorBinding(), ok) )
+            out.add( geom.getColorArray() );
+
+        if ( geom.getSecondaryColorArray() && s_perVertexBinding(geom.getSecondaryColorBinding(), ok) )
+            out.add( geom.getSecondaryColorArray() );
+
+        if ( geom.getFogCoordArray() && s_perVertexBinding(geom.getFogCoordBinding(), ok) )
+            out.add( geom.getFogCoordArray() );
+
+        for( unsigned i=0; i<geom.getNumTexCoordArrays(); ++i )
+        {
+            if ( geom.getTexCoordIndices(i) )
+                return false;
+            if ( geom.getTexCoordArray(i) )
+                out.add( geom.getTexCoordArray(i) );
+        }
+
+        for( unsigned i=0; i<geom.getNumVertexAttribArrays(); ++i )
+        {
+            if ( geom.getVertexAttribIndices(i) )
+                return false;
+            if ( geom.getVertexAttribArray(i) && s_perVertexBinding(geom.getVertexAttribBinding(i), ok) )
+                out.add( geom.getVertexAttribArray(i) );
+        }
+
+        for( unsigned i=0; ok && i<out._arrays.size(); ++i )
+        {
+            if ( out._arrays[i]->getNumElements() != numVerts || out._elementSizes[i] == 0 )
+                ok = false;
+        }
+
+        return ok;
+    }
+
+    // rewrites an array so that element i is the old element newToOld[i].
+    // In a dry run it only checks that every array has a typed overload below;
+    // ArrayVisitor's own typed overloads are empty, so any type we don't list
+    // (including ones added by newer OSG versions) is caught by _handled.
+    struct RemapArray : public osg::ArrayVisitor
+    {
+        RemapArray( const std::vector<unsigned>& newToOld, bool dryRun ) 
+            : _newToOld(newToOld), _dryRun(dryRun), _ok(true), _handled(false) { }
+
+        bool canRemap( osg::Array& array )
+        {
+            _handled = false;
+            array.accept( *this );
+            return _ok && _handled;
+        }
+
+        template<class ARRAY>
+        void remap( ARRAY& array )
+        {
+            _handled = true;
+            if ( _dryRun )
+                return;
+
+            std::vector<typename ARRAY::ElementDataType> old( array.begin(), array.end() );
+            array.resize( _newToOld.size() );
+            for( unsigned i=0; i<_newToOld.size(); ++i )
+                array[i] = old[_newToOld[i]];
+            array.dirty();
+        }
+
+        virtual void apply( osg::Array& )            { _ok = false; }
+        virtual void apply( osg::ByteArray& a )      { remap(a); }
+        virtual void apply( osg::ShortArray& a )     { remap(a); }
+        virtual void apply( osg::IntArray& a )       { remap(a); }
+        virtual void apply( osg::UByteArray& a )     { remap(a); }
+        virtual void apply( osg::UShortArray& a )    { remap(a); }
+        virtual void apply( osg::UIntArray& a )      { remap(a); }
+        virtual void apply( osg::FloatArray& a )     { remap(a); }
+        virtual void apply( osg::DoubleArray& a )    { remap(a); }
+        virtual void apply( osg::Vec2bArray& a )     { remap(a); }
+        virtual void apply( osg::Vec3bArray& a )     { remap(a); }
+        virtual void apply( osg::Vec4bArray& a )     { remap(a); }
+        virtual void apply( osg::Vec2sArray& a )     { remap(a); }
+        virtual void apply( osg::Vec3sArray& a )     { remap(a); }
+        virtual void apply( osg::Vec4sArray& a )     { remap(a); }
+        virtual void apply( osg::Vec2Array& a )      { remap(a); }
+        virtual void apply( osg::Vec3Array& a )      { remap(a); }
+        virtual void apply( osg::Vec4Array& a )      { remap(a); }
+#if OSG_MIN_VERSION_REQUIRED(3,1,0)
+        virtual void apply( osg::Vec2ubArray& a )    { remap(a); }
+        virtual void apply( osg::Vec3ubArray& a )    { remap(a); }
+#endif
+        virtual void apply( osg::Vec4ubArray& a )    { remap(a); }
+        virtual void apply( osg::Vec2dArray& a )     { remap(a); }
+        virtual void apply( osg::Vec3dArray& a )     { remap(a); }
+        virtual void apply( osg::Vec4dArray& a )     { remap(a); }
+
+        const std::vector<unsigned>& _newToOld;
+        bool _dryRun;
+        bool _ok;
+        bool _handled;
+    };
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006).
+    const int   FORSYTH_CACHE_SIZE  = 32;
+    const float CACHE_DECAY_POWER   = 1.5f;
+    const float LAST_TRI_SCORE      = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    float
+    s_vertexScore( int cachePos, unsigned remainingTris )
+    {
+        if ( remainingTris == 0 )
+            return -1.0f;
+
+        float score = 0.0f;
+        if ( cachePos >= 0 )
+        {
+            if ( cachePos < 3 )
+            {
+                // the verts of the last triangle get a fixed score, so we don't favor
+                // one of them over the others.
+                score = LAST_TRI_SCORE;
+            }
+            else
+            {
+                const float scaler = 1.0f / (float)(FORSYTH_CACHE_SIZE - 3);
+                score = powf( 1.0f - (float)(cachePos - 3) * scaler, CACHE_DECAY_POWER );
+            }
+        }
+
+        // boost verts with few remaining triangles, to get rid of lone triangles.
+        score += VALENCE_BOOST_SCALE * powf( (float)remainingTris, -VALENCE_BOOST_POWER );
+        return score;
+    }
+
+    void
+    s_forsythReorder( std::vector<unsigned>& indices, unsigned numVerts )
+    {
+        const unsigned numTris = indices.size() / 3;
+        if ( numTris < 2 )
+            return;
+
+        // vertex -> triangle adjacency; the first remaining[v] entries of each vertex's
+        // span are its triangles that haven't been emitted yet.
+        std::vector<unsigned> remaining( numVerts, 0 );
+        for( unsigned i=0; i<indices.size(); ++i )
+            remaining[indices[i]]++;
+
+        std::vector<unsigned> offsets( numVerts+1, 0 );
+        for( unsigned v=0; v<numVerts; ++v )
+            offsets[v+1] = offsets[v] + remaining[v];
+
+        std::vector<unsigned> adjacency( indices.size() );
+        {
+            std::vector<unsigned> fill( offsets.begin(), offsets.end()-1 );
+            for( unsigned t=0; t<numTris; ++t )
+                for( unsigned k=0; k<3; ++k )
+                    adjacency[fill[indices[3*t+k]]++] = t;
+        }
+
+        std::vector<int>   cachePos( numVerts, -1 );
+        std::vector<float> vertScore( numVerts );
+        for( unsigned v=0; v<numVerts; ++v )
+            vertScore[v] = s_vertexScore( -1, remaining[v] );
+
+        std::vector<float> triScore( numTris );
+        std::vector<bool>  emitted( numTris, false );
+        int bestTri = 0;
+        for( unsigned t=0; t<numTris; ++t )
+        {
+            triScore[t] = vertScore[indices[3*t]] + vertScore[indices[3*t+1]] + vertScore[indices[3*t+2]];
+            if ( triScore[t] > triScore[bestTri] )
+                bestTri = t;
+        }
+
+        std::vector<unsigned> output;
+        output.reserve( indices.size() );
+
+        std::vector<unsigned> cache, newCache;
+        cache.reserve( FORSYTH_CACHE_SIZE + 3 );
+        newCache.reserve( FORSYTH_CACHE_SIZE + 3 );
+
+        unsigned scanCursor = 0;
+
+        for( unsigned n=0; n<numTris; ++n )
+        {
+            // nothing in the cache is useful; take the next triangle in input order.
+            if ( bestTri < 0 )
+            {
+                while( emitted[scanCursor] )
+                    ++scanCursor;
+                bestTri = scanCursor;
+            }
+
+            emitted[bestTri] = true;
+
+            // emit the triangle, and remove it from its vertices' remaining lists.
+            newCache.clear();
+            for( unsigned k=0; k<3; ++k )
+            {
+                unsigned v = indices[3*bestTri+k];
+                output.push_back( v );
+                newCache.push_back( v );
+
+                unsigned* tris = &adjacency[offsets[v]];
+                for( unsigned j=0; j<remaining[v]; ++j )
+                {
+                    if ( tris[j] == (unsigned)bestTri )
+                    {
+                        tris[j] = tris[remaining[v]-1];
+                        break;
+                    }
+                }
+                remaining[v]--;
+            }
+
+            // the triangle's verts move to the front of the cache (LRU).
+            for( unsigned i=0; i<cache.size(); ++i )
+            {
+                if ( std::find( newCache.begin(), newCache.begin()+3, cache[i] ) == newCache.begin()+3 )
+                    newCache.push_back( cache[i] );
+            }
+
+            // rescore everything that was in the cache, including verts that just fell out.
+            for( unsigned i=0; i<newCache.size(); ++i )
+            {
+                unsigned v = newCache[i];
+                cachePos[v] = i < (unsigned)FORSYTH_CACHE_SIZE ? (int)i : -1;
+                vertScore[v] = s_vertexScore( cachePos[v], remaining[v] );
+            }
+
+            // rescore the affected triangles, and pick the best one to go next.
+            bestTri = -1;
+            float bestScore = -1.0f;
+            for( unsigned i=0; i<newCache.size(); ++i )
+            {
+                unsigned v = newCache[i];
+                const unsigned* tris = &adjacency[offsets[v]];
+                for( unsigned j=0; j<remaining[v]; ++j )
+                {
+                    unsigned t = tris[j];
+                    triScore[t] = vertScore[indices[3*t]] + vertScore[indices[3*t+1]] + vertScore[indices[3*t+2]];
+                    if ( triScore[t] > bestScore )
+                    {
+                        bestScore = triScore[t];
+                        bestTri = t;
+                    }
+                }
+            }
+
+            if ( newCache.size() > (unsigned)FORSYTH_CACHE_SIZE )
+                newCache.resize( FORSYTH_CACHE_SIZE );
+            cache.swap( newCache );
+        }
+
+        indices.swap( output );
+    }
+
+    template<typename T>
+    T* s_makeDrawElements( const std::vector<unsigned>& indices )
+    {
+        T* de = new T( GL_TRIANGLES );
+        de->reserve( indices.size() );
+        for( std::vector<unsigned>::const_iterator i = indices.begin(); i != indices.end(); ++i )
+            de->push_back( *i );
+        return de;
+    }
+}
+
+bool
+MeshConsolidator::optimize( osg::Geometry& geom, Stats* out_stats )
+{
+    // start by consolidating into triangles.
+    run( geom );
+
+    // we can only reorder the verts if everything refers to them by index.
+    for( unsigned i=0; i<geom.getNumPrimitiveSets(); ++i )
+    {
+        if ( geom.getPrimitiveSet(i)->getMode() != osg::PrimitiveSet::TRIANGLES )
+            return false;
+    }
+
+    PerVertexArrays arrays;
+    if ( !s_getPerVertexArrays(geom, arrays) )
+        return false;
+
+    std::vector<unsigned> newToOld;
+    RemapArray check( newToOld, true );
+    for( unsigned a=0; a<arrays._arrays.size(); ++a )
+    {
+        if ( !check.canRemap( *arrays._arrays[a] ) )
+            return false;
+    }
+
+    const unsigned numVerts = arrays._arrays[0]->getNumElements();
+
+    std::vector<unsigned> indices;
+    indices.reserve( numVerts * 2 );
+    s_gatherTriangles( geom, indices );
+    if ( indices.size() < 3 )
+        return false;
+
+    double acmrBefore = s_computeACMR( indices, numVerts, 16 );
+
+    // weld identical vertices with a hash table (chained through "next").
+    {
+        unsigned tableSize = 1;
+        while( tableSize < numVerts*2 )
+            tableSize <<= 1;
+
+        std::vector<int>      heads( tableSize, -1 );
+        std::vector<int>      next( numVerts, -1 );
+        std::vector<unsigned> weld( numVerts );
+
+        for( unsigned v=0; v<numVerts; ++v )
+        {
+            unsigned bucket = arrays.hash(v) & (tableSize-1);
+            int match = heads[bucket];
+            while( match >= 0 && !arrays.equal((unsigned)match, v) )
+                match = next[match];
+
+            if ( match >= 0 )
+            {
+                weld[v] = match;
+            }
+            else
+            {
+                weld[v] = v;
+                next[v] = heads[bucket];
+                heads[bucket] = v;
+            }
+        }
+
+        // welding can collapse triangles; drop them.
+        unsigned out = 0;
+        for( unsigned i=0; i+2<indices.size(); i += 3 )
+        {
+            unsigned i0 = weld[indices[i]], i1 = weld[indices[i+1]], i2 = weld[indices[i+2]];
+            if ( i0 != i1 && i1 != i2 && i0 != i2 )
+            {
+                indices[out++] = i0;
+                indices[out++] = i1;
+                indices[out++] = i2;
+            }
+        }
+        indices.resize( out );
+        if ( indices.empty() )
+            return false;
+    }
+
+    // order the triangles for the post-transform cache:
+    s_forsythReorder( indices, numVerts );
+
+    // then number the verts in the order they're first used, for the pre-transform
+    // cache. This also drops the welded and unreferenced verts.
+    std::vector<int> oldToNew( numVerts, -1 );
+    newToOld.reserve( numVerts );
+    for( unsigned i=0; i<indices.size(); ++i )
+    {
+        unsigned v = indices[i];
+        if ( oldToNew[v] < 0 )
+        {
+            oldToNew[v] = newToOld.size();
+            newToOld.push_back( v );
+        }
+        indices[i] = oldToNew[v];
+    }
+
+    RemapArray remap( newToOld, false );
+    for( unsigned a=0; a<arrays._arrays.size(); ++a )
+        arrays._arrays[a]->accept( remap );
+
+    // and rebuild the primitive set, with the smallest practical index type.
+    // (8-bit indices are not natively supported by most GPUs, so we don't use them.)
+    geom.removePrimitiveSet( 0, geom.getNumPrimitiveSets() );
+    if ( newToOld.size() <= 0x10000 )
+        geom.addPrimitiveSet( s_makeDrawElements<osg::DrawElementsUShort>(indices) );
+    else
+        geom.addPrimitiveSet( s_makeDrawElements<osg::DrawElementsUInt>(indices) );
+    geom.dirtyDisplayList();
+    geom.dirtyBound();
+
+    double acmrAfter = s_computeACMR( indices, newToOld.size(), 16 );
+
+    OE_DEBUG << LC << "Optimized " << indices.size()/3 << " triangles: verts "
+        << numVerts << " -> " << newToOld.size() << ", ACMR "
+        << acmrBefore << " -> " << acmrAfter << std::endl;
+
+    if ( out_stats )
+    {
+        out_stats->_acmrBefore  = acmrBefore;
+        out_stats->_acmrAfter   = acmrAfter;
+        out_stats->_vertsBefore = numVerts;
+        out_stats->_vertsAfter  = newToOld.size();
+        out_stats->_numTriangles = indices.size()/3;
+    }
+
+    return true;
+}
+
+void
+MeshConsolidator::optimize( osg::Geode& geode, Stats* out_stats )
+{
+    // accumulate triangle-weighted figures across all the geometries.
+    double missesBefore = 0.0, missesAfter = 0.0;
+    unsigned numTris = 0, vertsBefore = 0, vertsAfter = 0;
+
+    for( unsigned i=0; i<geode.getNumDrawables(); ++i )
+    {
+        osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
+        if ( geom )
+        {
+            Stats stats;
+            if ( optimize(*geom, &stats) )
+            {
+                unsigned tris = stats._numTriangles;
+
+                missesBefore += stats._acmrBefore * tris;
+                missesAfter  += stats._acmrAfter * tris;
+                numTris      += tris;
+                vertsBefore  += stats._vertsBefore;
+                vertsAfter   += stats._vertsAfter;
+            }
+        }
+    }
+
+    if ( out_stats && numTris > 0 )
+    {
+        out_stats->_acmrBefore  = missesBefore / numTris;
+        out_stats->_acmrAfter   = missesAfter / numTris;
+        out_stats->_vertsBefore = vertsBefore;
+        out_stats->_vertsAfter  = vertsAfter;
+        out_stats->_numTriangles = numTris;
+    }
+}
+
+double
+MeshConsolidator::computeACMR( const osg::Geometry& geom, unsigned cacheSize )
+{
+    const osg::Array* verts = geom.getVertexArray();
+    if ( !verts )
+        return 0.0;
+
+    std::vector<unsigned> indices;
+    s_gatherTriangles( geom, indices );
+    return s_computeACMR( indices, verts->getNumElements(), cacheSize );
+}
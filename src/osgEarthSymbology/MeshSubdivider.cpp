@@ -22,9 +22,11 @@
 #include <osg/TriangleFunctor>
 #include <osg/TriangleIndexFunctor>
 //#include <osgUtil/MeshOptimizers>
+#include <algorithm>
 #include <climits>
 #include <queue>
 #include <map>
+#include <vector>
 
 #define LC "[MeshSubdivider] "
 
@@ -115,9 +117,7 @@ namespace
         GLuint _i0, _i1, _i2;        
     };
 
-    typedef std::queue<Triangle> TriangleQueue;
     typedef std::vector<Triangle> TriangleVector;
-    
 
     struct TriangleData
     {
@@ -127,7 +127,7 @@ namespace
         osg::Vec2Array* _sourceTexCoords;
         osg::ref_ptr<osg::Vec3Array> _verts;        
         osg::ref_ptr<osg::Vec2Array> _texcoords;
-        TriangleQueue _tris;
+        TriangleVector _tris;
         
         TriangleData()
         {            
@@ -144,7 +144,8 @@ namespace
         void setSourceTexCoords(osg::Vec2Array* sourceTexCoords)
         {
             _sourceTexCoords = sourceTexCoords;
-            _texcoords = new osg::Vec2Array();
+            if ( sourceTexCoords )
+                _texcoords = new osg::Vec2Array();
         }
 
         GLuint record( const osg::Vec3& v, const osg::Vec2f& t )
@@ -156,7 +157,7 @@ namespace
                 _verts->push_back(v);                
                 _vertMap[v] = index;
                 //Only push back the texture coordinate if it's valid
-                if (_texcoords)
+                if (_texcoords.valid())
                 {
                   _texcoords->push_back( t );
                 }
@@ -181,67 +182,113 @@ namespace
                 t1 = (*_sourceTexCoords)[p2];
                 t2 = (*_sourceTexCoords)[p3];
             }
-            _tris.push( Triangle(record(v0, t0), record(v1, t1), record(v2, t2)) );            
-            //OE_NOTICE << "Incoming verts " << p1 << ", " << p2 << ", " << p3 << std::endl;
+            _tris.push_back( Triangle(record(v0, t0), record(v1, t1), record(v2, t2)) );            
         }
     };      
 
-    struct Edge
-    {
-        Edge() { }
-        Edge( GLuint i0, GLuint i1 ) : _i0(i0), _i1(i1) { }
-        GLuint _i0, _i1;
-        bool operator < (const Edge& rhs) const {
-            return
-                _i0 < rhs._i0 ? true :
-                _i0 > rhs._i0 ? false :
-                _i1 < rhs._i1 ? true :
-                _i1 > rhs._i1 ? false :
-                false;
-        }
-        bool operator == (const Edge& rhs) const { return _i0==rhs._i0 && _i1==rhs._i1; }
-    };
-
-    typedef std::map<Edge,GLuint> EdgeMap;
-    
     /**
-     * Populates the geometry object with a collection of index elements primitives.
+     * Maps an undirected edge to the index of its midpoint vertex, so that edges
+     * shared by two triangles are only split once. Open addressing over flat
+     * arrays, so lookups don't allocate.
      */
-    template<typename ETYPE, typename VTYPE>
-    void populateTriangles( osg::Geometry& geom, const TriangleVector& tris, unsigned int maxElementsPerEBO )
+    struct EdgeCache
     {
-        unsigned int totalTris = tris.size();
-        unsigned int totalTrisWritten = 0;
-        unsigned int numElementsInCurrentEBO = maxElementsPerEBO;
+        typedef unsigned long long Key;
 
-        ETYPE* ebo = 0L;
+        std::vector<Key>    _keys;
+        std::vector<GLuint> _values;
+        unsigned            _mask;
+        unsigned            _count;
 
-        for( TriangleVector::const_iterator i = tris.begin(); i != tris.end(); ++i )
+        EdgeCache( unsigned expectedEdges )
+            : _count( 0 )
         {
-            if ( numElementsInCurrentEBO+2 >= maxElementsPerEBO )
-            {
-                if ( ebo )
-                {
-                    geom.addPrimitiveSet( ebo );
-                }
+            unsigned size = 64;
+            while( size < expectedEdges*2 )
+                size <<= 1;
+            _keys.assign( size, empty() );
+            _values.resize( size );
+            _mask = size-1;
+        }
 
-                ebo = new ETYPE( GL_TRIANGLES );
+        static Key empty() { return ~Key(0); }
 
-                unsigned int trisRemaining = totalTris - totalTrisWritten;
-                ebo->reserve( osg::minimum( trisRemaining*3, maxElementsPerEBO ) );
+        static Key makeKey( GLuint i0, GLuint i1 ) {
+            return i0 < i1 ? (Key(i0) << 32) | Key(i1) : (Key(i1) << 32) | Key(i0); }
 
-                numElementsInCurrentEBO = 0;
+        static unsigned hash( Key k ) {
+            return (unsigned)(k >> 32) * 73856093u ^ (unsigned)(k & 0xffffffff) * 19349663u; }
+
+        // returns the midpoint index, or UINT_MAX if the edge hasn't been split.
+        GLuint find( GLuint i0, GLuint i1 ) const
+        {
+            Key k = makeKey(i0, i1);
+            for( unsigned slot = hash(k) & _mask; _keys[slot] != empty(); slot = (slot+1) & _mask )
+            {
+                if ( _keys[slot] == k )
+                    return _values[slot];
             }
-            ebo->push_back( static_cast<VTYPE>( i->_i0 ) );
-            ebo->push_back( static_cast<VTYPE>( i->_i1 ) );
-            ebo->push_back( static_cast<VTYPE>( i->_i2 ) );
+            return UINT_MAX;
+        }
 
-            numElementsInCurrentEBO += 3;
-            ++totalTrisWritten;
+        void insert( GLuint i0, GLuint i1, GLuint mid )
+        {
+            if ( (_count+1)*2 > _keys.size() )
+                grow();
+
+            Key k = makeKey(i0, i1);
+            unsigned slot = hash(k) & _mask;
+            while( _keys[slot] != empty() )
+                slot = (slot+1) & _mask;
+
+            _keys[slot] = k;
+            _values[slot] = mid;
+            ++_count;
         }
 
-        if ( ebo && ebo->size() > 0 )
+        void grow()
+        {
+            std::vector<Key>    oldKeys;
+            std::vector<GLuint> oldValues;
+            oldKeys.swap( _keys );
+            oldValues.swap( _values );
+
+            _keys.assign( oldKeys.size()*2, empty() );
+            _values.resize( oldKeys.size()*2 );
+            _mask = _keys.size()-1;
+
+            for( unsigned i=0; i<oldKeys.size(); ++i )
+            {
+                if ( oldKeys[i] != empty() )
+                {
+                    unsigned slot = hash(oldKeys[i]) & _mask;
+                    while( _keys[slot] != empty() )
+                        slot = (slot+1) & _mask;
+                    _keys[slot] = oldKeys[i];
+                    _values[slot] = oldValues[i];
+                }
+            }
+        }
+    };
+    
+    /**
+     * Populates the geometry object with a collection of index elements primitives.
+     */
+    template<typename ETYPE, typename VTYPE>
+    void populateTriangles( osg::Geometry& geom, const std::vector<GLuint>& indices, unsigned int maxElementsPerEBO )
+    {
+        // round the chunk size down to whole triangles.
+        unsigned int chunkSize = osg::maximum( maxElementsPerEBO - maxElementsPerEBO % 3, 3u );
+
+        for( unsigned int start = 0; start < indices.size(); start += chunkSize )
         {
+            unsigned int end = osg::minimum( start + chunkSize, (unsigned int)indices.size() );
+
+            ETYPE* ebo = new ETYPE( GL_TRIANGLES );
+            ebo->reserve( end - start );
+            for( unsigned int i = start; i < end; ++i )
+                ebo->push_back( static_cast<VTYPE>( indices[i] ) );
+
             geom.addPrimitiveSet( ebo );
         }
     }
@@ -419,111 +466,115 @@ namespace
         const osg::Matrixd& L2W, // local=>world xform
         unsigned int maxElementsPerEBO )
     {
-        
-        // collect all the triangled in the geometry.
-        osg::TriangleIndexFunctor<TriangleData> data;;
-        data.setSourceVerts(dynamic_cast<osg::Vec3Array*>(geom.getVertexArray()));
+        osg::Vec3Array* sourceVerts = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
+        if ( !sourceVerts )
+            return;
+
+        // collect all the triangles in the geometry.
+        osg::TriangleIndexFunctor<TriangleData> data;
+        data.setSourceVerts( sourceVerts );
         data.setSourceTexCoords(dynamic_cast<osg::Vec2Array*>(geom.getTexCoordArray(0)));
         geom.accept( data );
 
-        
-        int numTrisIn = data._tris.size();        
+        if ( data._tris.size() == 0 )
+            return;
 
-        TriangleVector done;
-        done.reserve(2.0 * data._tris.size());
+        osg::Vec3Array* verts     = data._verts.get();
+        osg::Vec2Array* texcoords = data._texcoords.get();
 
-        // Used to make sure shared edges are not split more than once.
-        EdgeMap edges;
+        // An edge needs splitting when the angle between its endpoints exceeds the
+        // granularity; comparing dot products of the unit vectors avoids the acos.
+        const double minDot = cos( granularity );
+
+        // world-space position and unit vector for each vertex, computed once.
+        std::vector<osg::Vec3d> world, unit;
 
-        // Subdivide triangles until we run out
-        while( data._tris.size() > 0 )
+        // Estimate the output size so we can allocate everything up front: splitting
+        // an edge spanning N granules takes about N*N triangles.
+        double estTrisd = 0.0;
         {
-            Triangle tri = data._tris.front();
-            data._tris.pop();
+            world.reserve( verts->size() );
+            unit.reserve( verts->size() );
+            for( unsigned int i=0; i<verts->size(); ++i )
+            {
+                world.push_back( (*verts)[i] * L2W );
+                unit.push_back( world.back() );
+                unit.back().normalize();
+            }
 
-            osg::Vec3d v0_w = (*data._verts)[tri._i0] * L2W;
-            osg::Vec3d v1_w = (*data._verts)[tri._i1] * L2W;
-            osg::Vec3d v2_w = (*data._verts)[tri._i2] * L2W;
+            for( TriangleVector::const_iterator t = data._tris.begin(); t != data._tris.end(); ++t )
+            {
+                double d = osg::minimum( unit[t->_i0] * unit[t->_i1], 
+                           osg::minimum( unit[t->_i1] * unit[t->_i2], unit[t->_i2] * unit[t->_i0] ) );
+                double n = osg::maximum( 1.0, ceil( acos(osg::clampBetween(d, -1.0, 1.0)) / granularity ) );
+                estTrisd += 2.0*n*n;
+            }
+        }
 
-            osg::Vec2  t0 = (*data._texcoords)[tri._i0];
-            osg::Vec2  t1 = (*data._texcoords)[tri._i1];
-            osg::Vec2  t2 = (*data._texcoords)[tri._i2];
+        // (the estimate only sizes allocations, so keep a wild one in check)
+        unsigned int estTris = (unsigned int)osg::minimum( estTrisd, 4194304.0 );
 
-            double g0 = angleBetween(v0_w, v1_w);
-            double g1 = angleBetween(v1_w, v2_w);
-            double g2 = angleBetween(v2_w, v0_w);
-            double max = osg::maximum( g0, osg::maximum(g1, g2) );
+        unsigned int estVerts = verts->size() + estTris/2;
+        verts->reserve( estVerts );
+        if ( texcoords )
+            texcoords->reserve( estVerts );
+        world.reserve( estVerts );
+        unit.reserve( estVerts );
+
+        std::vector<GLuint> done;
+        done.reserve( 3 * estTris );
+
+        // Used to make sure shared edges are not split more than once.
+        EdgeCache edges( estVerts );
+
+        // Subdivide triangles until we run out. The work list is a stack, so each
+        // input triangle is finished before the next one starts and the output
+        // stays spatially coherent.
+        TriangleVector& work = data._tris;
+        std::reverse( work.begin(), work.end() );
+        work.reserve( work.size() + 64 );
+
+        while( !work.empty() )
+        {
+            Triangle tri = work.back();
+            work.pop_back();
 
-            if ( max > granularity )
+            double d0 = unit[tri._i0] * unit[tri._i1];
+            double d1 = unit[tri._i1] * unit[tri._i2];
+            double d2 = unit[tri._i2] * unit[tri._i0];
+            double min = osg::minimum( d0, osg::minimum(d1, d2) );
+
+            if ( min < minDot )
             {
-                if ( g0 == max )
-                {
-                    Edge edge( osg::minimum(tri._i0, tri._i1), osg::maximum(tri._i0, tri._i1) );
-                    
-                    EdgeMap::iterator ei = edges.find(edge);
-                    GLuint i;
-                    if ( ei == edges.end() )
-                    {
-                        data._verts->push_back( geocentricMidpoint(v0_w, v1_w) * W2L );
-                        data._texcoords->push_back( (t0 + t1) / 2.0f );
-                        i = data._verts->size() - 1;
-                        edges[edge] = i;
-                    }
-                    else
-                    {
-                        i = ei->second;
-                    }
-
-                    data._tris.push( Triangle(tri._i0, i, tri._i2) );
-                    data._tris.push( Triangle(i, tri._i1, tri._i2) );
-                }
-                else if ( g1 == max )
-                {
-                    Edge edge( osg::minimum(tri._i1, tri._i2), osg::maximum(tri._i1,tri._i2) );
-
-                    EdgeMap::iterator ei = edges.find(edge);
-                    GLuint i;
-                    if ( ei == edges.end() )
-                    {
-                        data._verts->push_back( geocentricMidpoint(v1_w, v2_w) * W2L );
-                        data._texcoords->push_back( (t1 + t2) / 2.0f );
-                        i = data._verts->size() - 1;
-                        edges[edge] = i;
-                    }
-                    else
-                    {
-                        i = ei->second;
-                    }
-
-                    data._tris.push( Triangle(tri._i1, i, tri._i0) );
-                    data._tris.push( Triangle(i, tri._i2, tri._i0) );
-                }
-                else if ( g2 == max )
+                // rotate the triangle so that the edge to split is (a, b).
+                GLuint a, b, c;
+                if ( d0 == min )      { a = tri._i0; b = tri._i1; c = tri._i2; }
+                else if ( d1 == min ) { a = tri._i1; b = tri._i2; c = tri._i0; }
+                else                  { a = tri._i2; b = tri._i0; c = tri._i1; }
+
+                GLuint i = edges.find( a, b );
+                if ( i == UINT_MAX )
                 {
-                    Edge edge( osg::minimum(tri._i2, tri._i0), osg::maximum(tri._i2,tri._i0) );
-
-                    EdgeMap::iterator ei = edges.find(edge);
-                    GLuint i;
-                    if ( ei == edges.end() )
-                    {
-                        data._verts->push_back( geocentricMidpoint(v2_w, v0_w) * W2L );
-                        data._texcoords->push_back( (t2 + t0) / 2.0f );
-                        i = data._verts->size() - 1;
-                        edges[edge] = i;
-                    }
-                    else
-                    {
-                        i = ei->second;
-                    }
-
-                    data._tris.push( Triangle(tri._i2, i, tri._i1) );
-                    data._tris.push( Triangle(i, tri._i0, tri._i1) );
+                    osg::Vec3d mid = geocentricMidpoint( world[a], world[b] );
+                    i = verts->size();
+                    verts->push_back( mid * W2L );
+                    if ( texcoords )
+                        texcoords->push_back( ((*texcoords)[a] + (*texcoords)[b]) * 0.5f );
+                    world.push_back( mid );
+                    unit.push_back( mid );
+                    unit.back().normalize();
+                    edges.insert( a, b, i );
                 }
+
+                work.push_back( Triangle(i, b, c) );
+                work.push_back( Triangle(a, i, c) );
             }
             else
             {
                 // triangle is small enough- put it on the "done" list.
-                done.push_back(tri);
+                done.push_back( tri._i0 );
+                done.push_back( tri._i1 );
+                done.push_back( tri._i2 );
             }
         }
 
@@ -534,13 +585,14 @@ namespace
                 geom.removePrimitiveSet( 0 );
 
             // set the new VBO.
-            geom.setVertexArray( data._verts );
+            geom.setVertexArray( verts );
 
-            geom.setTexCoordArray(0, data._texcoords );
+            if ( texcoords )
+                geom.setTexCoordArray( 0, texcoords );
 
-            if ( data._verts->size() < 256 )
+            if ( verts->size() < 256 )
                 populateTriangles<osg::DrawElementsUByte,GLubyte>( geom, done, maxElementsPerEBO );
-            else if ( data._verts->size() < 65536 )
+            else if ( verts->size() < 65536 )
                 populateTriangles<osg::DrawElementsUShort,GLushort>( geom, done, maxElementsPerEBO );
             else
                 populateTriangles<osg::DrawElementsUInt,GLuint>( geom, done, maxElementsPerEBO );
@@ -0,0 +1,491 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthSymbology/PolygonTriangulator>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+
+#define LC "[PolygonTriangulator] "
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // a contour vertex projected into the plane of the polygon.
+    struct Vert2
+    {
+        double   x, y;
+        unsigned index; // index into the geometry's vertex array
+    };
+
+    typedef std::vector<Vert2> Ring2;
+
+    inline double cross( const Vert2& a, const Vert2& b, const Vert2& c )
+    {
+        return (b.x-a.x)*(c.y-a.y) - (b.y-a.y)*(c.x-a.x);
+    }
+
+    inline bool sameSpot( const Vert2& a, const Vert2& b )
+    {
+        return a.x == b.x && a.y == b.y;
+    }
+
+    double signedArea( const Ring2& ring )
+    {
+        double a = 0.0;
+        for( unsigned i=0, j=ring.size()-1; i<ring.size(); j=i++ )
+            a += ring[j].x*ring[i].y - ring[i].x*ring[j].y;
+        return 0.5*a;
+    }
+
+    // even-odd point in polygon test.
+    bool contains( const Ring2& ring, const Vert2& p )
+    {
+        bool inside = false;
+        for( unsigned i=0, j=ring.size()-1; i<ring.size(); j=i++ )
+        {
+            if ( ((ring[i].y > p.y) != (ring[j].y > p.y)) &&
+                 (p.x < (ring[j].x-ring[i].x) * (p.y-ring[i].y) / (ring[j].y-ring[i].y) + ring[i].x) )
+            {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+
+    // point in a CCW triangle, boundary inclusive.
+    inline bool inTriangle( const Vert2& a, const Vert2& b, const Vert2& c, const Vert2& p )
+    {
+        return cross(a,b,p) >= 0.0 && cross(b,c,p) >= 0.0 && cross(c,a,p) >= 0.0;
+    }
+
+    // point in a triangle of either winding, boundary inclusive.
+    inline bool inAnyTriangle( const Vert2& a, const Vert2& b, const Vert2& c, const Vert2& p )
+    {
+        double d1 = cross(a,b,p), d2 = cross(b,c,p), d3 = cross(c,a,p);
+        bool hasNeg = d1 < 0.0 || d2 < 0.0 || d3 < 0.0;
+        bool hasPos = d1 > 0.0 || d2 > 0.0 || d3 > 0.0;
+        return !(hasNeg && hasPos);
+    }
+
+    double maxX( const Ring2& ring )
+    {
+        double x = -DBL_MAX;
+        for( unsigned i=0; i<ring.size(); ++i )
+            x = std::max( x, ring[i].x );
+        return x;
+    }
+
+    struct SortByMaxXDescending
+    {
+        bool operator()( const Ring2* lhs, const Ring2* rhs ) const
+        {
+            return maxX(*lhs) > maxX(*rhs);
+        }
+    };
+
+    /**
+     * Merges a (CW) hole into a (CCW) outer ring by cutting a zero-width bridge from
+     * the hole's rightmost vertex to a vertex of the outer ring that it can see
+     * (Eberly, "Triangulation by Ear Clipping").
+     */
+    void bridgeHole( Ring2& outer, const Ring2& hole )
+    {
+        unsigned m = 0;
+        for( unsigned i=1; i<hole.size(); ++i )
+            if ( hole[i].x > hole[m].x )
+                m = i;
+        const Vert2& M = hole[m];
+
+        // cast a ray in +x from M and find the closest outer edge it hits.
+        unsigned n = outer.size();
+        int      best  = -1;
+        double   bestX = DBL_MAX;
+        for( unsigned i=0; i<n; ++i )
+        {
+            const Vert2& a = outer[i];
+            const Vert2& b = outer[(i+1)%n];
+            if ( (a.y > M.y) == (b.y > M.y) )
+                continue;
+            double x = a.x + (M.y-a.y) * (b.x-a.x) / (b.y-a.y);
+            if ( x >= M.x && x < bestX )
+            {
+                bestX = x;
+                best  = a.x > b.x ? (int)i : (int)((i+1)%n);
+            }
+        }
+
+        if ( best < 0 )
+        {
+            // no hit (degenerate input); fall back on the nearest outer vertex.
+            double bestD = DBL_MAX;
+            for( unsigned i=0; i<n; ++i )
+            {
+                double dx = outer[i].x-M.x, dy = outer[i].y-M.y;
+                if ( dx*dx+dy*dy < bestD )
+                {
+                    bestD = dx*dx+dy*dy;
+                    best  = i;
+                }
+            }
+        }
+        else
+        {
+            // the edge endpoint may be hidden behind other outer vertices; if any fall
+            // inside the triangle (M, I, P), use the one closest in angle to the ray.
+            Vert2 I; I.x = bestX; I.y = M.y;
+            Vert2 P = outer[best];
+            double bestAngle = DBL_MAX, bestD = DBL_MAX;
+            for( unsigned i=0; i<n; ++i )
+            {
+                const Vert2& v = outer[i];
+                if ( (int)i == best || v.x < M.x || sameSpot(v, P) || !inAnyTriangle(M, I, P, v) )
+                    continue;
+                double dx = v.x-M.x, dy = v.y-M.y;
+                double angle = std::fabs( ::atan2(dy, dx) );
+                double d = dx*dx+dy*dy;
+                if ( angle < bestAngle || (angle == bestAngle && d < bestD) )
+                {
+                    bestAngle = angle;
+                    bestD     = d;
+                    best      = i;
+                }
+            }
+        }
+
+        Ring2 merged;
+        merged.reserve( n + hole.size() + 2 );
+        merged.insert( merged.end(), outer.begin(), outer.begin()+best+1 );
+        for( unsigned k=0; k<=hole.size(); ++k )
+            merged.push_back( hole[(m+k)%hole.size()] );
+        merged.push_back( outer[best] );
+        merged.insert( merged.end(), outer.begin()+best+1, outer.end() );
+        outer.swap( merged );
+    }
+
+    bool isEar( const Ring2& poly, const std::vector<unsigned>& next, unsigned p, unsigned i, unsigned q )
+    {
+        const Vert2& a = poly[p];
+        const Vert2& b = poly[i];
+        const Vert2& c = poly[q];
+        for( unsigned j = next[q]; j != p; j = next[j] )
+        {
+            const Vert2& v = poly[j];
+            // skip bridge duplicates of the ear's own corners.
+            if ( sameSpot(v,a) || sameSpot(v,b) || sameSpot(v,c) )
+                continue;
+            if ( inTriangle(a, b, c, v) )
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Clips ears off a simple CCW polygon, appending the triangles to the output.
+     */
+    template<typename DE>
+    void clipEars( const Ring2& poly, double eps, DE* out )
+    {
+        unsigned n = poly.size();
+        if ( n < 3 )
+            return;
+
+        std::vector<unsigned> prev(n), next(n);
+        for( unsigned i=0; i<n; ++i )
+        {
+            prev[i] = (i+n-1) % n;
+            next[i] = (i+1) % n;
+        }
+
+        unsigned remaining = n;
+        unsigned stall     = 0;
+        unsigned i         = 0;
+
+        while( remaining > 3 )
+        {
+            unsigned p = prev[i], q = next[i];
+            double   c = cross( poly[p], poly[i], poly[q] );
+
+            bool clip = false, emit = false;
+
+            if ( c > eps && isEar(poly, next, p, i, q) )
+            {
+                clip = emit = true;
+            }
+            else if ( stall >= remaining && c <= eps && c >= -eps )
+            {
+                // a full pass found no ear: drop collinear and duplicate vertices first.
+                clip = true;
+            }
+            else if ( stall >= 2*remaining )
+            {
+                // still stuck, so the remainder is not simple. Force progress.
+                clip = true;
+                emit = c > eps;
+            }
+
+            if ( clip )
+            {
+                if ( emit )
+                {
+                    out->push_back( poly[p].index );
+                    out->push_back( poly[i].index );
+                    out->push_back( poly[q].index );
+                }
+                next[p] = q;
+                prev[q] = p;
+                --remaining;
+                stall = 0;
+                i = p;
+            }
+            else
+            {
+                ++stall;
+                i = q;
+            }
+        }
+
+        unsigned p = prev[i], q = next[i];
+        if ( cross(poly[p], poly[i], poly[q]) > eps )
+        {
+            out->push_back( poly[p].index );
+            out->push_back( poly[i].index );
+            out->push_back( poly[q].index );
+        }
+    }
+
+    template<typename DE>
+    DE* triangulate( std::vector<Ring2>& rings, const std::vector<int>& parent, const std::vector<bool>& isUsed, const std::vector<bool>& isHole, double eps )
+    {
+        // pre-size the index array: a ring with N verts and H bridged holes yields N+2H-2 triangles.
+        unsigned numIndices = 0;
+        for( unsigned r=0; r<rings.size(); ++r )
+            numIndices += rings[r].size() + (isHole[r] ? 2 : 0);
+
+        DE* out = new DE( GL_TRIANGLES );
+        out->reserve( 3*numIndices );
+
+        for( unsigned r=0; r<rings.size(); ++r )
+        {
+            if ( isHole[r] || !isUsed[r] )
+                continue;
+
+            std::vector<const Ring2*> holes;
+            for( unsigned h=0; h<rings.size(); ++h )
+                if ( isHole[h] && parent[h] == (int)r )
+                    holes.push_back( &rings[h] );
+
+            std::sort( holes.begin(), holes.end(), SortByMaxXDescending() );
+
+            Ring2 poly = rings[r];
+            for( unsigned h=0; h<holes.size(); ++h )
+                bridgeHole( poly, *holes[h] );
+
+            clipEars( poly, eps, out );
+        }
+
+        return out;
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool
+PolygonTriangulator::run( osg::Geometry& geom, WindingRule rule )
+{
+    osg::Vec3Array* verts = dynamic_cast<osg::Vec3Array*>( geom.getVertexArray() );
+    if ( !verts || verts->size() < 3 )
+        return false;
+
+    // separate the contours from any other primitive sets, which we leave alone.
+    std::vector<const osg::DrawArrays*> contours;
+    osg::Geometry::PrimitiveSetList others;
+    for( unsigned i=0; i<geom.getNumPrimitiveSets(); ++i )
+    {
+        osg::PrimitiveSet* ps = geom.getPrimitiveSet(i);
+        const osg::DrawArrays* da = dynamic_cast<const osg::DrawArrays*>( ps );
+        if ( da && (da->getMode() == osg::PrimitiveSet::LINE_LOOP || da->getMode() == osg::PrimitiveSet::POLYGON) &&
+             da->getFirst() + da->getCount() <= (int)verts->size() )
+        {
+            contours.push_back( da );
+        }
+        else
+        {
+            others.push_back( ps );
+        }
+    }
+
+    if ( contours.empty() )
+        return false;
+
+    // the plane of the polygon is the Newell normal of the largest contour, which
+    // also sets the facing of the output triangles.
+    osg::Vec3d normal;
+    for( unsigned c=0; c<contours.size(); ++c )
+    {
+        osg::Vec3d n;
+        int first = contours[c]->getFirst(), count = contours[c]->getCount();
+        for( int i=0; i<count; ++i )
+        {
+            const osg::Vec3f& a = (*verts)[first + i];
+            const osg::Vec3f& b = (*verts)[first + (i+1)%count];
+            n.x() += ((double)a.y() - b.y()) * ((double)a.z() + b.z());
+            n.y() += ((double)a.z() - b.z()) * ((double)a.x() + b.x());
+            n.z() += ((double)a.x() - b.x()) * ((double)a.y() + b.y());
+        }
+        if ( n.length2() > normal.length2() )
+            normal = n;
+    }
+
+    // project onto the axis plane most nearly parallel to the polygon, ordering the
+    // two remaining axes so that the largest contour winds CCW.
+    int u, v;
+    double ax = std::fabs(normal.x()), ay = std::fabs(normal.y()), az = std::fabs(normal.z());
+    if ( az >= ax && az >= ay )
+    {
+        if ( normal.z() >= 0.0 ) { u = 0; v = 1; } else { u = 1; v = 0; }
+    }
+    else if ( ax >= ay )
+    {
+        if ( normal.x() >= 0.0 ) { u = 1; v = 2; } else { u = 2; v = 1; }
+    }
+    else
+    {
+        if ( normal.y() >= 0.0 ) { u = 2; v = 0; } else { u = 0; v = 2; }
+    }
+
+    double xmin = DBL_MAX, ymin = DBL_MAX, xmax = -DBL_MAX, ymax = -DBL_MAX;
+
+    std::vector<Ring2> rings;
+    rings.reserve( contours.size() );
+    for( unsigned c=0; c<contours.size(); ++c )
+    {
+        rings.push_back( Ring2() );
+        Ring2& ring = rings.back();
+        int first = contours[c]->getFirst(), count = contours[c]->getCount();
+        ring.reserve( count );
+        for( int i=0; i<count; ++i )
+        {
+            const osg::Vec3f& p = (*verts)[first+i];
+            Vert2 pt;
+            pt.x = p[u];
+            pt.y = p[v];
+            pt.index = first+i;
+            if ( ring.empty() || !sameSpot(ring.back(), pt) )
+                ring.push_back( pt );
+            xmin = std::min(xmin, pt.x); xmax = std::max(xmax, pt.x);
+            ymin = std::min(ymin, pt.y); ymax = std::max(ymax, pt.y);
+        }
+        // drop a closing point that duplicates the first.
+        if ( ring.size() > 1 && sameSpot(ring.front(), ring.back()) )
+            ring.pop_back();
+    }
+
+    // area tolerance, relative to the size of the polygon.
+    double eps = 1e-12 * ((xmax-xmin)*(xmax-xmin) + (ymax-ymin)*(ymax-ymin));
+
+    // discard degenerate rings.
+    std::vector<double> areas;
+    for( unsigned r=0; r<rings.size(); )
+    {
+        double a = rings[r].size() >= 3 ? signedArea(rings[r]) : 0.0;
+        if ( std::fabs(a) <= eps )
+        {
+            rings.erase( rings.begin()+r );
+        }
+        else
+        {
+            areas.push_back( a );
+            ++r;
+        }
+    }
+
+    // a ring's ancestors are the larger rings that contain it.
+    std::vector< std::vector<unsigned> > ancestors( rings.size() );
+    for( unsigned r=0; r<rings.size(); ++r )
+    {
+        for( unsigned s=0; s<rings.size(); ++s )
+        {
+            if ( s != r && std::fabs(areas[s]) > std::fabs(areas[r]) && contains(rings[s], rings[r][0]) )
+                ancestors[r].push_back( s );
+        }
+    }
+
+    // classify each ring as an outer boundary or a hole. Under the positive rule a ring
+    // whose two sides are both in (or both out) bounds nothing and is dropped.
+    std::vector<bool> isUsed( rings.size(), true );
+    std::vector<bool> isHole( rings.size(), false );
+    for( unsigned r=0; r<rings.size(); ++r )
+    {
+        if ( rule == WINDING_POSITIVE )
+        {
+            int outside = 0;
+            for( unsigned a=0; a<ancestors[r].size(); ++a )
+                outside += areas[ancestors[r][a]] > 0.0 ? 1 : -1;
+            int inside = outside + (areas[r] > 0.0 ? 1 : -1);
+
+            if ( (inside > 0) == (outside > 0) )
+                isUsed[r] = false;
+            else
+                isHole[r] = outside > 0;
+        }
+        else
+        {
+            isHole[r] = (ancestors[r].size() % 2) == 1;
+        }
+    }
+
+    // each hole belongs to the smallest outer boundary that contains it.
+    // Orient outers CCW and holes CW.
+    std::vector<int> parent( rings.size(), -1 );
+    for( unsigned r=0; r<rings.size(); ++r )
+    {
+        if ( !isUsed[r] )
+            continue;
+
+        if ( isHole[r] )
+        {
+            for( unsigned a=0; a<ancestors[r].size(); ++a )
+            {
+                unsigned s = ancestors[r][a];
+                if ( isUsed[s] && !isHole[s] && (parent[r] < 0 || std::fabs(areas[s]) < std::fabs(areas[parent[r]])) )
+                    parent[r] = s;
+            }
+        }
+
+        if ( (areas[r] < 0.0) != isHole[r] )
+            std::reverse( rings[r].begin(), rings[r].end() );
+    }
+
+    osg::ref_ptr<osg::PrimitiveSet> triangles;
+    if ( verts->size() <= 0xFFFF )
+        triangles = triangulate<osg::DrawElementsUShort>( rings, parent, isUsed, isHole, eps );
+    else
+        triangles = triangulate<osg::DrawElementsUInt>( rings, parent, isUsed, isHole, eps );
+
+    geom.setPrimitiveSetList( others );
+    if ( triangles->getNumIndices() > 0 )
+        geom.addPrimitiveSet( triangles.get() );
+
+    return true;
+}